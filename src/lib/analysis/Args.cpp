@@ -103,6 +103,11 @@ Args::Ctor()
 
   prof_metrics = Analysis::Args::MetricFlg_NULL;
 
+  prof_readOnce = false;
+  prof_readOnceMemMB = 1024;
+  prof_numThreads = 1;
+  prof_batchMetrics = false;
+
   profflat_computeFinalMetricValues = true;
 
   // -------------------------------------------------------
@@ -115,6 +120,7 @@ Args::Ctor()
   db_copySrcFiles   = true;
   out_db_config     = "";
   db_makeMetricDB   = true;
+  db_sparseMetricDB = false;
   db_addStructId    = false;
 
   out_txt           = Analysis_OUT_TXT;
@@ -175,6 +175,19 @@ public:
 
   uint prof_metrics;
 
+  // hpcprof-mpi: read each profile file once and replay a cached copy
+  // (up to 'prof_readOnceMemMB' MB in memory per process, the rest in
+  // a scratch file) instead of re-reading it for every pass
+  bool prof_readOnce;
+  uint prof_readOnceMemMB;
+
+  // hpcprof: number of threads for reading and merging profiles
+  uint prof_numThreads;
+
+  // compute derived metrics with compiled, block-wise evaluation
+  // (cf. Prof::Metric::AExprProgram)
+  bool prof_batchMetrics;
+
   // TODO: Currently this is always true even though we only need to
   // compute final metric values for (1) hpcproftt (flat) and (2)
   // hpcprof-flat when it computes derived metrics.  However, at the
@@ -202,6 +215,7 @@ public:
   std::string out_db_config;     // disable: "", stdout: "-"
 
   bool db_makeMetricDB;
+  bool db_sparseMetricDB;        // write the sparse metric db format
   bool db_addStructId;
 
   // -------------------------------------------------------
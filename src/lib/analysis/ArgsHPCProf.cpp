@@ -116,6 +116,9 @@ Options: General:\n\
   -V, --version        Print version information.\n\
   -h, --help           Print this help.\n\
   --debug [<n>]        Debug: use debug level <n>. {1}\n\
+  --threads <n>        hpcprof: read and merge measurement files with <n>\n\
+                       threads. Both tools format experiment.xml with <n>\n\
+                       threads (requires OpenMP support). {1}\n\
 \n\
 Options: Source Code and Static Structure:\n\
   --name <name>, --title <name>\n\
@@ -146,15 +149,23 @@ Options: Metrics:\n\
                        hpcprof-mpi does not compute 'thread'.\n\
   --force-metric       Force hpcprof to show all thread-level metrics,\n\
                        regardless of their number.\n\
+  --read-once [<mb>]   hpcprof-mpi: read each measurement file only once.\n\
+                       Keep up to <mb> megabytes of profile data per process\n\
+                       in memory and spill the rest to a scratch file in\n\
+                       $TMPDIR (or /tmp). {1024}\n\
+  --batch-metrics      Compute derived (summary) metrics by compiling each\n\
+                       metric formula and evaluating it over blocks of\n\
+                       calling context nodes.\n\
 \n\
 Options: Output:\n\
   -o <db-path>, --db <db-path>, --output <db-path>\n\
                        Specify Experiment database name <db-path>.\n\
                        {./" Analysis_DB_DIR "}\n\
                        Experiment format {" Analysis_OUT_DB_EXPERIMENT "}\n\
-  --metric-db <yes|no>\n\
+  --metric-db <yes|no|sparse>\n\
                        Control whether to generate a thread-level metric\n\
                        value database for hpcviewer scatter plots. {yes}\n\
+                       'sparse' stores only non-zero values (hpcprof-mpi).\n\
   --remove-redundancy \n\
                        Eliminate procedure name redundancy in experiment.xml\n\
   --struct-id          Add 'str=nnn' field to profile data with the hpcstruct\n\
@@ -196,6 +207,10 @@ CmdLineParser::OptArgDesc Analysis::ArgsHPCProf::optArgs[] = {
      NULL },
   {  0 , "force-metric",    CLP::ARG_NONE, CLP::DUPOPT_CLOB, NULL,
      NULL },
+  {  0 , "read-once",       CLP::ARG_OPT,  CLP::DUPOPT_CLOB, NULL,
+     CLP::isOptArg_long },
+  {  0 , "batch-metrics",   CLP::ARG_NONE, CLP::DUPOPT_CLOB, NULL,
+     NULL },
 
   // Output options
   { 'o', "output",          CLP::ARG_REQ , CLP::DUPOPT_CLOB, NULL,
@@ -216,6 +231,8 @@ CmdLineParser::OptArgDesc Analysis::ArgsHPCProf::optArgs[] = {
      NULL },
   { 0, "remove-redundancy", CLP::ARG_NONE, CLP::DUPOPT_CLOB, NULL,
      NULL },
+  {  0 , "threads",         CLP::ARG_REQ,  CLP::DUPOPT_CLOB, NULL,
+     NULL },
   {  0 , "debug",           CLP::ARG_OPT,  CLP::DUPOPT_CLOB, NULL,  // hidden
      CLP::isOptArg_long },
   CmdLineParser_OptArgDesc_NULL_MACRO // SGI's compiler requires this version
@@ -319,6 +336,20 @@ ArgsHPCProf::parse(int argc, const char* const argv[])
       }
       Diagnostics_SetDiagnosticFilterLevel(verb);
     }
+    if (parser.isOpt("threads")) {
+      const string& arg = parser.getOptArg("threads");
+      long n = CmdLineParser::toLong(arg);
+      if (n < 1) {
+	ARG_ERROR("--threads requires a positive thread count");
+      }
+      prof_numThreads = (uint)n;
+#ifndef ENABLE_OPENMP
+      if (prof_numThreads > 1) {
+	DIAG_WMsg(0, "--threads ignored: built without OpenMP support");
+	prof_numThreads = 1;
+      }
+#endif
+    }
 
     // Check for agent options
     if (parser.isOpt("agent-cilk")) {
@@ -394,6 +425,16 @@ ArgsHPCProf::parse(int argc, const char* const argv[])
       }
     }
     // N.B.: hpcprof checks for "force-metric": src/tool/hpcprof/Args.cpp
+    if (parser.isOpt("read-once")) {
+      prof_readOnce = true;
+      if (parser.isOptArg("read-once")) {
+	const string& arg = parser.getOptArg("read-once");
+	prof_readOnceMemMB = (uint)CmdLineParser::toLong(arg);
+      }
+    }
+    if (parser.isOpt("batch-metrics")) {
+      prof_batchMetrics = true;
+    }
     
     // Check for other options: Output options
     bool isDbDirSet = false;
@@ -407,7 +448,14 @@ ArgsHPCProf::parse(int argc, const char* const argv[])
     }
     if (parser.isOpt("metric-db")) {
       const string& arg = parser.getOptArg("metric-db");
-      db_makeMetricDB = CmdLineParser::parseArg_bool(arg, "--metric-db option");
+      if (arg == "sparse") {
+	db_makeMetricDB = true;
+	db_sparseMetricDB = true;
+      }
+      else {
+	db_makeMetricDB = CmdLineParser::parseArg_bool(arg, "--metric-db option");
+	db_sparseMetricDB = false;
+      }
     }
     if (parser.isOpt("struct-id")) {
       db_addStructId = true;
@@ -164,9 +164,9 @@ MetricComponentsFact::make(Prof::CCT::ANode* node,
       uint mId_dst = m_dst[i];
 
       if (stmt->hasMetric(mId_src)) {
-	double mval = stmt->metric(mId_src);
+	double mval = stmt->peekMetric(mId_src);
 	stmt->demandMetric(mId_dst) += mval;
-	stmt->metric(mId_src) = 0.0;
+	stmt->zeroMetrics(mId_src, mId_src + 1);
       }
     }
   }
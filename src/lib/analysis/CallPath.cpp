@@ -72,11 +72,13 @@ using std::string;
 #include <cstring>
 
 #include <typeinfo>
+#include <exception>
 
 #include <sys/stat.h>
 
 //*************************** User Include Files ****************************
 
+#include <include/hpctoolkit-config.h>
 #include <include/uint.h>
 #include <include/gcc-attr.h>
 
@@ -104,6 +106,10 @@ using namespace xml;
 #include <lib/support/IOUtil.hpp>
 #include <lib/support/StrUtil.hpp>
 
+#ifdef ENABLE_OPENMP
+#include <omp.h>
+#endif
+
 
 
 //********************************** Macros **********************************
@@ -138,27 +144,169 @@ namespace Analysis {
 namespace CallPath {
 
 
+// readOne: Read profile 'fnm', through 'src' if given.
+static Prof::CallPath::Profile*
+readOne(const string& fnm, uint groupId, uint rFlags, ProfileSource* src)
+{
+  FILE* fs = (src) ? src->open(fnm) : NULL;
+
+  Prof::CallPath::Profile* prof = NULL;
+  try {
+    prof = read(fnm.c_str(), fs, groupId, rFlags);
+  }
+  catch (...) {
+    if (fs) {
+      src->close(fs);
+    }
+    throw;
+  }
+
+  if (fs) {
+    src->close(fs);
+  }
+  return prof;
+}
+
+
+#ifdef ENABLE_OPENMP
+
+// readTree: Read profiles [begIdx, endIdx) and merge them with a
+// pairwise (tree) reduction: the left half is read as a separate task
+// while this thread reads the right half; the right result is then
+// merged into the left.  Because the left operand always holds the
+// lower-numbered profiles, metrics are created in the same order as
+// the sequential merge.  Returns NULL if some profile could not be
+// read.
+static Prof::CallPath::Profile*
+readTree(const Util::StringVec& profileFiles, const Util::UIntVec* groupMap,
+	 uint begIdx, uint endIdx, int mergeTy, uint rFlags, uint mrgFlags,
+	 ProfileSource* src)
+{
+  if (endIdx - begIdx == 1) {
+    uint groupId = (groupMap) ? (*groupMap)[begIdx] : 0;
+    Prof::CallPath::Profile* prof = NULL;
+    try {
+      prof = readOne(profileFiles[begIdx], groupId, rFlags, src);
+      prof->addDirectory(profileFiles[begIdx]);
+    }
+    // N.B.: exceptions may not escape a task
+    catch (const Diagnostics::Exception& ex) {
+      DIAG_EMsg(ex.message());
+      delete prof;
+      prof = NULL;
+    }
+    catch (const std::exception& ex) {
+      DIAG_EMsg("[std::exception] " << ex.what());
+      delete prof;
+      prof = NULL;
+    }
+    catch (...) {
+      DIAG_EMsg("Unknown exception while reading '"
+		<< profileFiles[begIdx] << "'");
+      delete prof;
+      prof = NULL;
+    }
+    return prof;
+  }
+
+  uint midIdx = begIdx + (endIdx - begIdx) / 2;
+
+  Prof::CallPath::Profile* x = NULL;
+  Prof::CallPath::Profile* y = NULL;
+
+#pragma omp task  default(shared)  firstprivate(begIdx, midIdx)
+  x = readTree(profileFiles, groupMap, begIdx, midIdx,
+	       mergeTy, rFlags, mrgFlags, src);
+
+  y = readTree(profileFiles, groupMap, midIdx, endIdx,
+	       mergeTy, rFlags, mrgFlags, src);
+
+#pragma omp taskwait
+
+  if (!x || !y) {
+    delete x;
+    delete y;
+    return NULL;
+  }
+
+  try {
+    x->merge(*y, mergeTy, mrgFlags);
+    x->metricMgr()->mergePerfEventStatistics(y->metricMgr());
+    x->copyDirectory(y->directorySet());
+  }
+  catch (const Diagnostics::Exception& ex) {
+    DIAG_EMsg(ex.message());
+    delete x;
+    x = NULL;
+  }
+  catch (const std::exception& ex) {
+    DIAG_EMsg("[std::exception] " << ex.what());
+    delete x;
+    x = NULL;
+  }
+  catch (...) {
+    DIAG_EMsg("Unknown exception while merging profiles");
+    delete x;
+    x = NULL;
+  }
+  delete y;
+
+  return x;
+}
+
+#endif // ENABLE_OPENMP
+
+
 Prof::CallPath::Profile*
 read(const Util::StringVec& profileFiles, const Util::UIntVec* groupMap,
-     int mergeTy, uint rFlags, uint mrgFlags)
+     int mergeTy, uint rFlags, uint mrgFlags, uint numThreads,
+     ProfileSource* src)
 {
   // Special case
   if (profileFiles.empty()) {
     Prof::CallPath::Profile* prof = Prof::CallPath::Profile::make(rFlags);
     return prof;
   }
-  
+
+#ifdef ENABLE_OPENMP
+  if (numThreads > 1 && profileFiles.size() > 1) {
+    Prof::CallPath::Profile* prof = NULL;
+
+    omp_set_num_threads(numThreads);
+
+#pragma omp parallel  default(shared)
+    {
+#pragma omp single
+      prof = readTree(profileFiles, groupMap, 0, profileFiles.size(),
+		      mergeTy, rFlags, mrgFlags, src);
+    }
+
+    if (!prof) {
+      DIAG_Throw("While reading profiles...");
+    }
+    prof->metricMgr()->mergePerfEventStatistics_finalize(profileFiles.size());
+
+    // rewrite each trace once, after all levels of the reduction
+    prof->fixTraceFiles();
+
+    return prof;
+  }
+#endif
+
   // General case
   uint groupId = (groupMap) ? (*groupMap)[0] : 0;
-  Prof::CallPath::Profile* prof = read(profileFiles[0], groupId, rFlags);
+  Prof::CallPath::Profile* prof = readOne(profileFiles[0], groupId, rFlags,
+					  src);
 
   // add the directory into the set of directories
   prof->addDirectory(profileFiles[0]);
 
   for (uint i = 1; i < profileFiles.size(); ++i) {
     groupId = (groupMap) ? (*groupMap)[i] : 0;
-    Prof::CallPath::Profile* p = read(profileFiles[i], groupId, rFlags);
+    Prof::CallPath::Profile* p = readOne(profileFiles[i], groupId, rFlags,
+					 src);
     prof->merge(*p, mergeTy, mrgFlags);
+    prof->fixTraceFiles(); // 'prof' is never merged again
 
     prof->metricMgr()->mergePerfEventStatistics(p->metricMgr());
     delete p;
@@ -174,6 +322,13 @@ read(const Util::StringVec& profileFiles, const Util::UIntVec* groupMap,
 
 Prof::CallPath::Profile*
 read(const char* prof_fnm, uint groupId, uint rFlags)
+{
+  return read(prof_fnm, NULL, groupId, rFlags);
+}
+
+
+Prof::CallPath::Profile*
+read(const char* prof_fnm, FILE* infs, uint groupId, uint rFlags)
 {
   // -------------------------------------------------------
   // 
@@ -182,7 +337,13 @@ read(const char* prof_fnm, uint groupId, uint rFlags)
   Prof::CallPath::Profile* prof = NULL;
   try {
     DIAG_MsgIf(0, "Reading: '" << prof_fnm << "'");
-    prof = Prof::CallPath::Profile::make(prof_fnm, rFlags, /*outfs*/ NULL);
+    if (infs) {
+      prof = Prof::CallPath::Profile::make(prof_fnm, infs, rFlags,
+					   /*outfs*/ NULL);
+    }
+    else {
+      prof = Prof::CallPath::Profile::make(prof_fnm, rFlags, /*outfs*/ NULL);
+    }
   }
   catch (...) {
     DIAG_EMsg("While reading profile '" << prof_fnm << "'...");
@@ -1057,7 +1218,7 @@ makeReturnCountMetric(Prof::CallPath::Profile& prof)
       for (uint i = 0; i < retCntId.size(); ++i) {
 	uint mId = retCntId[i];
 	n_parent->demandMetric(mId) += n->demandMetric(mId);
-	n->metric(mId) = 0.0;
+	n->zeroMetrics(mId, mId + 1);
       }
     }
   }
@@ -1166,7 +1327,8 @@ write(Prof::CallPath::Profile& prof, std::ostream& os,
   // 
   // ------------------------------------------------------------
   os << "<SecCallPathProfileData>\n";
-  prof.cct()->writeXML(os, metricBegId, metricEndId, oFlags);
+  prof.cct()->writeXMLBuffered(os, metricBegId, metricEndId, oFlags,
+				args.prof_numThreads);
   os << "</SecCallPathProfileData>\n";
 
   os << "</SecCallPathProfile>\n";
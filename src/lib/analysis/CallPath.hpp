@@ -94,13 +94,39 @@ extern std::ostream* dbgOs; // for parallel debugging
 //
 // ---------------------------------------------------------
 
+// ProfileSource: a hook for read() below that supplies the contents of
+// each profile file, e.g., from a copy staged in memory.  open()
+// returns NULL to read the file itself; a non-NULL stream is passed
+// back to close() once the profile has been read.
+class ProfileSource {
+public:
+  virtual ~ProfileSource() { }
+
+  virtual FILE*
+  open(const std::string& fnm) = 0;
+
+  virtual void
+  close(FILE* fs) = 0;
+};
+
+
+// read: Read and merge 'profileFiles'.  If 'numThreads' > 1 (and
+// OpenMP is enabled), profiles are read concurrently and merged with a
+// pairwise reduction.  If 'src' is given, the profiles are read through
+// it; it must then be thread-safe if 'numThreads' > 1.
 Prof::CallPath::Profile*
 read(const Util::StringVec& profileFiles, const Util::UIntVec* groupMap,
-     int mergeTy, uint rFlags = 0, uint mrgFlags = 0);
+     int mergeTy, uint rFlags = 0, uint mrgFlags = 0, uint numThreads = 1,
+     ProfileSource* src = NULL);
 
 Prof::CallPath::Profile*
 read(const char* prof_fnm, uint groupId, uint rFlags = 0);
 
+// read: as above, but take the contents of 'prof_fnm' from the already
+// opened stream 'infs' (e.g., a cached copy of the file)
+Prof::CallPath::Profile*
+read(const char* prof_fnm, FILE* infs, uint groupId, uint rFlags);
+
 static inline Prof::CallPath::Profile*
 read(const string& prof_fnm, uint groupId, uint rFlags = 0)
 {
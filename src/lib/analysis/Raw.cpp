@@ -63,6 +63,8 @@
 #include <string>
 using std::string;
 
+#include <vector>
+
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
 
@@ -144,15 +146,35 @@ Analysis::Raw::writeAsText_callpathMetricDB(const char* filenm)
 
     hpcmetricDB_fmt_hdr_fprint(&hdr, stdout);
 
+    std::vector<uint64_t> nodeIndex;
+    std::vector<double> row(hdr.numMetrics);
+    if (hdr.isSparse) {
+      nodeIndex.resize(hdr.numNodes + 1);
+      ret = hpcmetricDB_fmt_sparse_index_fread(&nodeIndex[0], hdr.numNodes, fs);
+      if (ret != HPCFMT_OK) {
+	DIAG_Throw("error reading metric-db file '" << filenm << "'");
+      }
+    }
+
     for (uint nodeId = 1; nodeId < hdr.numNodes + 1; ++nodeId) {
+      if (hdr.isSparse) {
+	uint64_t numEntries = nodeIndex[nodeId] - nodeIndex[nodeId - 1];
+	ret = hpcmetricDB_fmt_sparse_row_fread(&row[0], hdr.numMetrics,
+					       numEntries, fs);
+      }
+      else {
+	ret = HPCFMT_OK;
+	for (uint mId = 0; mId < hdr.numMetrics && ret == HPCFMT_OK; ++mId) {
+	  ret = hpcfmt_real8_fread(&row[mId], fs);
+	}
+      }
+      if (ret != HPCFMT_OK) {
+	DIAG_Throw("error reading metric-db file '" << filenm << "'");
+      }
+
       fprintf(stdout, "(%6u: ", nodeId);
       for (uint mId = 0; mId < hdr.numMetrics; ++mId) {
-	double mval = 0;
-	ret = hpcfmt_real8_fread(&mval, fs);
-	if (ret != HPCFMT_OK) {
-	  DIAG_Throw("error reading trace file '" << filenm << "'");
-	}
-	fprintf(stdout, "%12g ", mval);
+	fprintf(stdout, "%12g ", row[mId]);
       }
       fprintf(stdout, ")\n");
     }
@@ -186,10 +208,13 @@ Analysis::Raw::writeAsText_callpathTrace(const char* filenm)
 
     hpctrace_fmt_hdr_fprint(&hdr, stdout);
 
+    hpctrace_fmt_rdstate_t rdstate;
+    hpctrace_fmt_rdstate_init(&rdstate);
+
     // Read trace records and exit on EOF
     while ( !feof(fs) ) {
       hpctrace_fmt_datum_t datum;
-      ret = hpctrace_fmt_datum_fread(&datum, hdr.flags, fs);
+      ret = hpctrace_fmt_datum_fread_any(&datum, hdr.flags, &rdstate, fs);
       if (ret == HPCFMT_EOF) {
 	break;
       }
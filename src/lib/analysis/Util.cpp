@@ -68,6 +68,7 @@ using std::string;
 #include <typeinfo>
 
 #include <cstring> // strlen()
+#include <cstdio>
 
 #include <dirent.h> // scandir()
 
@@ -581,6 +582,65 @@ copySourceFile(const string& filenm, const string& dstDir,
 namespace Analysis {
 namespace Util {
 
+// writeNormalizedTrace: If the measurement trace 'srcFnm' is not in
+// the database format (cf. hpctrace_fmt_db_flags(); e.g., it uses the
+// compact record format), write it to 'dstFnm' in that format and
+// return true.  Otherwise return false and leave 'dstFnm' alone.  On
+// error, 'dstFnm' is removed so that the database never holds a
+// partial or unreadable trace.
+static bool
+writeNormalizedTrace(const string& dstFnm, const string& srcFnm)
+{
+  FILE* infs = hpcio_fopen_r(srcFnm.c_str());
+  if (!infs) {
+    DIAG_Throw("error opening trace file '" << srcFnm << "'");
+  }
+
+  hpctrace_fmt_hdr_t hdr;
+  int ret = hpctrace_fmt_hdr_fread(&hdr, infs);
+  if (ret != HPCFMT_OK) {
+    hpcio_fclose(infs);
+    DIAG_Throw("error reading trace file '" << srcFnm << "'");
+  }
+
+  if (hpctrace_fmt_is_db_format(hdr.flags)) {
+    hpcio_fclose(infs);
+    return false;
+  }
+
+  FILE* outfs = hpcio_fopen_w(dstFnm.c_str(), 1/*overwrite*/);
+  if (!outfs) {
+    hpcio_fclose(infs);
+    DIAG_Throw("error opening trace file '" << dstFnm << "'");
+  }
+
+  hpctrace_hdr_flags_t outFlags = hpctrace_fmt_db_flags(hdr.flags);
+
+  hpctrace_fmt_rdstate_t rdstate;
+  hpctrace_fmt_rdstate_init(&rdstate);
+
+  ret = hpctrace_fmt_hdr_fwrite(outFlags, outfs);
+  while (ret == HPCFMT_OK) {
+    hpctrace_fmt_datum_t datum;
+    ret = hpctrace_fmt_datum_fread_any(&datum, hdr.flags, &rdstate, infs);
+    if (ret != HPCFMT_OK) {
+      break;
+    }
+    datum.time = hpctrace_fmt_time_db(&hdr, datum.time);
+    ret = hpctrace_fmt_datum_fwrite(&datum, outFlags, outfs);
+  }
+
+  hpcio_fclose(infs);
+  hpcio_fclose(outfs);
+
+  if (ret != HPCFMT_EOF) {
+    FileUtil::remove(dstFnm.c_str());
+    DIAG_Throw("error normalizing trace file '" << srcFnm << "'");
+  }
+  return true;
+}
+
+
 // copyTraceFiles:
 void
 copyTraceFiles(const std::string& dstDir, const std::set<string>& srcFiles)
@@ -628,10 +688,13 @@ copyTraceFiles(const std::string& dstDir, const std::set<string>& srcFiles)
       }
     }
     else {
-      // no trace.tmp file: always copy (keep original)
+      // no trace.tmp file: always copy (keep original), normalizing
+      // the records if hpcprof did not need to rewrite them
       try {
-	DIAG_Msg(2, "trace (cp): '" << srcFnm2 << "' -> '" << dstFnm << "'");
-	FileUtil::copy(dstFnm, srcFnm2);
+	if (!writeNormalizedTrace(dstFnm, srcFnm2)) {
+	  DIAG_Msg(2, "trace (cp): '" << srcFnm2 << "' -> '" << dstFnm << "'");
+	  FileUtil::copy(dstFnm, srcFnm2);
+	}
       }
       catch (const Diagnostics::Exception& ex) {
 	DIAG_EMsg("While copying trace files ['"
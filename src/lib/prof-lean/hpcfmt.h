@@ -257,6 +257,197 @@ hpcfmt_real8_fwrite(double val, FILE* outfs)
 }
 
 
+//***************************************************************************
+// Variable-length integers (LEB128)
+//***************************************************************************
+
+// maximum encoded length of a 64-bit value
+#define HPCFMT_VarintMaxLen 10
+
+
+// zigzag mapping so that small signed deltas encode in few bytes
+static inline uint64_t
+hpcfmt_zigzag_enc(int64_t val)
+{
+  return ((uint64_t)val << 1) ^ (uint64_t)(val >> 63);
+}
+
+
+static inline int64_t
+hpcfmt_zigzag_dec(uint64_t val)
+{
+  return (int64_t)(val >> 1) ^ -(int64_t)(val & 1);
+}
+
+
+// hpcfmt_varint_encode: encodes 'val' into 'buf' (which must have
+// room for HPCFMT_VarintMaxLen bytes); returns the number of bytes used.
+static inline size_t
+hpcfmt_varint_encode(uint64_t val, unsigned char* buf)
+{
+  size_t n = 0;
+  while (val >= 0x80) {
+    buf[n++] = (unsigned char)(val | 0x80);
+    val >>= 7;
+  }
+  buf[n++] = (unsigned char)val;
+  return n;
+}
+
+
+// hpcfmt_varint_decode: decodes a value from 'buf' (holding at most
+// 'len' bytes); returns the number of bytes consumed or 0 on error.
+static inline size_t
+hpcfmt_varint_decode(uint64_t* val, const unsigned char* buf, size_t len)
+{
+  uint64_t x = 0;
+  unsigned int shift = 0;
+  for (size_t n = 0; n < len && n < HPCFMT_VarintMaxLen; n++) {
+    x |= (uint64_t)(buf[n] & 0x7f) << shift;
+    if (!(buf[n] & 0x80)) {
+      *val = x;
+      return n + 1;
+    }
+    shift += 7;
+  }
+  return 0;
+}
+
+
+static inline int
+hpcfmt_varint_fread(uint64_t* val, FILE* infs)
+{
+  uint64_t x = 0;
+  unsigned int shift = 0;
+  for (int n = 0; n < HPCFMT_VarintMaxLen; n++) {
+    int c = fgetc(infs);
+    if (c == EOF) {
+      return (n == 0 && feof(infs)) ? HPCFMT_EOF : HPCFMT_ERR;
+    }
+    x |= (uint64_t)(c & 0x7f) << shift;
+    if (!(c & 0x80)) {
+      *val = x;
+      return HPCFMT_OK;
+    }
+    shift += 7;
+  }
+  return HPCFMT_ERR;
+}
+
+
+static inline int
+hpcfmt_varint_fwrite(uint64_t val, FILE* outfs)
+{
+  unsigned char buf[HPCFMT_VarintMaxLen];
+  size_t n = hpcfmt_varint_encode(val, buf);
+  if ( n != fwrite(buf, 1, n, outfs) ) {
+    return HPCFMT_ERR;
+  }
+  return HPCFMT_OK;
+}
+
+
+//***************************************************************************
+// Memory cursors
+//
+// Readers for an in-memory image of a file (e.g., a read-only mapping)
+// that decode big-endian fields in place.  Each read is bounds-checked
+// and, like the FILE* readers, returns HPCFMT_EOF if the cursor is at
+// the end of the image or HPCFMT_ERR on a partial field.
+//***************************************************************************
+
+typedef struct hpcfmt_cursor_t {
+
+  const unsigned char* beg;
+  const unsigned char* cur;
+  const unsigned char* end;
+
+} hpcfmt_cursor_t;
+
+
+static inline void
+hpcfmt_cursor_init(hpcfmt_cursor_t* c, const void* buf, size_t len,
+		   size_t offset)
+{
+  c->beg = (const unsigned char*)buf;
+  c->end = c->beg + len;
+  c->cur = c->beg + ((offset < len) ? offset : len);
+}
+
+
+// hpcfmt_cursor_offset: offset of the cursor from the start of the image
+static inline size_t
+hpcfmt_cursor_offset(const hpcfmt_cursor_t* c)
+{
+  return (size_t)(c->cur - c->beg);
+}
+
+
+static inline int
+hpcfmt_cursor_check(const hpcfmt_cursor_t* c, size_t size)
+{
+  size_t avail = (size_t)(c->end - c->cur);
+  if (avail < size) {
+    return (avail == 0) ? HPCFMT_EOF : HPCFMT_ERR;
+  }
+  return HPCFMT_OK;
+}
+
+
+static inline int
+hpcfmt_int2_cread(uint16_t* val, hpcfmt_cursor_t* c)
+{
+  int ret = hpcfmt_cursor_check(c, sizeof(uint16_t));
+  if (ret != HPCFMT_OK) {
+    return ret;
+  }
+  const unsigned char* p = c->cur;
+  *val = (uint16_t)(((uint16_t)p[0] << 8) | (uint16_t)p[1]);
+  c->cur += sizeof(uint16_t);
+  return HPCFMT_OK;
+}
+
+
+static inline int
+hpcfmt_int4_cread(uint32_t* val, hpcfmt_cursor_t* c)
+{
+  int ret = hpcfmt_cursor_check(c, sizeof(uint32_t));
+  if (ret != HPCFMT_OK) {
+    return ret;
+  }
+  const unsigned char* p = c->cur;
+  *val = (((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16)
+	  | ((uint32_t)p[2] << 8) | (uint32_t)p[3]);
+  c->cur += sizeof(uint32_t);
+  return HPCFMT_OK;
+}
+
+
+static inline int
+hpcfmt_int8_cread(uint64_t* val, hpcfmt_cursor_t* c)
+{
+  int ret = hpcfmt_cursor_check(c, sizeof(uint64_t));
+  if (ret != HPCFMT_OK) {
+    return ret;
+  }
+  const unsigned char* p = c->cur;
+  uint64_t x = 0;
+  for (int i = 0; i < 8; ++i) {
+    x = (x << 8) | (uint64_t)p[i];
+  }
+  *val = x;
+  c->cur += sizeof(uint64_t);
+  return HPCFMT_OK;
+}
+
+
+static inline int
+hpcfmt_real8_cread(double* val, hpcfmt_cursor_t* c)
+{
+  return hpcfmt_int8_cread((uint64_t*)val, c);
+}
+
+
 //***************************************************************************
 // hpcfmt_str_t
 //***************************************************************************
@@ -71,6 +71,13 @@
 //
 // Deserves further study: the best way to handle errors from write().
 //
+// With hpcio_outbuf_attach_async(), the outbuf is double buffered: a
+// full buffer is handed to another thread (the client's 'submit'
+// function) and writing continues into the spare.  Buffers carry
+// their file offsets and are written with pwrite(), so a buffer that
+// must be written synchronously (no free spare or the submit queue is
+// full) may safely overtake one still in flight.
+//
 //***************************************************************************
 
 //************************* System Include Files ****************************
@@ -79,6 +86,7 @@
 #include <sys/stat.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <sched.h>
 #include <string.h>
 #include <unistd.h>
 
@@ -95,21 +103,28 @@
 
 //*************************** Private Functions *****************************
 
-// Try to write() the entire outbuf.
+// Try to write() the entire outbuf (with pwrite() at the buffer's
+// offset if asynchronous).
 //
 // Returns: HPCFMT_OK if the entire buffer was successfully written,
 // else HPCFMT_ERR.
 //
 static int
-outbuf_flush_buffer(hpcio_outbuf_t *outbuf)
+outbuf_write_buffer(hpcio_outbuf_t *outbuf)
 {
   ssize_t amt_done, ret;
 
   amt_done = 0;
   while (amt_done < outbuf->in_use) {
     errno = 0;
-    ret = write(outbuf->fd, outbuf->buf_start + amt_done,
-		outbuf->in_use - amt_done);
+    if (outbuf->submit != NULL) {
+      ret = pwrite(outbuf->fd, outbuf->buf_start + amt_done,
+		   outbuf->in_use - amt_done, outbuf->offset + amt_done);
+    }
+    else {
+      ret = write(outbuf->fd, outbuf->buf_start + amt_done,
+		  outbuf->in_use - amt_done);
+    }
 
     // Check for short writes.  Note: EINTR is not failure.
     if (ret > 0 || (ret == 0 && errno == EINTR)) {
@@ -125,18 +140,70 @@ outbuf_flush_buffer(hpcio_outbuf_t *outbuf)
       if (amt_done > 0) {
 	memmove(outbuf->buf_start, outbuf->buf_start + amt_done,
 		outbuf->in_use - amt_done);
-	outbuf->in_use = amt_done;
+	outbuf->in_use -= amt_done;
+	outbuf->offset += amt_done;
       }
       return HPCFMT_ERR;
     }
   }
 
   // entire buffer was successfully written
+  outbuf->offset += outbuf->in_use;
   outbuf->in_use = 0;
   return HPCFMT_OK;
 }
 
 
+// Wait until the spare buffer is no longer being written.
+//
+static void
+outbuf_wait_spare(hpcio_outbuf_t *outbuf)
+{
+  while (outbuf->spare_busy) {
+    sched_yield();
+  }
+  __sync_synchronize();
+}
+
+
+// Make room in a full outbuf: hand it off if asynchronous and the
+// spare is free, else write it.
+//
+// Returns: HPCFMT_OK if the buffer is now empty, else HPCFMT_ERR.
+//
+static int
+outbuf_flush_buffer(hpcio_outbuf_t *outbuf)
+{
+  if (outbuf->submit == NULL || outbuf->in_use == 0) {
+    return outbuf_write_buffer(outbuf);
+  }
+
+  if (! outbuf->spare_busy) {
+    // mark the spare busy first: it may be written and released
+    // before 'submit' returns
+    __sync_synchronize();
+    outbuf->spare_busy = 1;
+    __sync_synchronize();
+
+    void *full = outbuf->buf_start;
+    if (outbuf->submit(outbuf, full, outbuf->in_use, outbuf->offset)
+	== HPCFMT_OK) {
+      outbuf->buf_start = outbuf->buf_spare;
+      outbuf->buf_spare = full;
+      outbuf->offset += outbuf->in_use;
+      outbuf->in_use = 0;
+      outbuf->num_async++;
+      return HPCFMT_OK;
+    }
+    outbuf->spare_busy = 0;
+  }
+
+  // backpressure: no free buffer, or no room to queue this one
+  outbuf->num_sync++;
+  return outbuf_write_buffer(outbuf);
+}
+
+
 //*************************** Interface Functions ***************************
 
 // Attach the file descriptor to the buffer, initialize and fill in
@@ -163,10 +230,100 @@ hpcio_outbuf_attach(hpcio_outbuf_t *outbuf /* out */, int fd,
   outbuf->use_lock = (flags & HPCIO_OUTBUF_LOCKED);
   spinlock_unlock(&outbuf->lock);
 
+  outbuf->submit = NULL;
+  outbuf->buf_spare = NULL;
+  outbuf->spare_busy = 0;
+  outbuf->async_err = 0;
+  outbuf->offset = 0;
+  outbuf->num_async = 0;
+  outbuf->num_sync = 0;
+
   return HPCFMT_OK;
 }
 
 
+// As hpcio_outbuf_attach(), but with a second buffer 'buf_spare' (of
+// the same size) so that full buffers may be handed to another
+// thread by 'submit'.
+//
+// Returns: HPCFMT_OK on success, else HPCFMT_ERR.
+//
+int
+hpcio_outbuf_attach_async(hpcio_outbuf_t *outbuf /* out */, int fd,
+			  void *buf_start, void *buf_spare, size_t buf_size,
+			  int flags, hpcio_outbuf_submit_fn *submit)
+{
+  if (buf_spare == NULL || submit == NULL) {
+    return HPCFMT_ERR;
+  }
+
+  int ret = hpcio_outbuf_attach(outbuf, fd, buf_start, buf_size, flags);
+  if (ret != HPCFMT_OK) {
+    return ret;
+  }
+
+  off_t offset = lseek(fd, 0, SEEK_CUR);
+  if (offset < 0) {
+    return HPCFMT_ERR;
+  }
+
+  outbuf->submit = submit;
+  outbuf->buf_spare = buf_spare;
+  outbuf->offset = offset;
+
+  return HPCFMT_OK;
+}
+
+
+// Write a buffer handed off by the outbuf's 'submit' function and
+// release it for reuse.  Called by the thread that accepted it.
+//
+// Returns: HPCFMT_OK on success, else HPCFMT_ERR.
+//
+int
+hpcio_outbuf_async_write(hpcio_outbuf_t *outbuf, void *buf, size_t len,
+			 off_t offset)
+{
+  int ret = HPCFMT_OK;
+  size_t amt_done = 0;
+
+  while (amt_done < len) {
+    errno = 0;
+    ssize_t amt = pwrite(outbuf->fd, buf + amt_done, len - amt_done,
+			 offset + amt_done);
+    if (amt > 0) {
+      amt_done += amt;
+    }
+    else if (!(amt < 0 && errno == EINTR)) {
+      // hard failure: the data is lost
+      ret = HPCFMT_ERR;
+      break;
+    }
+  }
+
+  if (ret != HPCFMT_OK) {
+    outbuf->async_err = 1;
+  }
+  __sync_synchronize();
+  outbuf->spare_busy = 0;
+
+  return ret;
+}
+
+
+// Report how many full buffers were handed off ('num_async') and how
+// many were written synchronously for lack of a free buffer or queue
+// space ('num_sync').
+//
+void
+hpcio_outbuf_async_counts(hpcio_outbuf_t *outbuf, long *num_async,
+			  long *num_sync)
+{
+  *num_async = outbuf->num_async;
+  *num_sync = outbuf->num_sync;
+}
+
+
 // Copy data to the outbuf and flush if necessary.
 //
 // Returns: number of bytes copied, or else -1 on bad buffer.
@@ -222,7 +379,11 @@ hpcio_outbuf_flush(hpcio_outbuf_t *outbuf)
     spinlock_lock(&outbuf->lock);
   }
 
-  int ret = outbuf_flush_buffer(outbuf);
+  outbuf_wait_spare(outbuf);
+  int ret = outbuf_write_buffer(outbuf);
+  if (outbuf->async_err) {
+    ret = HPCFMT_ERR;
+  }
 
   if (outbuf->use_lock) {
     spinlock_unlock(&outbuf->lock);
@@ -249,7 +410,9 @@ hpcio_outbuf_close(hpcio_outbuf_t *outbuf)
     spinlock_lock(&outbuf->lock);
   }
 
-  if (outbuf_flush_buffer(outbuf) == HPCFMT_OK
+  outbuf_wait_spare(outbuf);
+  if (outbuf_write_buffer(outbuf) == HPCFMT_OK
+      && ! outbuf->async_err
       && close(outbuf->fd) == 0) {
     // flush and close both succeed
     outbuf->magic = 0;
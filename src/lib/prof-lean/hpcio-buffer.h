@@ -55,6 +55,16 @@
 
 // Clients should treat the outbuf struct as opaque.
 
+struct hpcio_outbuf_s;
+
+// Asynchronous flushing (cf. hpcio_outbuf_attach_async): hand the
+// full buffer 'buf' ('len' bytes, bound for file offset 'offset') to
+// another thread, which must write it with hpcio_outbuf_async_write().
+// Must be safe inside signal handlers.  Returns HPCFMT_OK if the
+// buffer was accepted; otherwise the outbuf writes it synchronously.
+typedef int hpcio_outbuf_submit_fn(struct hpcio_outbuf_s *outbuf,
+				   void *buf, size_t len, off_t offset);
+
 typedef struct hpcio_outbuf_s {
   uint32_t magic;
   void  *buf_start;
@@ -64,6 +74,16 @@ typedef struct hpcio_outbuf_s {
   int  flags;
   char use_lock;
   spinlock_t lock;
+
+  // double buffering for asynchronous flushing (NULL 'submit' if
+  // synchronous).  'buf_spare' is busy while it is being written.
+  hpcio_outbuf_submit_fn *submit;
+  void  *buf_spare;
+  volatile int spare_busy;
+  volatile int async_err;
+  off_t  offset;     // file offset of 'buf_start'
+  long   num_async;  // full buffers handed to 'submit'
+  long   num_sync;   // full buffers written synchronously instead
 } hpcio_outbuf_t;
 
 
@@ -82,6 +102,19 @@ int
 hpcio_outbuf_attach(hpcio_outbuf_t *outbuf /* out */, int fd,
 		    void *buf_start, size_t buf_size, int flags);
 
+int
+hpcio_outbuf_attach_async(hpcio_outbuf_t *outbuf /* out */, int fd,
+			  void *buf_start, void *buf_spare, size_t buf_size,
+			  int flags, hpcio_outbuf_submit_fn *submit);
+
+int
+hpcio_outbuf_async_write(hpcio_outbuf_t *outbuf, void *buf, size_t len,
+			 off_t offset);
+
+void
+hpcio_outbuf_async_counts(hpcio_outbuf_t *outbuf, long *num_async,
+			  long *num_sync);
+
 ssize_t
 hpcio_outbuf_write(hpcio_outbuf_t *outbuf, const void *data, size_t size);
 
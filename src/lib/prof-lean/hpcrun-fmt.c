@@ -609,6 +609,30 @@ hpcrun_fmt_loadmapEntry_free(loadmap_entry_t* x, hpcfmt_free_fn dealloc)
 // cct
 //***************************************************************************
 
+static void
+hpcrun_fmt_cct_node_zeroMetrics(hpcrun_fmt_cct_node_t* x)
+{
+  if (x->num_metrics > 0) {
+    memset(x->metrics, 0, x->num_metrics * sizeof(hpcrun_metricVal_t));
+  }
+}
+
+
+// number of nonzero metrics, i.e., of (id, value) pairs in the sparse
+// encoding
+static uint32_t
+hpcrun_fmt_cct_node_numNonzeroMetrics(hpcrun_fmt_cct_node_t* x)
+{
+  uint32_t nnz = 0;
+  for (int i = 0; i < x->num_metrics; ++i) {
+    if (!hpcrun_metricVal_isZero(x->metrics[i])) {
+      nnz++;
+    }
+  }
+  return nnz;
+}
+
+
  int
 hpcrun_fmt_cct_node_fread(hpcrun_fmt_cct_node_t* x,
 			  epoch_flags_t flags, FILE* fs)
@@ -629,8 +653,70 @@ hpcrun_fmt_cct_node_fread(hpcrun_fmt_cct_node_t* x,
     hpcrun_fmt_lip_fread(&x->lip, fs);
   }
 
-  for (int i = 0; i < x->num_metrics; ++i) {
-    HPCFMT_ThrowIfError(hpcfmt_int8_fread(&x->metrics[i].bits, fs));
+  if (flags.fields.isSparseMetrics) {
+    uint32_t nnz = 0;
+    HPCFMT_ThrowIfError(hpcfmt_int4_fread(&nnz, fs));
+
+    hpcrun_fmt_cct_node_zeroMetrics(x);
+    for (uint32_t k = 0; k < nnz; ++k) {
+      uint32_t mId;
+      uint64_t bits;
+      HPCFMT_ThrowIfError(hpcfmt_int4_fread(&mId, fs));
+      HPCFMT_ThrowIfError(hpcfmt_int8_fread(&bits, fs));
+      if (mId < x->num_metrics) {
+	x->metrics[mId].bits = bits;
+      }
+    }
+  }
+  else {
+    for (int i = 0; i < x->num_metrics; ++i) {
+      HPCFMT_ThrowIfError(hpcfmt_int8_fread(&x->metrics[i].bits, fs));
+    }
+  }
+  
+  return HPCFMT_OK;
+}
+
+
+int
+hpcrun_fmt_cct_node_cread(hpcrun_fmt_cct_node_t* x,
+			  epoch_flags_t flags, hpcfmt_cursor_t* c)
+{
+  HPCFMT_ThrowIfError(hpcfmt_int4_cread(&x->id, c));
+  HPCFMT_ThrowIfError(hpcfmt_int4_cread(&x->id_parent, c));
+
+  x->as_info = lush_assoc_info_NULL;
+  if (flags.fields.isLogicalUnwind) {
+    HPCFMT_ThrowIfError(hpcfmt_int4_cread(&x->as_info.bits, c));
+  }
+
+  HPCFMT_ThrowIfError(hpcfmt_int2_cread(&x->lm_id, c));
+  HPCFMT_ThrowIfError(hpcfmt_int8_cread(&x->lm_ip, c));
+
+  lush_lip_init(&x->lip);
+  if (flags.fields.isLogicalUnwind) {
+    HPCFMT_ThrowIfError(hpcrun_fmt_lip_cread(&x->lip, c));
+  }
+
+  if (flags.fields.isSparseMetrics) {
+    uint32_t nnz = 0;
+    HPCFMT_ThrowIfError(hpcfmt_int4_cread(&nnz, c));
+
+    hpcrun_fmt_cct_node_zeroMetrics(x);
+    for (uint32_t k = 0; k < nnz; ++k) {
+      uint32_t mId;
+      uint64_t bits;
+      HPCFMT_ThrowIfError(hpcfmt_int4_cread(&mId, c));
+      HPCFMT_ThrowIfError(hpcfmt_int8_cread(&bits, c));
+      if (mId < x->num_metrics) {
+	x->metrics[mId].bits = bits;
+      }
+    }
+  }
+  else {
+    for (int i = 0; i < x->num_metrics; ++i) {
+      HPCFMT_ThrowIfError(hpcfmt_int8_cread(&x->metrics[i].bits, c));
+    }
   }
   
   return HPCFMT_OK;
@@ -655,8 +741,21 @@ hpcrun_fmt_cct_node_fwrite(hpcrun_fmt_cct_node_t* x,
     HPCFMT_ThrowIfError(hpcrun_fmt_lip_fwrite(&x->lip, fs));
   }
 
-  for (int i = 0; i < x->num_metrics; ++i) {
-    HPCFMT_ThrowIfError(hpcfmt_int8_fwrite(x->metrics[i].bits, fs));
+  if (flags.fields.isSparseMetrics) {
+    uint32_t nnz = hpcrun_fmt_cct_node_numNonzeroMetrics(x);
+    HPCFMT_ThrowIfError(hpcfmt_int4_fwrite(nnz, fs));
+
+    for (int i = 0; i < x->num_metrics; ++i) {
+      if (!hpcrun_metricVal_isZero(x->metrics[i])) {
+	HPCFMT_ThrowIfError(hpcfmt_int4_fwrite((uint32_t)i, fs));
+	HPCFMT_ThrowIfError(hpcfmt_int8_fwrite(x->metrics[i].bits, fs));
+      }
+    }
+  }
+  else {
+    for (int i = 0; i < x->num_metrics; ++i) {
+      HPCFMT_ThrowIfError(hpcfmt_int8_fwrite(x->metrics[i].bits, fs));
+    }
   }
   
   return HPCFMT_OK;
@@ -731,6 +830,17 @@ hpcrun_fmt_lip_fread(lush_lip_t* x, FILE* fs)
 }
 
 
+int
+hpcrun_fmt_lip_cread(lush_lip_t* x, hpcfmt_cursor_t* c)
+{
+  for (int i = 0; i < LUSH_LIP_DATA8_SZ; ++i) {
+    HPCFMT_ThrowIfError(hpcfmt_int8_cread(&x->data8[i], c));
+  }
+  
+  return HPCFMT_OK;
+}
+
+
 int
 hpcrun_fmt_lip_fwrite(lush_lip_t* x, FILE* fs)
 {
@@ -799,6 +909,16 @@ hpctrace_fmt_hdr_fread(hpctrace_fmt_hdr_t* hdr, FILE* infs)
     HPCFMT_ThrowIfError(hpcfmt_int8_fread(&(hdr->flags.bits), infs));
   }
 
+  hpctrace_fmt_clock_t* clk = &hdr->clock;
+  clk->tickBase  = 0;
+  clk->nsBase    = 0;
+  clk->nsPerTick = 1000.0; // microseconds
+  if (hdr->flags.fields.isRawClock) {
+    HPCFMT_ThrowIfError(hpcfmt_int8_fread(&(clk->tickBase), infs));
+    HPCFMT_ThrowIfError(hpcfmt_int8_fread(&(clk->nsBase), infs));
+    HPCFMT_ThrowIfError(hpcfmt_real8_fread(&(clk->nsPerTick), infs));
+  }
+
   return HPCFMT_OK;
 }
 
@@ -820,8 +940,11 @@ hpctrace_fmt_hdr_outbuf(hpctrace_hdr_flags_t flags, hpcio_outbuf_t* outbuf)
     k++;
   }
 
+  const char* version = (flags.fields.isCompact) ?
+    HPCTRACE_FMT_VersionCompact : HPCTRACE_FMT_Version;
+
   hpcio_outbuf_write(outbuf, HPCTRACE_FMT_Magic, HPCTRACE_FMT_MagicLen);
-  hpcio_outbuf_write(outbuf, HPCTRACE_FMT_Version, HPCTRACE_FMT_VersionLen);
+  hpcio_outbuf_write(outbuf, version, HPCTRACE_FMT_VersionLen);
   hpcio_outbuf_write(outbuf, HPCTRACE_FMT_Endian, HPCTRACE_FMT_EndianLen);
   ret = hpcio_outbuf_write(outbuf, buf, bufSZ);
 
@@ -833,6 +956,33 @@ hpctrace_fmt_hdr_outbuf(hpctrace_hdr_flags_t flags, hpcio_outbuf_t* outbuf)
 }
 
 
+int
+hpctrace_fmt_clock_outbuf(const hpctrace_fmt_clock_t* clock,
+			  hpcio_outbuf_t* outbuf)
+{
+  const int bufSZ = HPCTRACE_FMT_ClockLen;
+  unsigned char buf[bufSZ];
+
+  hpcfmt_byte8_union_t nsPerTick;
+  nsPerTick.r8 = clock->nsPerTick;
+
+  uint64_t vals[3] = { clock->tickBase, clock->nsBase, nsPerTick.i8 };
+  int k = 0;
+  for (int i = 0; i < 3; i++) {
+    for (int shift = 56; shift >= 0; shift -= 8) {
+      buf[k] = (vals[i] >> shift) & 0xff;
+      k++;
+    }
+  }
+
+  if (hpcio_outbuf_write(outbuf, buf, bufSZ) != bufSZ) {
+    return HPCFMT_ERR;
+  }
+
+  return HPCFMT_OK;
+}
+
+
 // N.B.: not async safe
 int
 hpctrace_fmt_hdr_fwrite(hpctrace_hdr_flags_t flags, FILE* fs)
@@ -842,7 +992,10 @@ hpctrace_fmt_hdr_fwrite(hpctrace_hdr_flags_t flags, FILE* fs)
   nw = fwrite(HPCTRACE_FMT_Magic,   1, HPCTRACE_FMT_MagicLen, fs);
   if (nw != HPCTRACE_FMT_MagicLen) return HPCFMT_ERR;
 
-  nw = fwrite(HPCTRACE_FMT_Version, 1, HPCTRACE_FMT_VersionLen, fs);
+  const char* version = (flags.fields.isCompact) ?
+    HPCTRACE_FMT_VersionCompact : HPCTRACE_FMT_Version;
+
+  nw = fwrite(version, 1, HPCTRACE_FMT_VersionLen, fs);
   if (nw != HPCTRACE_FMT_VersionLen) return HPCFMT_ERR;
 
   nw = fwrite(HPCTRACE_FMT_Endian,  1, HPCTRACE_FMT_EndianLen, fs);
@@ -863,6 +1016,10 @@ hpctrace_fmt_hdr_fprint(hpctrace_fmt_hdr_t* hdr, FILE* fs)
   fprintf(fs, "  (version: %s)\n", hdr->versionStr);
   fprintf(fs, "  (endian: %c)\n", hdr->endian);
   fprintf(fs, "  (flags: 0x%"PRIx64")\n", hdr->flags.bits);
+  if (hdr->flags.fields.isRawClock) {
+    fprintf(fs, "  (clock: %"PRIu64" ticks at %"PRIu64" ns, %.9g ns/tick)\n",
+	    hdr->clock.tickBase, hdr->clock.nsBase, hdr->clock.nsPerTick);
+  }
   fprintf(fs, "]\n");
 
   return HPCFMT_OK;
@@ -964,6 +1121,158 @@ hpctrace_fmt_datum_fprint(hpctrace_fmt_datum_t* x, hpctrace_hdr_flags_t flags,
 }
 
 
+//***************************************************************************
+// [hpctrace] compact trace records
+//***************************************************************************
+
+void
+hpctrace_fmt_block_init(hpctrace_fmt_block_t* blk)
+{
+  blk->hdr.numBytes = 0;
+  blk->hdr.numRecords = 0;
+  blk->hdr.timeBeg = 0;
+  blk->hdr.timeEnd = 0;
+  blk->prevTime = 0;
+  blk->prevCpId = 0;
+}
+
+
+int
+hpctrace_fmt_block_outbuf(hpctrace_fmt_block_t* blk, hpcio_outbuf_t* outbuf)
+{
+  if (blk->hdr.numRecords == 0) {
+    return HPCFMT_OK;
+  }
+
+  unsigned char buf[HPCTRACE_FMT_BlockHdrLen];
+  int shift, k;
+
+  k = 0;
+  for (shift = 24; shift >= 0; shift -= 8) {
+    buf[k++] = (blk->hdr.numBytes >> shift) & 0xff;
+  }
+  for (shift = 24; shift >= 0; shift -= 8) {
+    buf[k++] = (blk->hdr.numRecords >> shift) & 0xff;
+  }
+  for (shift = 56; shift >= 0; shift -= 8) {
+    buf[k++] = (blk->hdr.timeBeg >> shift) & 0xff;
+  }
+  for (shift = 56; shift >= 0; shift -= 8) {
+    buf[k++] = (blk->hdr.timeEnd >> shift) & 0xff;
+  }
+
+  ssize_t sz = blk->hdr.numBytes;
+  if (hpcio_outbuf_write(outbuf, buf, k) != k
+      || hpcio_outbuf_write(outbuf, blk->buf, sz) != sz) {
+    return HPCFMT_ERR;
+  }
+
+  hpctrace_fmt_block_init(blk);
+  return HPCFMT_OK;
+}
+
+
+int
+hpctrace_fmt_datum_block_outbuf(hpctrace_fmt_datum_t* x,
+				hpctrace_hdr_flags_t flags,
+				hpctrace_fmt_block_t* blk,
+				hpcio_outbuf_t* outbuf)
+{
+  if (blk->hdr.numBytes + HPCTRACE_FMT_DatumMaxLen > HPCTRACE_FMT_BlockMaxBytes) {
+    HPCFMT_ThrowIfError(hpctrace_fmt_block_outbuf(blk, outbuf));
+  }
+
+  unsigned char* buf = blk->buf + blk->hdr.numBytes;
+  size_t k = 0;
+
+  int64_t dTime = (int64_t)(x->time - blk->prevTime);
+  int64_t dCpId = (int64_t)x->cpId - (int64_t)blk->prevCpId;
+
+  k += hpcfmt_varint_encode(hpcfmt_zigzag_enc(dTime), buf + k);
+  k += hpcfmt_varint_encode(hpcfmt_zigzag_enc(dCpId), buf + k);
+  if (flags.fields.isDataCentric) {
+    k += hpcfmt_varint_encode(x->metricId, buf + k);
+  }
+
+  if (blk->hdr.numRecords == 0) {
+    blk->hdr.timeBeg = x->time;
+  }
+  blk->hdr.timeEnd = x->time;
+  blk->hdr.numRecords++;
+  blk->hdr.numBytes += k;
+
+  blk->prevTime = x->time;
+  blk->prevCpId = x->cpId;
+
+  return HPCFMT_OK;
+}
+
+
+int
+hpctrace_fmt_block_hdr_fread(hpctrace_fmt_block_hdr_t* x, FILE* fs)
+{
+  int ret = hpcfmt_int4_fread(&(x->numBytes), fs);
+  if (ret != HPCFMT_OK) {
+    return ret; // can be HPCFMT_EOF
+  }
+  HPCFMT_ThrowIfError(hpcfmt_int4_fread(&(x->numRecords), fs));
+  HPCFMT_ThrowIfError(hpcfmt_int8_fread(&(x->timeBeg), fs));
+  HPCFMT_ThrowIfError(hpcfmt_int8_fread(&(x->timeEnd), fs));
+
+  return HPCFMT_OK;
+}
+
+
+void
+hpctrace_fmt_rdstate_init(hpctrace_fmt_rdstate_t* st)
+{
+  st->numLeft = 0;
+  st->prevTime = 0;
+  st->prevCpId = 0;
+}
+
+
+int
+hpctrace_fmt_datum_fread_compact(hpctrace_fmt_datum_t* x,
+				 hpctrace_hdr_flags_t flags,
+				 hpctrace_fmt_rdstate_t* st, FILE* fs)
+{
+  // advance to the next non-empty block, resetting the delta state
+  while (st->numLeft == 0) {
+    hpctrace_fmt_block_hdr_t bhdr;
+    int ret = hpctrace_fmt_block_hdr_fread(&bhdr, fs);
+    if (ret != HPCFMT_OK) {
+      return ret; // can be HPCFMT_EOF
+    }
+    st->numLeft = bhdr.numRecords;
+    st->prevTime = 0;
+    st->prevCpId = 0;
+  }
+
+  uint64_t dTime, dCpId;
+  HPCFMT_ThrowIfError(hpcfmt_varint_fread(&dTime, fs));
+  HPCFMT_ThrowIfError(hpcfmt_varint_fread(&dCpId, fs));
+
+  x->time = st->prevTime + (uint64_t)hpcfmt_zigzag_dec(dTime);
+  x->cpId = (uint32_t)((int64_t)st->prevCpId + hpcfmt_zigzag_dec(dCpId));
+
+  if (flags.fields.isDataCentric) {
+    uint64_t metricId;
+    HPCFMT_ThrowIfError(hpcfmt_varint_fread(&metricId, fs));
+    x->metricId = (uint32_t)metricId;
+  }
+  else {
+    x->metricId = HPCRUN_FMT_MetricId_NULL;
+  }
+
+  st->prevTime = x->time;
+  st->prevCpId = x->cpId;
+  st->numLeft--;
+
+  return HPCFMT_OK;
+}
+
+
 //***************************************************************************
 // hpcprof-metricdb (located here for now)
 //***************************************************************************
@@ -976,8 +1285,6 @@ int
 hpcmetricDB_fmt_hdr_fread(hpcmetricDB_fmt_hdr_t* hdr, FILE* infs)
 {
   char tag[HPCMETRICDB_FMT_MagicLen + 1];
-  char version[HPCMETRICDB_FMT_VersionLen + 1];
-  char endian[HPCMETRICDB_FMT_EndianLen + 1];
 
   int nr = fread(tag, 1, HPCMETRICDB_FMT_MagicLen, infs);
   tag[HPCMETRICDB_FMT_MagicLen] = '\0';
@@ -989,14 +1296,15 @@ hpcmetricDB_fmt_hdr_fread(hpcmetricDB_fmt_hdr_t* hdr, FILE* infs)
     return HPCFMT_ERR;
   }
 
-  nr = fread(&version, 1, HPCMETRICDB_FMT_VersionLen, infs);
-  version[HPCMETRICDB_FMT_VersionLen] = '\0';
+  nr = fread(hdr->versionStr, 1, HPCMETRICDB_FMT_VersionLen, infs);
+  hdr->versionStr[HPCMETRICDB_FMT_VersionLen] = '\0';
   if (nr != HPCMETRICDB_FMT_VersionLen) {
     return HPCFMT_ERR;
   }
   hdr->version = atof(hdr->versionStr);
+  hdr->isSparse = (strcmp(hdr->versionStr, HPCMETRICDB_FMT_VersionSparse) == 0);
 
-  nr = fread(&endian, 1, HPCMETRICDB_FMT_EndianLen, infs);
+  nr = fread(&hdr->endian, 1, HPCMETRICDB_FMT_EndianLen, infs);
   if (nr != HPCMETRICDB_FMT_EndianLen) {
     return HPCFMT_ERR;
   }
@@ -1004,6 +1312,11 @@ hpcmetricDB_fmt_hdr_fread(hpcmetricDB_fmt_hdr_t* hdr, FILE* infs)
   HPCFMT_ThrowIfError(hpcfmt_int4_fread(&(hdr->numNodes), infs));
   HPCFMT_ThrowIfError(hpcfmt_int4_fread(&(hdr->numMetrics), infs));
 
+  hdr->numEntries = 0;
+  if (hdr->isSparse) {
+    HPCFMT_ThrowIfError(hpcfmt_int8_fread(&(hdr->numEntries), infs));
+  }
+
   return HPCFMT_OK;
 }
 
@@ -1016,7 +1329,10 @@ hpcmetricDB_fmt_hdr_fwrite(hpcmetricDB_fmt_hdr_t* hdr, FILE* outfs)
   nw = fwrite(HPCMETRICDB_FMT_Magic,   1, HPCMETRICDB_FMT_MagicLen, outfs);
   if (nw != HPCTRACE_FMT_MagicLen) return HPCFMT_ERR;
 
-  nw = fwrite(HPCMETRICDB_FMT_Version, 1, HPCMETRICDB_FMT_VersionLen, outfs);
+  const char* version = (hdr->isSparse) ?
+    HPCMETRICDB_FMT_VersionSparse : HPCMETRICDB_FMT_Version;
+
+  nw = fwrite(version, 1, HPCMETRICDB_FMT_VersionLen, outfs);
   if (nw != HPCMETRICDB_FMT_VersionLen) return HPCFMT_ERR;
 
   nw = fwrite(HPCMETRICDB_FMT_Endian,  1, HPCMETRICDB_FMT_EndianLen, outfs);
@@ -1025,6 +1341,10 @@ hpcmetricDB_fmt_hdr_fwrite(hpcmetricDB_fmt_hdr_t* hdr, FILE* outfs)
   HPCFMT_ThrowIfError(hpcfmt_int4_fwrite(hdr->numNodes, outfs));
   HPCFMT_ThrowIfError(hpcfmt_int4_fwrite(hdr->numMetrics, outfs));
 
+  if (hdr->isSparse) {
+    HPCFMT_ThrowIfError(hpcfmt_int8_fwrite(hdr->numEntries, outfs));
+  }
+
   return HPCFMT_OK;
 }
 
@@ -1037,7 +1357,189 @@ hpcmetricDB_fmt_hdr_fprint(hpcmetricDB_fmt_hdr_t* hdr, FILE* outfs)
 
   fprintf(outfs, "(num-nodes:   %u)\n", hdr->numNodes);
   fprintf(outfs, "(num-metrics: %u)\n", hdr->numMetrics);
+  if (hdr->isSparse) {
+    fprintf(outfs, "(num-entries: %"PRIu64")\n", hdr->numEntries);
+  }
 
   return HPCFMT_OK;
 }
 
+
+//***************************************************************************
+// [hpcprof-metricdb] metric values
+//***************************************************************************
+
+// Values are packed (big endian) into a local buffer that is written
+// with one fwrite whenever it fills up.
+
+#define HPCMETRICDB_BUF_SZ (4096)
+
+static inline size_t
+hpcmetricDB_pack4(unsigned char* buf, uint32_t val)
+{
+  for (int shift = 24, k = 0; shift >= 0; shift -= 8, k++) {
+    buf[k] = (val >> shift) & 0xff;
+  }
+  return sizeof(uint32_t);
+}
+
+
+static inline size_t
+hpcmetricDB_pack8(unsigned char* buf, uint64_t val)
+{
+  for (int shift = 56, k = 0; shift >= 0; shift -= 8, k++) {
+    buf[k] = (val >> shift) & 0xff;
+  }
+  return sizeof(uint64_t);
+}
+
+
+static inline uint32_t
+hpcmetricDB_unpack4(const unsigned char* buf)
+{
+  uint32_t val = 0;
+  for (int k = 0; k < 4; k++) {
+    val = (val << 8) | buf[k];
+  }
+  return val;
+}
+
+
+static inline uint64_t
+hpcmetricDB_unpack8(const unsigned char* buf)
+{
+  uint64_t val = 0;
+  for (int k = 0; k < 8; k++) {
+    val = (val << 8) | buf[k];
+  }
+  return val;
+}
+
+
+int
+hpcmetricDB_fmt_row_fwrite(const double* vals, uint32_t numMetrics,
+			   FILE* outfs)
+{
+  unsigned char buf[HPCMETRICDB_BUF_SZ];
+  size_t k = 0;
+
+  for (uint32_t i = 0; i < numMetrics; i++) {
+    if (k + sizeof(double) > sizeof(buf)) {
+      if (fwrite(buf, 1, k, outfs) != k) return HPCFMT_ERR;
+      k = 0;
+    }
+    hpcfmt_byte8_union_t v;
+    v.r8 = vals[i];
+    k += hpcmetricDB_pack8(buf + k, v.i8);
+  }
+  if (k > 0 && fwrite(buf, 1, k, outfs) != k) return HPCFMT_ERR;
+
+  return HPCFMT_OK;
+}
+
+
+int
+hpcmetricDB_fmt_sparse_index_fwrite(const uint64_t* index, uint32_t numNodes,
+				    FILE* outfs)
+{
+  unsigned char buf[HPCMETRICDB_BUF_SZ];
+  size_t k = 0;
+
+  for (uint64_t i = 0; i < (uint64_t)numNodes + 1; i++) {
+    if (k + sizeof(uint64_t) > sizeof(buf)) {
+      if (fwrite(buf, 1, k, outfs) != k) return HPCFMT_ERR;
+      k = 0;
+    }
+    k += hpcmetricDB_pack8(buf + k, index[i]);
+  }
+  if (k > 0 && fwrite(buf, 1, k, outfs) != k) return HPCFMT_ERR;
+
+  return HPCFMT_OK;
+}
+
+
+int
+hpcmetricDB_fmt_sparse_index_fread(uint64_t* index, uint32_t numNodes,
+				   FILE* infs)
+{
+  for (uint64_t i = 0; i < (uint64_t)numNodes + 1; i++) {
+    HPCFMT_ThrowIfError(hpcfmt_int8_fread(&index[i], infs));
+  }
+  return HPCFMT_OK;
+}
+
+
+int
+hpcmetricDB_fmt_sparse_row_fwrite(const double* vals, uint32_t numMetrics,
+				  FILE* outfs)
+{
+  unsigned char buf[HPCMETRICDB_BUF_SZ];
+  size_t k = 0;
+
+  for (uint32_t i = 0; i < numMetrics; i++) {
+    if (vals[i] == 0.0) {
+      continue;
+    }
+    if (k + HPCMETRICDB_FMT_SparseEntryLen > sizeof(buf)) {
+      if (fwrite(buf, 1, k, outfs) != k) return HPCFMT_ERR;
+      k = 0;
+    }
+    hpcfmt_byte8_union_t v;
+    v.r8 = vals[i];
+    k += hpcmetricDB_pack4(buf + k, i);
+    k += hpcmetricDB_pack8(buf + k, v.i8);
+  }
+  if (k > 0 && fwrite(buf, 1, k, outfs) != k) return HPCFMT_ERR;
+
+  return HPCFMT_OK;
+}
+
+
+int
+hpcmetricDB_fmt_sparse_row_fread(double* vals, uint32_t numMetrics,
+				 uint64_t numEntries, FILE* infs)
+{
+  unsigned char buf[HPCMETRICDB_FMT_SparseEntryLen];
+
+  for (uint32_t i = 0; i < numMetrics; i++) {
+    vals[i] = 0.0;
+  }
+
+  for (uint64_t i = 0; i < numEntries; i++) {
+    if (fread(buf, 1, sizeof(buf), infs) != sizeof(buf)) {
+      return HPCFMT_ERR;
+    }
+    uint32_t mId = hpcmetricDB_unpack4(buf);
+    if (mId >= numMetrics) {
+      return HPCFMT_ERR;
+    }
+    hpcfmt_byte8_union_t v;
+    v.i8 = hpcmetricDB_unpack8(buf + sizeof(uint32_t));
+    vals[mId] = v.r8;
+  }
+
+  return HPCFMT_OK;
+}
+
+
+int
+hpcmetricDB_fmt_sparse_node_fread(const hpcmetricDB_fmt_hdr_t* hdr,
+				  const uint64_t* index, uint32_t nodeId,
+				  double* vals, FILE* infs)
+{
+  if (nodeId < 1 || nodeId > hdr->numNodes) {
+    return HPCFMT_ERR;
+  }
+
+  uint64_t beg = index[nodeId - 1];
+  uint64_t end = index[nodeId];
+  off_t pos = HPCMETRICDB_FMT_SparseDataOffset(hdr->numNodes)
+    + beg * HPCMETRICDB_FMT_SparseEntryLen;
+
+  if (fseeko(infs, pos, SEEK_SET) != 0) {
+    return HPCFMT_ERR;
+  }
+  return hpcmetricDB_fmt_sparse_row_fread(vals, hdr->numMetrics, end - beg,
+					  infs);
+}
+
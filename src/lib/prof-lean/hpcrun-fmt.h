@@ -111,7 +111,7 @@ static const char HPCPROF_TmpFnmSfx[] = "tmp";
 // N.B.: The header string is 24 bytes of character data
 
 static const char HPCRUN_FMT_Magic[]   = "HPCRUN-profile____"; // 18 bytes
-static const char HPCRUN_FMT_Version[] = "02.00";              // 5 bytes
+static const char HPCRUN_FMT_Version[] = "03.00";              // 5 bytes
 static const char HPCRUN_FMT_Endian[]  = "b";                  // 1 byte
 
 static const int HPCRUN_FMT_MagicLen   = (sizeof(HPCRUN_FMT_Magic) - 1);
@@ -120,7 +120,9 @@ static const int HPCRUN_FMT_EndianLen  = (sizeof(HPCRUN_FMT_Endian) - 1);
 
 
 // currently supported versions
+//   3.0: adds the isSparseMetrics epoch flag
 static const double HPCRUN_FMT_Version_20 = 2.0;
+static const double HPCRUN_FMT_Version_30 = 3.0;
 
 
 typedef struct hpcrun_fmt_hdr_t {
@@ -171,9 +173,14 @@ static const char HPCRUN_FMT_EpochTag[] = "EPOCH___";
 static const int  HPCRUN_FMT_EpochTagLen = (sizeof(HPCRUN_FMT_EpochTag) - 1);
 
 
+// isSparseMetrics: each cct node's metrics are written as a count
+//   followed by (metric id, value) pairs for its nonzero metrics
+//   rather than as one value per metric (cf. hpcrun_fmt_cct_node_t).
+//   Requires format version 3.0.
 typedef struct epoch_flags_bitfield {
   bool isLogicalUnwind : 1;
-  uint64_t unused      : 63;
+  bool isSparseMetrics : 1;
+  uint64_t unused      : 62;
 } epoch_flags_bitfield;
 
 
@@ -537,6 +544,10 @@ typedef struct hpcrun_fmt_cct_node_t {
   // static logical instruction pointer
   lush_lip_t lip;
 
+  // metrics: always a dense vector of 'num_metrics' values in memory.
+  // On disk, either 'num_metrics' values or, with the isSparseMetrics
+  // epoch flag, an int4 count followed by (int4 metric id, int8 value)
+  // pairs for the nonzero values.
   hpcfmt_uint_t num_metrics;
   hpcrun_metricVal_t* metrics;
 
@@ -550,11 +561,17 @@ hpcrun_fmt_cct_node_init(hpcrun_fmt_cct_node_t* x)
 }
 
 
-// N.B.: assumes space for metrics has been allocated
+// N.B.: assumes space for metrics has been allocated.  Sparse metric
+// ids not below 'num_metrics' are read but dropped.
 extern int
 hpcrun_fmt_cct_node_fread(hpcrun_fmt_cct_node_t* x,
 			  epoch_flags_t flags, FILE* fs);
 
+// As above, but decode from a memory cursor
+extern int
+hpcrun_fmt_cct_node_cread(hpcrun_fmt_cct_node_t* x,
+			  epoch_flags_t flags, hpcfmt_cursor_t* c);
+
 extern int
 hpcrun_fmt_cct_node_fwrite(hpcrun_fmt_cct_node_t* x,
 			   epoch_flags_t flags, FILE* fs);
@@ -572,6 +589,9 @@ hpcrun_fmt_cct_node_fprint(hpcrun_fmt_cct_node_t* x, FILE* fs,
 extern int
 hpcrun_fmt_lip_fread(lush_lip_t* x, FILE* fs);
 
+extern int
+hpcrun_fmt_lip_cread(lush_lip_t* x, hpcfmt_cursor_t* c);
+
 extern int
 hpcrun_fmt_lip_fwrite(lush_lip_t* x, FILE* fs);
 
@@ -590,15 +610,27 @@ hpcrun_fmt_lip_fprint(lush_lip_t* x, FILE* fs, const char* pre);
 // Header sizes:
 // - version 1.00: 24 bytes
 // - version 1.01: 32 bytes: 24 + sizeof(hpctrace_hdr_flags_t)
+// - version 1.02: same as 1.01; written when the records are in the
+//   compact (block) format, i.e., flags.fields.isCompact is set
+// - if flags.fields.isRawClock is set, the header is followed by the
+//   clock calibration (cf. hpctrace_fmt_clock_t), another 24 bytes
+//
+// Record times are microseconds since the epoch, unless
+// flags.fields.isRawClock (raw clock ticks) or flags.fields.isNanosec
+// (nanoseconds since the epoch) is set.
 
 static const char HPCTRACE_FMT_Magic[]   = "HPCRUN-trace______"; // 18 bytes
 static const char HPCTRACE_FMT_Version[] = "01.01";              // 5 bytes
+static const char HPCTRACE_FMT_VersionCompact[] = "01.02";       // 5 bytes
 static const char HPCTRACE_FMT_Endian[]  = "b";                  // 1 byte
 
 
 typedef struct hpctrace_hdr_flags_bitfield {
   bool isDataCentric : 1;
-  uint64_t unused    : 63;
+  bool isCompact     : 1;
+  bool isRawClock    : 1;
+  bool isNanosec     : 1;
+  uint64_t unused    : 60;
 } hpctrace_hdr_flags_bitfield;
 
 
@@ -627,6 +659,28 @@ static const int HPCTRACE_FMT_HeaderLen =
   HPCTRACE_FMT_FlagsLenX;
 
 
+// When flags.fields.isRawClock is set, record times are raw clock
+// readings (e.g., the invariant TSC) rather than microseconds.  The
+// calibration that follows the header maps them to wall-clock time:
+//
+//   tickBase  (uint64): a raw clock reading
+//   nsBase    (uint64): wall-clock time (ns since the epoch) at tickBase
+//   nsPerTick (real8):  nanoseconds per clock tick
+//
+// Raw times preserve the ordering of records closer together than a
+// microsecond; readers convert them with hpctrace_fmt_time_ns() or
+// hpctrace_fmt_time_us().  Database traces of such measurements keep
+// nanoseconds (cf. hpctrace_fmt_db_flags()).
+
+#define HPCTRACE_FMT_ClockLen (8 + 8 + 8)
+
+typedef struct hpctrace_fmt_clock_t {
+  uint64_t tickBase;
+  uint64_t nsBase;
+  double   nsPerTick;
+} hpctrace_fmt_clock_t;
+
+
 typedef struct hpctrace_fmt_hdr_t {
 
   char versionStr[sizeof(HPCTRACE_FMT_Version)];
@@ -636,6 +690,8 @@ typedef struct hpctrace_fmt_hdr_t {
 
   hpctrace_hdr_flags_t flags;
 
+  hpctrace_fmt_clock_t clock; // valid if flags.fields.isRawClock
+
 } hpctrace_fmt_hdr_t;
 
 
@@ -645,6 +701,12 @@ hpctrace_fmt_hdr_fread(hpctrace_fmt_hdr_t* hdr, FILE* infs);
 int
 hpctrace_fmt_hdr_outbuf(hpctrace_hdr_flags_t flags, hpcio_outbuf_t* outbuf);
 
+// Writes the calibration; must immediately follow the header of a
+// trace whose flags.fields.isRawClock is set.
+int
+hpctrace_fmt_clock_outbuf(const hpctrace_fmt_clock_t* clock,
+			  hpcio_outbuf_t* outbuf);
+
 // N.B.: not async safe
 int
 hpctrace_fmt_hdr_fwrite(hpctrace_hdr_flags_t flags, FILE* fs);
@@ -653,6 +715,36 @@ int
 hpctrace_fmt_hdr_fprint(hpctrace_fmt_hdr_t* hdr, FILE* fs);
 
 
+// Converts a record time of a trace with header 'hdr' to wall-clock
+// nanoseconds.
+static inline uint64_t
+hpctrace_fmt_time_ns(const hpctrace_fmt_hdr_t* hdr, uint64_t time)
+{
+  if (hdr->flags.fields.isNanosec) {
+    return time;
+  }
+  if (!hdr->flags.fields.isRawClock) {
+    return time * 1000;
+  }
+  const hpctrace_fmt_clock_t* clk = &hdr->clock;
+  double dns = (double)(int64_t)(time - clk->tickBase) * clk->nsPerTick;
+  int64_t ns = (int64_t)clk->nsBase + (int64_t)dns;
+  return (ns > 0) ? (uint64_t)ns : 0;
+}
+
+
+// Converts a record time of a trace with header 'hdr' to wall-clock
+// microseconds.
+static inline uint64_t
+hpctrace_fmt_time_us(const hpctrace_fmt_hdr_t* hdr, uint64_t time)
+{
+  if (!hdr->flags.fields.isRawClock && !hdr->flags.fields.isNanosec) {
+    return time;
+  }
+  return hpctrace_fmt_time_ns(hdr, time) / 1000;
+}
+
+
 //***************************************************************************
 // [hpctrace] trace record/datum
 //***************************************************************************
@@ -660,7 +752,7 @@ hpctrace_fmt_hdr_fprint(hpctrace_fmt_hdr_t* hdr, FILE* fs);
 #define HPCRUN_FMT_MetricId_NULL (INT_MAX) // for Java, no UINT32_MAX
 
 typedef struct hpctrace_fmt_datum_t {
-  uint64_t time; // microseconds
+  uint64_t time; // microseconds, unless isRawClock or isNanosec
   uint32_t cpId; // call path id (CCT leaf id); cf. HPCRUN_FMT_CCTNodeId_NULL
   uint32_t metricId;
 } hpctrace_fmt_datum_t;
@@ -684,6 +776,129 @@ hpctrace_fmt_datum_fprint(hpctrace_fmt_datum_t* x, hpctrace_hdr_flags_t flags,
 			  FILE* fs);
 
 
+//***************************************************************************
+// [hpctrace] compact trace records
+//***************************************************************************
+
+// When flags.fields.isCompact is set, the header is followed by a
+// sequence of self-contained blocks.  Each block begins with a
+// fixed-size (big endian) block header
+//
+//   numBytes   (uint32): size of the encoded records that follow
+//   numRecords (uint32): number of records in the block
+//   timeBeg    (uint64): time of the first record
+//   timeEnd    (uint64): time of the last record
+//
+// followed by 'numRecords' variable-length records.  Each record is
+// the zigzag LEB128 encoding of its time delta and cpId delta (both
+// relative to the previous record in the block, starting from 0),
+// followed by the LEB128 metricId if the trace is data-centric.
+//
+// Because delta state is reset at each block, the block headers form
+// a sparse index: a reader may skip a block without decoding it, or
+// binary-search block times by seeking over 'numBytes'.
+
+#define HPCTRACE_FMT_BlockHdrLen   (4 + 4 + 8 + 8)
+#define HPCTRACE_FMT_BlockMaxBytes (4096)
+#define HPCTRACE_FMT_DatumMaxLen   (3 * HPCFMT_VarintMaxLen)
+
+typedef struct hpctrace_fmt_block_hdr_t {
+  uint32_t numBytes;
+  uint32_t numRecords;
+  uint64_t timeBeg;
+  uint64_t timeEnd;
+} hpctrace_fmt_block_hdr_t;
+
+
+// writer state: the block currently being filled
+typedef struct hpctrace_fmt_block_t {
+  hpctrace_fmt_block_hdr_t hdr;
+  uint64_t prevTime;
+  uint32_t prevCpId;
+  unsigned char buf[HPCTRACE_FMT_BlockMaxBytes];
+} hpctrace_fmt_block_t;
+
+
+// reader state: position within the current block
+typedef struct hpctrace_fmt_rdstate_t {
+  uint32_t numLeft;
+  uint64_t prevTime;
+  uint32_t prevCpId;
+} hpctrace_fmt_rdstate_t;
+
+
+void
+hpctrace_fmt_block_init(hpctrace_fmt_block_t* blk);
+
+// Append the record to 'blk', first writing 'blk' to 'outbuf' if the
+// record does not fit.
+int
+hpctrace_fmt_datum_block_outbuf(hpctrace_fmt_datum_t* x,
+				hpctrace_hdr_flags_t flags,
+				hpctrace_fmt_block_t* blk,
+				hpcio_outbuf_t* outbuf);
+
+// Write any pending records in 'blk' to 'outbuf' and reset 'blk'.
+int
+hpctrace_fmt_block_outbuf(hpctrace_fmt_block_t* blk, hpcio_outbuf_t* outbuf);
+
+int
+hpctrace_fmt_block_hdr_fread(hpctrace_fmt_block_hdr_t* x, FILE* fs);
+
+
+void
+hpctrace_fmt_rdstate_init(hpctrace_fmt_rdstate_t* st);
+
+// Reads the next record of a compact trace, crossing block
+// boundaries as necessary.  Returns HPCFMT_EOF after the last block.
+int
+hpctrace_fmt_datum_fread_compact(hpctrace_fmt_datum_t* x,
+				 hpctrace_hdr_flags_t flags,
+				 hpctrace_fmt_rdstate_t* st, FILE* fs);
+
+// Reads the next record in either format.
+static inline int
+hpctrace_fmt_datum_fread_any(hpctrace_fmt_datum_t* x,
+			     hpctrace_hdr_flags_t flags,
+			     hpctrace_fmt_rdstate_t* st, FILE* fs)
+{
+  if (flags.fields.isCompact) {
+    return hpctrace_fmt_datum_fread_compact(x, flags, st, fs);
+  }
+  return hpctrace_fmt_datum_fread(x, flags, fs);
+}
+
+
+// Database traces (written by hpcprof) always use fixed-size records
+// with times in microseconds or, for raw-clock measurements, in
+// nanoseconds (isNanosec): hpcserver reads no other format.  Returns
+// the database flags for a measurement trace.
+static inline hpctrace_hdr_flags_t
+hpctrace_fmt_db_flags(hpctrace_hdr_flags_t flags)
+{
+  flags.fields.isNanosec = (flags.fields.isNanosec || flags.fields.isRawClock);
+  flags.fields.isCompact = false;
+  flags.fields.isRawClock = false;
+  return flags;
+}
+
+// Converts a record time of a trace with header 'hdr' to the unit of
+// its database trace (cf. hpctrace_fmt_db_flags()).
+static inline uint64_t
+hpctrace_fmt_time_db(const hpctrace_fmt_hdr_t* hdr, uint64_t time)
+{
+  return (hdr->flags.fields.isRawClock) ? hpctrace_fmt_time_ns(hdr, time) : time;
+}
+
+// Returns true if a trace with 'flags' may be copied verbatim into a
+// database.
+static inline bool
+hpctrace_fmt_is_db_format(hpctrace_hdr_flags_t flags)
+{
+  return (flags.bits == hpctrace_fmt_db_flags(flags).bits);
+}
+
+
 //***************************************************************************
 // hpcprof-metricdb (located here for now)
 //***************************************************************************
@@ -692,8 +907,18 @@ hpctrace_fmt_datum_fprint(hpctrace_fmt_datum_t* x, hpctrace_hdr_flags_t flags,
 // [hpcprof-metricdb] hdr
 //***************************************************************************
 
+// Versions:
+// - 00.10: dense: after the header, a (numNodes x numMetrics) row-major
+//   matrix of real8; the first row corresponds to node 1.
+// - 00.20: sparse (CSR): the header is followed by numEntries (uint64),
+//   a node index of (numNodes + 1) uint64 where index[i] is the number
+//   of entries before node i+1, and numEntries (metric id (uint32),
+//   value (real8)) pairs sorted by node and metric.  Zero values are
+//   not stored.
+
 static const char HPCMETRICDB_FMT_Magic[]   = "HPCPROF-metricdb__"; // 18 bytes
 static const char HPCMETRICDB_FMT_Version[] = "00.10";              // 5 bytes
+static const char HPCMETRICDB_FMT_VersionSparse[] = "00.20";        // 5 bytes
 static const char HPCMETRICDB_FMT_Endian[]  = "b";                  // 1 byte
 
 #define HPCMETRICDB_FMT_MagicLenX   (sizeof(HPCMETRICDB_FMT_Magic) - 1)
@@ -719,8 +944,18 @@ typedef struct hpcmetricDB_fmt_hdr_t {
   uint32_t numNodes;
   uint32_t numMetrics;
 
+  bool     isSparse;   // selects the version written
+  uint64_t numEntries; // sparse only
+
 } hpcmetricDB_fmt_hdr_t;
 
+// size of the sparse header and node index
+#define HPCMETRICDB_FMT_SparseDataOffset(numNodes)			\
+  (HPCMETRICDB_FMT_HeaderLen + 2 * sizeof(uint32_t) + sizeof(uint64_t)	\
+   + ((uint64_t)(numNodes) + 1) * sizeof(uint64_t))
+
+#define HPCMETRICDB_FMT_SparseEntryLen (sizeof(uint32_t) + sizeof(double))
+
 
 int
 hpcmetricDB_fmt_hdr_fread(hpcmetricDB_fmt_hdr_t* hdr, FILE* infs);
@@ -731,6 +966,42 @@ hpcmetricDB_fmt_hdr_fwrite(hpcmetricDB_fmt_hdr_t* hdr, FILE* outfs);
 int
 hpcmetricDB_fmt_hdr_fprint(hpcmetricDB_fmt_hdr_t* hdr, FILE* outfs);
 
+
+//***************************************************************************
+// [hpcprof-metricdb] metric values
+//***************************************************************************
+
+// dense: writes one row of 'numMetrics' values
+int
+hpcmetricDB_fmt_row_fwrite(const double* vals, uint32_t numMetrics,
+			   FILE* outfs);
+
+// sparse: the node index holds (numNodes + 1) entries
+int
+hpcmetricDB_fmt_sparse_index_fwrite(const uint64_t* index, uint32_t numNodes,
+				    FILE* outfs);
+
+int
+hpcmetricDB_fmt_sparse_index_fread(uint64_t* index, uint32_t numNodes,
+				   FILE* infs);
+
+// sparse: writes the non-zero values of one row of 'numMetrics' values
+int
+hpcmetricDB_fmt_sparse_row_fwrite(const double* vals, uint32_t numMetrics,
+				  FILE* outfs);
+
+// sparse: reads 'numEntries' entries at the current position into the
+// (zeroed) row 'vals' of 'numMetrics' values
+int
+hpcmetricDB_fmt_sparse_row_fread(double* vals, uint32_t numMetrics,
+				 uint64_t numEntries, FILE* infs);
+
+// sparse: reads the row of node 'nodeId' (>= 1) using the node index
+int
+hpcmetricDB_fmt_sparse_node_fread(const hpcmetricDB_fmt_hdr_t* hdr,
+				  const uint64_t* index, uint32_t nodeId,
+				  double* vals, FILE* infs);
+
 // --------------------------------------------------------------------------
 // additional sampling info
 // --------------------------------------------------------------------------
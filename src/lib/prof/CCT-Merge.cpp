@@ -91,7 +91,8 @@ namespace CCT {
 //***************************************************************************
 
 MergeContext::MergeContext(Tree* cct, bool doTrackCPIds)
-  : m_cct(cct), m_mrgFlag(0), m_isTrackingCPIds(doTrackCPIds)
+  : m_cct(cct), m_mrgFlag(0), m_mergedNodes(NULL),
+    m_isTrackingCPIds(doTrackCPIds)
 {
   if (isTrackingCPIds()) {
     fillCPIdSet(cct);
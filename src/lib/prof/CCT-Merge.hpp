@@ -140,6 +140,7 @@ namespace Prof {
 namespace CCT {
 
 class Tree;
+class ANode;
 
 enum {
   // -------------------------------------------------------
@@ -185,6 +186,19 @@ public:
   { return (m_mrgFlag & MrgFlg_PropagateEffects); }
 
 
+  // -------------------------------------------------------
+  // mergedNodes: if non-NULL, collects the nodes of the destination
+  // tree that receive metric values during the merge
+  // -------------------------------------------------------
+  void
+  mergedNodes(std::vector<ANode*>* x)
+  { m_mergedNodes = x; }
+
+  std::vector<ANode*>*
+  mergedNodes() const
+  { return m_mergedNodes; }
+
+
   // -------------------------------------------------------
   //
   // -------------------------------------------------------
@@ -263,6 +277,8 @@ private:
 
   uint m_mrgFlag;
 
+  std::vector<ANode*>* m_mergedNodes;
+
   bool m_isTrackingCPIds;
   CPIdSet m_cpIdSet;
 };
@@ -74,10 +74,16 @@ using std::vector;
 #include <set>
 using std::set;
 
+#include <map>
+#include <algorithm>
+
 #include <typeinfo>
 
+#include <pthread.h>
+
 //*************************** User Include Files ****************************
 
+#include <include/hpctoolkit-config.h>
 #include <include/gcc-attr.h>
 #include <include/uint.h>
 
@@ -95,6 +101,10 @@ using SrcFile::ln_NULL;
 
 #include <lib/support/dictionary.h>
 
+#ifdef ENABLE_OPENMP
+#include <omp.h>
+#endif
+
 //*************************** Forward Declarations ***************************
 
 
@@ -146,7 +156,7 @@ namespace CCT {
 Tree::Tree(const CallPath::Profile* metadata)
   : m_root(NULL), m_metadata(metadata),
     m_maxDenseId(0), m_nodeidMap(NULL),
-    m_mergeCtxt(NULL)
+    m_mergeCtxt(NULL), m_mergedNodes(NULL)
 {
 }
 
@@ -203,6 +213,7 @@ Tree::merge(const Tree* y, uint x_newMetricBegIdx, uint mrgFlag, uint oFlag)
     m_mergeCtxt = new MergeContext(x, doTrackCPIds);
   }
   m_mergeCtxt->flags(mrgFlag);
+  m_mergeCtxt->mergedNodes(m_mergedNodes);
   
   MergeEffectList* mrgEffects =
     x_root->mergeDeep(y_root, x_newMetricBegIdx, *m_mergeCtxt, oFlag);
@@ -286,6 +297,175 @@ Tree::writeXML(std::ostream& os, uint metricBeg, uint metricEnd,
 }
 
 
+// lt_StructureInfo: orders children as ANodeSortedChildIterator does
+// with ANodeSortedIterator::cmpByStructureInfo (a total order)
+struct lt_StructureInfo
+{
+  bool
+  operator()(ANode* x, ANode* y) const
+  { return (ANodeSortedIterator::cmpByStructureInfo(&x, &y) < 0); }
+};
+
+
+// appendSortedChildren: append the children of 'node' to 'vec', in
+// writeXML() order
+static void
+appendSortedChildren(const ANode* node, ANode::Vec& vec)
+{
+  size_t begIdx = vec.size();
+  for (ANodeChildIterator it(node); it.Current(); it++) {
+    vec.push_back(it.current());
+  }
+  std::sort(vec.begin() + begIdx, vec.end(), lt_StructureInfo());
+}
+
+
+#ifdef ENABLE_OPENMP
+
+// XMLChunk: a piece of writeXMLBuffered() output: either a whole
+// subtree or the opening (Pre) or closing (Post) tags of a node whose
+// children are separate chunks.
+struct XMLChunk
+{
+  enum Kind { Subtree, Pre, Post };
+
+  XMLChunk(const ANode* n, uint d, Kind k, uint sz)
+    : node(n), depth(d), kind(k), size(sz)
+  { }
+
+  const ANode* node;
+  uint depth;
+  Kind kind;
+  uint size; // number of nodes written
+};
+
+
+// XMLChunk_MaxNodes: bounds the nodes (and thus the memory) formatted
+// per task of writeXMLBuffered()
+static const uint XMLChunk_MaxNodes = 4096;
+
+
+// makeXMLChunks: append to 'chunks' the chunks that, written in order,
+// form the subtree rooted at 'node': the whole subtree if it has at
+// most 'maxNodes' nodes; otherwise node's tags around the chunks of its
+// children.  Returns the size of the subtree.
+static uint
+makeXMLChunks(const ANode* node, uint depth, uint maxNodes,
+	      std::vector<XMLChunk>& chunks)
+{
+  size_t begIdx = chunks.size();
+  chunks.push_back(XMLChunk(node, depth, XMLChunk::Pre, 1));
+
+  ANode::Vec kids;
+  appendSortedChildren(node, kids);
+
+  uint size = 1;
+  for (uint k = 0; k < kids.size(); ++k) {
+    size += makeXMLChunks(kids[k], depth + 1, maxNodes, chunks);
+  }
+
+  if (size <= maxNodes) {
+    chunks.erase(chunks.begin() + begIdx, chunks.end());
+    chunks.push_back(XMLChunk(node, depth, XMLChunk::Subtree, size));
+  }
+  else {
+    chunks.push_back(XMLChunk(node, depth, XMLChunk::Post, 0));
+  }
+  return size;
+}
+
+
+// makeXMLTasks: group consecutive 'chunks' into tasks of at most
+// 'maxNodes' nodes (unless a chunk alone is larger); task i is
+// [tasks[i], tasks[i+1]).
+static void
+makeXMLTasks(const std::vector<XMLChunk>& chunks, uint maxNodes,
+	     std::vector<uint>& tasks)
+{
+  tasks.clear();
+  uint taskSz = 0;
+  for (uint i = 0; i < chunks.size(); ++i) {
+    if (i == 0 || taskSz + chunks[i].size > maxNodes) {
+      tasks.push_back(i);
+      taskSz = 0;
+    }
+    taskSz += chunks[i].size;
+  }
+  tasks.push_back(chunks.size());
+}
+
+#endif // ENABLE_OPENMP
+
+
+std::ostream&
+Tree::writeXMLBuffered(std::ostream& os, uint metricBeg, uint metricEnd,
+		       uint oFlags, uint GCC_ATTR_UNUSED numThreads) const
+{
+  if (!m_root) {
+    return os;
+  }
+
+#ifdef ENABLE_OPENMP
+  // N.B.: debugging output is formatted through (non-reentrant) strings
+  if (numThreads > 1 && ANode::isWriteXMLMeOk(oFlags)) {
+    // -------------------------------------------------------
+    // Format tasks (runs of chunks of bounded size) in parallel, each
+    // thread into its own (reused) buffer, and stream each task's
+    // output to 'os' in order as soon as its predecessors are written.
+    // At most one task per thread is buffered.
+    // -------------------------------------------------------
+    std::vector<XMLChunk> chunks;
+    makeXMLChunks(m_root, 0, XMLChunk_MaxNodes, chunks);
+
+    std::vector<uint> tasks;
+    makeXMLTasks(chunks, XMLChunk_MaxNodes, tasks);
+    int numTasks = (int)tasks.size() - 1;
+
+    std::vector<xml::OutBuffer*> bufs(numThreads);
+    for (uint i = 0; i < numThreads; ++i) {
+      bufs[i] = new xml::OutBuffer(NULL, (1 << 16));
+    }
+
+#pragma omp parallel for ordered num_threads(numThreads) schedule(dynamic, 1)
+    for (int t = 0; t < numTasks; ++t) {
+      xml::OutBuffer& buf = *bufs[omp_get_thread_num()];
+      ANode::Vec scratch;
+
+      for (uint i = tasks[t]; i < tasks[t + 1]; ++i) {
+	const XMLChunk& c = chunks[i];
+	switch (c.kind) {
+	  case XMLChunk::Subtree:
+	    c.node->writeXML(buf, metricBeg, metricEnd, oFlags, c.depth,
+			     scratch);
+	    break;
+	  case XMLChunk::Pre:
+	    c.node->writeXML_pre(buf, metricBeg, metricEnd, oFlags, c.depth);
+	    break;
+	  case XMLChunk::Post:
+	    c.node->writeXML_post(buf, oFlags, c.depth);
+	    break;
+	}
+      }
+
+#pragma omp ordered
+      buf.writeTo(os);
+    }
+
+    for (uint i = 0; i < numThreads; ++i) {
+      delete bufs[i];
+    }
+    return os;
+  }
+#endif
+
+  xml::OutBuffer buf(&os);
+  ANode::Vec scratch;
+  m_root->writeXML(buf, metricBeg, metricEnd, oFlags, 0, scratch);
+  buf.flush();
+  return os;
+}
+
+
 std::ostream& 
 Tree::dump(std::ostream& os, uint oFlags) const
 {
@@ -337,6 +517,124 @@ ANode::IntToANodeType(long i)
 uint ANode::s_nextUniqueId = 2;
 
 
+//***************************************************************************
+// ANode: allocation
+//***************************************************************************
+
+// Nodes are carved from large chunks and recycled through free lists
+// segregated by (rounded) size.  Nodes migrate between trees when
+// profiles are merged, so the pool is not tied to a tree or profile.
+// Because profiles may be read concurrently (cf. hpcprof --threads),
+// each thread keeps a short private free list per size class and
+// exchanges batches of free nodes with a shared, locked list; thus a
+// node freed by one thread is available to all others, and a thread
+// that exits strands at most a few batches.  Chunks are never returned.
+
+static const size_t NodePool_Align = 16;
+static const size_t NodePool_NumSzClasses = 32; // up to 496 bytes
+static const size_t NodePool_ChunkSz = 256 * 1024;
+static const uint   NodePool_BatchSz = 64;
+
+struct NodePoolFreeItem {
+  NodePoolFreeItem* next;
+  NodePoolFreeItem* nextBatch; // for the first item of a shared batch
+};
+
+static __thread NodePoolFreeItem* s_nodePoolFree[NodePool_NumSzClasses];
+static __thread uint s_nodePoolNumFree[NodePool_NumSzClasses];
+static __thread char* s_nodePoolCur = NULL;
+static __thread size_t s_nodePoolAvail = 0;
+
+static NodePoolFreeItem* s_nodePoolShared[NodePool_NumSzClasses];
+static pthread_mutex_t s_nodePoolLock[NodePool_NumSzClasses];
+static pthread_once_t s_nodePoolOnce = PTHREAD_ONCE_INIT;
+
+
+static void
+nodePoolInit()
+{
+  for (uint i = 0; i < NodePool_NumSzClasses; ++i) {
+    pthread_mutex_init(&s_nodePoolLock[i], NULL);
+  }
+}
+
+
+void*
+ANode::operator new(size_t sz)
+{
+  size_t szClass = (sz + NodePool_Align - 1) / NodePool_Align;
+  if (szClass >= NodePool_NumSzClasses) {
+    return ::operator new(sz);
+  }
+
+  NodePoolFreeItem* x = s_nodePoolFree[szClass];
+  if (!x) {
+    // refill the private list with a shared batch, if any
+    pthread_once(&s_nodePoolOnce, nodePoolInit);
+    pthread_mutex_lock(&s_nodePoolLock[szClass]);
+    x = s_nodePoolShared[szClass];
+    if (x) {
+      s_nodePoolShared[szClass] = x->nextBatch;
+    }
+    pthread_mutex_unlock(&s_nodePoolLock[szClass]);
+    s_nodePoolNumFree[szClass] = (x) ? NodePool_BatchSz : 0;
+  }
+  if (x) {
+    s_nodePoolFree[szClass] = x->next;
+    s_nodePoolNumFree[szClass]--;
+    return x;
+  }
+
+  size_t blkSz = szClass * NodePool_Align;
+  if (s_nodePoolAvail < blkSz) {
+    s_nodePoolCur = static_cast<char*>(::operator new(NodePool_ChunkSz));
+    s_nodePoolAvail = NodePool_ChunkSz;
+  }
+  void* blk = s_nodePoolCur;
+  s_nodePoolCur += blkSz;
+  s_nodePoolAvail -= blkSz;
+  return blk;
+}
+
+
+void
+ANode::operator delete(void* p, size_t sz)
+{
+  if (!p) {
+    return;
+  }
+
+  size_t szClass = (sz + NodePool_Align - 1) / NodePool_Align;
+  if (szClass >= NodePool_NumSzClasses) {
+    ::operator delete(p);
+    return;
+  }
+
+  NodePoolFreeItem* x = static_cast<NodePoolFreeItem*>(p);
+  x->next = s_nodePoolFree[szClass];
+  s_nodePoolFree[szClass] = x;
+
+  if (++s_nodePoolNumFree[szClass] < 2 * NodePool_BatchSz) {
+    return;
+  }
+
+  // move a batch from the private list to the shared list
+  NodePoolFreeItem* last = x;
+  for (uint i = 1; i < NodePool_BatchSz; ++i) {
+    last = last->next;
+  }
+  s_nodePoolFree[szClass] = last->next;
+  s_nodePoolNumFree[szClass] -= NodePool_BatchSz;
+  last->next = NULL;
+
+  pthread_once(&s_nodePoolOnce, nodePoolInit);
+  pthread_mutex_lock(&s_nodePoolLock[szClass]);
+  x->nextBatch = s_nodePoolShared[szClass];
+  s_nodePoolShared[szClass] = x;
+  pthread_mutex_unlock(&s_nodePoolLock[szClass]);
+}
+
+
 //***************************************************************************
 // ANode, etc: constructors/destructors
 //***************************************************************************
@@ -481,10 +779,8 @@ ANode::aggregateMetricsIncl(const VMAIntervalSet& ivalset)
 	const VMAInterval& ival = *it1;
 	uint mBegId = (uint)ival.beg(), mEndId = (uint)ival.end();
 
-	for (uint mId = mBegId; mId < mEndId; ++mId) {
-	  double mVal = n->demandMetric(mId, mEndId/*size*/);
-	  n_parent->demandMetric(mId, mEndId/*size*/) += mVal;
-	}
+	n->ensureMetricsSize(mEndId);
+	n_parent->accumulateMetrics(*n, mBegId, mEndId, mBegId);
       }
     }
   }
@@ -514,25 +810,22 @@ ANode::aggregateMetricsExcl(const VMAIntervalSet& ivalset)
 }
 
 
-void
-ANode::aggregateMetricsExcl(AProcNode* frame, const VMAIntervalSet& ivalset)
+// isLogicalProc: Returns true if 'n' is the frame of a procedure,
+// either a ProcFrm or an inlined Proc (inline call or macro); sets
+// 'isInlineMacro' accordingly.
+//
+// laks 2015.10.21: we don't want accumulate the exclusive cost of 
+// an inlined statement to the caller. Instead, we assume an inline
+// function (Proc) as the same as a normal procedure (ProcFrm).
+// And the lowest common ancestor for Proc and ProcFrm is AProcNode.
+static bool
+isLogicalProc(ANode* n, bool& isInlineMacro)
 {
-  ANode* n = this;
-
-  // -------------------------------------------------------
-  // Pre-order visit
-  // -------------------------------------------------------
-  //
-  // laks 2015.10.21: we don't want accumulate the exclusive cost of 
-  // an inlined statement to the caller. Instead, we assume an inline
-  // function (Proc) as the same as a normal procedure (ProcFrm).
-  // And the lowest common ancestor for Proc and ProcFrm is AProcNode.
-  //
   bool isFrame = (typeid(*n) == typeid(ProcFrm));
   bool isProc  = (typeid(*n) == typeid(Proc));
 
-  bool isInlineMacro = false;
   bool isInlineCall  = false;
+  isInlineMacro = false;
 
   NonUniformDegreeTreeNode *parent = n->Parent();
   if (isProc && parent != NULL) {
@@ -557,8 +850,21 @@ ANode::aggregateMetricsExcl(AProcNode* frame, const VMAIntervalSet& ivalset)
     isInlineMacro = !isInlineCall && myprocname.compare(GUARD_NAME) == 0;
   }
 
-  bool isLogicalProc   = isFrame || isInlineCall || isInlineMacro;
-  AProcNode * frameNxt = (isLogicalProc) ? static_cast<AProcNode*>(n) : frame;
+  return (isFrame || isInlineCall || isInlineMacro);
+}
+
+
+void
+ANode::aggregateMetricsExcl(AProcNode* frame, const VMAIntervalSet& ivalset)
+{
+  ANode* n = this;
+
+  // -------------------------------------------------------
+  // Pre-order visit
+  // -------------------------------------------------------
+  bool isInlineMacro = false;
+  bool isLogicalProc_n = isLogicalProc(n, isInlineMacro);
+  AProcNode * frameNxt = (isLogicalProc_n) ? static_cast<AProcNode*>(n) : frame;
 
   // -------------------------------------------------------
   // Tree traversal
@@ -579,21 +885,105 @@ ANode::aggregateMetricsExcl(AProcNode* frame, const VMAIntervalSet& ivalset)
       const VMAInterval& ival = *it;
       uint mBegId = (uint)ival.beg(), mEndId = (uint)ival.end();
 
-      for (uint mId = mBegId; mId < mEndId; ++mId) {
-        double mVal = n->demandMetric(mId, mEndId/*size*/);
-        n_parent->demandMetric(mId, mEndId/*size*/) += mVal;
-        if (frame && frame != n_parent) {
-          frame->demandMetric(mId, mEndId/*size*/) += mVal;
-        }
+      n->ensureMetricsSize(mEndId);
+      n_parent->accumulateMetrics(*n, mBegId, mEndId, mBegId);
+      if (frame && frame != n_parent) {
+        frame->accumulateMetrics(*n, mBegId, mEndId, mBegId);
+      }
+    }
+  }
+}
+
+
+// computeMetricsBatch: Compute derived metrics [mBegId, mEndId) for
+// 'nodes' (cf. ANode::computeMetricsMe() if 'isIncr' is false and
+// ANode::computeMetricsIncrMe() otherwise) by compiling each metric's
+// expression to a Metric::AExprProgram and evaluating it over blocks of
+// nodes.  Within a block, metrics are computed in id order so that
+// (point-wise) dependences between derived metrics are respected.
+// Expressions that cannot be compiled are evaluated node by node.
+static void
+computeMetricsBatch(const ANode::Vec& nodes, const Metric::Mgr& mMgr,
+		    uint mBegId, uint mEndId, bool isIncr, bool doFinal,
+		    Metric::AExprIncr::FnTy fn)
+{
+  uint numProgs = mEndId - mBegId;
+  vector<Metric::AExprProgram*> progs(numProgs, (Metric::AExprProgram*)NULL);
+  vector<bool> isDerived(numProgs, false);
+
+  for (uint mId = mBegId; mId < mEndId; ++mId) {
+    const Metric::ADesc* m = mMgr.metric(mId);
+    Metric::AExprProgram* prog = new Metric::AExprProgram;
+    bool isCompiled = false;
+
+    if (isIncr) {
+      const Metric::DerivedIncrDesc* mm =
+	dynamic_cast<const Metric::DerivedIncrDesc*>(m);
+      if (mm && mm->expr()) {
+	isDerived[mId - mBegId] = true;
+	isCompiled = mm->expr()->compile(*prog, fn);
+      }
+    }
+    else {
+      const Metric::DerivedDesc* mm =
+	dynamic_cast<const Metric::DerivedDesc*>(m);
+      if (mm && mm->expr()) {
+	isDerived[mId - mBegId] = true;
+	isCompiled = mm->expr()->compileNF(*prog);
+	if (isCompiled && doFinal) {
+	  isCompiled = mm->expr()->compile(*prog);
+	  prog->emitStore(mId);
+	}
+      }
+    }
+
+    if (isCompiled) {
+      progs[mId - mBegId] = prog;
+    }
+    else {
+      delete prog;
+    }
+  }
+
+  vector<Metric::IData*> data(nodes.begin(), nodes.end());
+  uint size = (!isIncr && doFinal) ? mMgr.size() : 0;
+
+  for (uint beg = 0; beg < nodes.size();
+       beg += Metric::AExprProgram::BlockSz) {
+    uint end = std::min((uint)nodes.size(),
+			beg + Metric::AExprProgram::BlockSz);
+
+    for (uint mId = mBegId; mId < mEndId; ++mId) {
+      const Metric::AExprProgram* prog = progs[mId - mBegId];
+      if (prog) {
+	prog->execute(&data[beg], end - beg, size);
+      }
+      else if (isDerived[mId - mBegId]) {
+	for (uint i = beg; i < end; ++i) {
+	  if (isIncr) {
+	    nodes[i]->computeMetricsIncrMe(mMgr, mId, mId + 1, fn);
+	  }
+	  else {
+	    nodes[i]->computeMetricsMe(mMgr, mId, mId + 1, doFinal);
+	  }
+	}
       }
     }
+
+    for (uint i = beg; i < end; ++i) {
+      nodes[i]->pruneZeroMetrics();
+    }
+  }
+
+  for (uint i = 0; i < progs.size(); ++i) {
+    delete progs[i];
   }
 }
 
 
 void
 ANode::computeMetrics(const Metric::Mgr& mMgr, uint mBegId, uint mEndId,
-		      bool doFinal)
+		      bool doFinal, bool doBatch)
 {
   if ( !(mBegId < mEndId) ) {
     return;
@@ -602,6 +992,16 @@ ANode::computeMetrics(const Metric::Mgr& mMgr, uint mBegId, uint mEndId,
   // N.B. pre-order walk assumes point-wise metrics
   // Cf. Analysis::Flat::Driver::computeDerivedBatch().
 
+  if (doBatch) {
+    ANode::Vec nodes;
+    for (ANodeIterator it(this); it.Current(); ++it) {
+      nodes.push_back(it.current());
+    }
+    computeMetricsBatch(nodes, mMgr, mBegId, mEndId, false/*isIncr*/,
+			doFinal, Metric::AExprIncr::FnInit/*unused*/);
+    return;
+  }
+
   for (ANodeIterator it(this); it.Current(); ++it) {
     ANode* n = it.current();
     n->computeMetricsMe(mMgr, mBegId, mEndId, doFinal);
@@ -623,16 +1023,19 @@ ANode::computeMetricsMe(const Metric::Mgr& mMgr, uint mBegId, uint mEndId,
       expr->evalNF(*this);
       if (doFinal) {
 	double val = expr->eval(*this);
-	demandMetric(mId, numMetrics/*size*/) = val;
+	ensureMetricsSize(std::max(numMetrics, mId + 1));
+	setMetric(mId, val);
       }
     }
   }
+
+  pruneZeroMetrics();
 }
 
 
 void
 ANode::computeMetricsIncr(const Metric::Mgr& mMgr, uint mBegId, uint mEndId,
-			  Metric::AExprIncr::FnTy fn)
+			  Metric::AExprIncr::FnTy fn, bool doBatch)
 {
   if ( !(mBegId < mEndId) ) {
     return;
@@ -641,6 +1044,16 @@ ANode::computeMetricsIncr(const Metric::Mgr& mMgr, uint mBegId, uint mEndId,
   // N.B. pre-order walk assumes point-wise metrics
   // Cf. Analysis::Flat::Driver::computeDerivedBatch().
 
+  if (doBatch) {
+    ANode::Vec nodes;
+    for (ANodeIterator it(this); it.Current(); ++it) {
+      nodes.push_back(it.current());
+    }
+    computeMetricsBatch(nodes, mMgr, mBegId, mEndId, true/*isIncr*/,
+			false/*doFinal*/, fn);
+    return;
+  }
+
   for (ANodeIterator it(this); it.Current(); ++it) {
     ANode* n = it.current();
     n->computeMetricsIncrMe(mMgr, mBegId, mEndId, fn);
@@ -674,6 +1087,8 @@ ANode::computeMetricsIncrMe(const Metric::Mgr& mMgr, uint mBegId, uint mEndId,
       }
     }
   }
+
+  pruneZeroMetrics();
 }
 
 
@@ -705,9 +1120,9 @@ ANode::pruneByMetrics(const Metric::Mgr& mMgr, const VMAIntervalSet& ivalset,
 	}
 	numIncl++;
 	
-	double total = root->metric(mId); // root->metric(m->partner()->id());
+	double total = root->peekMetric(mId); // root->metric(m->partner()->id());
 	
-	double pct = x->metric(mId) * 100 / total;
+	double pct = x->peekMetric(mId) * 100 / total;
 	if (pct >= thresholdPct) {
 	  isImportant = true;
 	  break;
@@ -810,6 +1225,103 @@ ANode::deleteChaff(ANode* x, uint8_t* deletedNodes)
 // Merging
 //**********************************************************************
 
+// DynChildIndex: A transient index of the direct ADynNode descendents
+//   of a node (cf. ANode::findDynChild()), keyed by those parts of
+//   ADynNode::isMergable() that form an equivalence.  Candidates with
+//   equal keys are kept in descendent order and filtered with
+//   isMergable(), so lookups return the same node as findDynChild().
+class DynChildIndex
+{
+public:
+  DynChildIndex(ANode* x)
+    : m_node(x)
+  { insertDescendents(x); }
+
+  ADynNode*
+  find(const ADynNode& y_dyn) const
+  {
+    // isMergable()'s structure-based test cannot be keyed
+    if (y_dyn.structure()) {
+      return m_node->findDynChild(y_dyn);
+    }
+
+    std::pair<KeyToNodeMap::const_iterator, KeyToNodeMap::const_iterator>
+      rng = m_map.equal_range(Key(y_dyn));
+    for (KeyToNodeMap::const_iterator it = rng.first; it != rng.second; ++it) {
+      ADynNode* x_dyn = it->second;
+      if (ADynNode::isMergable(*x_dyn, y_dyn)) {
+	return x_dyn;
+      }
+    }
+    return NULL;
+  }
+
+  // insert: 'x_dyn' must be the last direct ADynNode descendent
+  void
+  insert(ADynNode* x_dyn)
+  { m_map.insert(std::make_pair(Key(*x_dyn), x_dyn)); }
+
+private:
+  struct Key {
+    Key(const ADynNode& x)
+      : isLeaf(x.isLeaf()), lmId(x.lmId_real()), lmIP(x.lmIP_real()),
+	hasLip(x.lip() != NULL), lip0(0), lip1(0),
+	pathLen(lush_assoc_info__get_path_len(x.assocInfo()))
+    {
+      if (hasLip) {
+	lip0 = x.lip()->data8[0];
+	lip1 = x.lip()->data8[1];
+      }
+    }
+
+    bool
+    operator<(const Key& y) const
+    {
+      if (lmIP != y.lmIP)     { return (lmIP < y.lmIP); }
+      if (lmId != y.lmId)     { return (lmId < y.lmId); }
+      if (isLeaf != y.isLeaf) { return (isLeaf < y.isLeaf); }
+      if (hasLip != y.hasLip) { return (hasLip < y.hasLip); }
+      if (lip0 != y.lip0)     { return (lip0 < y.lip0); }
+      if (lip1 != y.lip1)     { return (lip1 < y.lip1); }
+      return (pathLen < y.pathLen);
+    }
+
+    bool isLeaf;
+    LoadMap::LMId_t lmId;
+    VMA lmIP;
+    bool hasLip;
+    uint64_t lip0, lip1;
+    uint pathLen;
+  };
+
+  // N.B.: multimap keeps equal keys in insertion order
+  typedef std::multimap<Key, ADynNode*> KeyToNodeMap;
+
+  void
+  insertDescendents(ANode* x)
+  {
+    for (ANodeChildIterator it(x); it.Current(); ++it) {
+      ANode* x_child = it.current();
+      ADynNode* x_dyn = dynamic_cast<ADynNode*>(x_child);
+      if (x_dyn) {
+	insert(x_dyn);
+      }
+      else {
+	insertDescendents(x_child);
+      }
+    }
+  }
+
+  ANode* m_node;
+  KeyToNodeMap m_map;
+};
+
+
+// Below this many children of y, a linear ANode::findDynChild() per
+// child is cheaper than building a DynChildIndex
+static const uint DynChildIndex_MinChildren = 16;
+
+
 MergeEffectList*
 ANode::mergeDeep(ANode* y, uint x_newMetricBegIdx, MergeContext& mrgCtxt,
 		 uint oFlag)
@@ -832,6 +1344,12 @@ ANode::mergeDeep(ANode* y, uint x_newMetricBegIdx, MergeContext& mrgCtxt,
   //    recur.
   // ------------------------------------------------------------
   MergeEffectList* effctLst = new MergeEffectList;
+
+  // avoid a quadratic search when merging nodes with a wide fan-out
+  DynChildIndex* x_childIdx = NULL;
+  if (y->childCount() >= DynChildIndex_MinChildren) {
+    x_childIdx = new DynChildIndex(x);
+  }
   
   for (ANodeChildIterator it(y); it.Current(); /* */) {
     ANode* y_child = it.current();
@@ -841,7 +1359,8 @@ ANode::mergeDeep(ANode* y, uint x_newMetricBegIdx, MergeContext& mrgCtxt,
 
     MergeEffectList* effctLst1 = NULL;
 
-    ADynNode* x_child_dyn = x->findDynChild(*y_child_dyn);
+    ADynNode* x_child_dyn = (x_childIdx) ? x_childIdx->find(*y_child_dyn)
+                                         : x->findDynChild(*y_child_dyn);
 
 #define MERGE_ACTION 0
 #define MERGE_ERROR 0
@@ -863,6 +1382,15 @@ ANode::mergeDeep(ANode* y, uint x_newMetricBegIdx, MergeContext& mrgCtxt,
 	effctLst1 = y_child->mergeDeep_fixInsert(x_newMetricBegIdx, mrgCtxt);
 
 	y_child->link(x);
+	if (x_childIdx) {
+	  x_childIdx->insert(y_child_dyn);
+	}
+
+	if (mrgCtxt.mergedNodes()) {
+	  for (ANodeIterator it1(y_child); it1.Current(); ++it1) {
+	    mrgCtxt.mergedNodes()->push_back(it1.current());
+	  }
+	}
       }
     }
     else {
@@ -873,6 +1401,9 @@ ANode::mergeDeep(ANode* y, uint x_newMetricBegIdx, MergeContext& mrgCtxt,
 		 << "\n  y: " << y_child_dyn->toStringMe(Tree::OFlg_Debug));
       MergeEffect effct =
 	x_child_dyn->mergeMe(*y_child_dyn, &mrgCtxt, x_newMetricBegIdx);
+      if (mrgCtxt.mergedNodes()) {
+	mrgCtxt.mergedNodes()->push_back(x_child_dyn);
+      }
       if (mrgCtxt.doPropagateEffects() && !effct.isNoop()) {
 	effctLst->push_back(effct);
       }
@@ -888,6 +1419,8 @@ ANode::mergeDeep(ANode* y, uint x_newMetricBegIdx, MergeContext& mrgCtxt,
     delete effctLst1;
   }
 
+  delete x_childIdx;
+
   return effctLst;
 }
 
@@ -921,14 +1454,7 @@ ANode::mergeMe(const ANode& y, MergeContext* GCC_ATTR_UNUSED mrgCtxt,
 {
   ANode* x = this;
   
-  uint x_end = metricBegIdx + y.numMetrics(); // open upper bound
-  if ( !(x_end <= x->numMetrics()) ) {
-    ensureMetricsSize(x_end);
-  }
-
-  for (uint x_i = metricBegIdx, y_i = 0; x_i < x_end; ++x_i, ++y_i) {
-    x->metric(x_i) += y.metric(y_i);
-  }
+  x->accumulateMetrics(y, 0, y.numMetrics(), metricBegIdx);
   
   MergeEffect noopEffect;
   return noopEffect;
@@ -1374,6 +1900,121 @@ Stmt::toStringMe(uint oFlags) const
 }
 
 
+bool
+ANode::isWriteXMLMeOk(uint oFlags)
+{
+  return (!(oFlags & (Tree::OFlg_Debug | Tree::OFlg_DebugAll))
+	  && Diagnostics_GetDiagnosticFilterLevel() <= 2);
+}
+
+
+void
+ANode::writeXMLMe(xml::OutBuffer& buf, uint GCC_ATTR_UNUSED oFlags) const
+{
+  ANodeTy node_type = type();
+  buf.put(ANodeTyToName(node_type));
+
+  uint sId = (m_strct) ? m_strct->id() : 0;
+  if (node_type == TyProcFrm || node_type == TyProc) {
+    sId = getProcIdFromMap(sId);
+  }
+
+  buf.put(" i", 2);
+  buf.putAttrNum(m_id);
+  buf.put(" s", 2);
+  buf.putAttrNum(sId);
+  buf.put(" l", 2);
+  buf.putAttrNum(begLine());
+}
+
+
+// writeXMLStructId: cf. OFlg_StructId in toStringMe()
+static inline void
+writeXMLStructId(xml::OutBuffer& buf, const ANode* n, uint oFlags)
+{
+  if ((oFlags & CCT::Tree::OFlg_StructId) && n->structure() != NULL) {
+    buf.put(" str", 4);
+    buf.putAttrNum(n->structure()->m_origId);
+  }
+}
+
+
+void
+Root::writeXMLMe(xml::OutBuffer& buf, uint oFlags) const
+{
+  ANode::writeXMLMe(buf, oFlags);
+  buf.put(" n", 2);
+  buf.putAttrStr(m_name);
+}
+
+
+void
+ProcFrm::writeXMLMe(xml::OutBuffer& buf, uint oFlags) const
+{
+  ANode::writeXMLMe(buf, oFlags);
+
+  if (m_strct) {
+    buf.put(" lm", 3);
+    buf.putAttrNum(getLoadModuleFromMap(lmId()));
+    buf.put(" f", 2);
+    buf.putAttrNum(getFileIdFromMap(fileId()));
+    buf.put(" n", 2);
+    buf.putAttrNum(getProcIdFromMap(procId()));
+    writeXMLStructId(buf, this, oFlags);
+  }
+}
+
+
+void
+Proc::writeXMLMe(xml::OutBuffer& buf, uint oFlags) const
+{
+  ANode::writeXMLMe(buf, oFlags);
+
+  if (m_strct) {
+    buf.put(" lm", 3);
+    buf.putAttrNum(lmId());
+    buf.put(" f", 2);
+    buf.putAttrNum(getFileIdFromMap(fileId()));
+    buf.put(" n", 2);
+    buf.putAttrNum(getProcIdFromMap(procId()));
+    if (isAlien()) {
+      buf.put(" a=\"1\"", 6);
+    }
+    writeXMLStructId(buf, this, oFlags);
+  }
+}
+
+
+void
+Loop::writeXMLMe(xml::OutBuffer& buf, uint oFlags) const
+{
+  ANode::writeXMLMe(buf, oFlags);
+  buf.put(" f", 2);
+  buf.putAttrNum(getFileIdFromMap(fileId()));
+  writeXMLStructId(buf, this, oFlags);
+}
+
+
+void
+Call::writeXMLMe(xml::OutBuffer& buf, uint oFlags) const
+{
+  ANode::writeXMLMe(buf, oFlags);
+  writeXMLStructId(buf, this, oFlags);
+}
+
+
+void
+Stmt::writeXMLMe(xml::OutBuffer& buf, uint oFlags) const
+{
+  ANode::writeXMLMe(buf, oFlags);
+  if (hpcrun_fmt_doRetainId(cpId())) {
+    buf.put(" it", 3);
+    buf.putAttrNum(cpId());
+  }
+  writeXMLStructId(buf, this, oFlags);
+}
+
+
 std::ostream&
 ANode::writeXML(ostream& os, uint metricBeg, uint metricEnd,
 		uint oFlags, const char* pfx) const
@@ -1493,6 +2134,248 @@ ANode::writeXML_post(ostream& os, uint GCC_ATTR_UNUSED oFlags,
 }
 
 
+void
+ANode::writeXML(xml::OutBuffer& buf, uint metricBeg, uint metricEnd,
+		uint oFlags, uint depth, ANode::Vec& scratch) const
+{
+  bool doPost = writeXML_pre(buf, metricBeg, metricEnd, oFlags, depth);
+
+  // N.B.: 'scratch' may be reallocated by descendants; use indices
+  size_t kidsBeg = scratch.size();
+  appendSortedChildren(this, scratch);
+  size_t kidsEnd = scratch.size();
+  for (size_t i = kidsBeg; i < kidsEnd; ++i) {
+    scratch[i]->writeXML(buf, metricBeg, metricEnd, oFlags, depth + 1,
+			 scratch);
+  }
+  scratch.resize(kidsBeg);
+
+  if (doPost) {
+    writeXML_post(buf, oFlags, depth);
+  }
+}
+
+
+bool
+ANode::writeXML_pre(xml::OutBuffer& buf, uint metricBeg, uint metricEnd,
+		    uint oFlags, uint depth) const
+{
+  bool doTag = (type() != TyRoot);
+  bool doMetrics = ((oFlags & Tree::OFlg_LeafMetricsOnly)
+		    ? isLeaf() && hasMetrics(metricBeg, metricEnd)
+		    : hasMetrics(metricBeg, metricEnd));
+  bool isXMLLeaf = isLeaf() && !doMetrics;
+  uint indent = (oFlags & Tree::OFlg_Compressed) ? 0 : 2 * depth;
+
+  // 1. Write element name
+  if (doTag) {
+    buf.putSpaces(indent);
+    buf.put('<');
+    if (isWriteXMLMeOk(oFlags)) {
+      writeXMLMe(buf, oFlags);
+    }
+    else {
+      buf.put(toStringMe(oFlags));
+    }
+    if (isXMLLeaf) {
+      buf.put("/>\n", 3);
+    }
+    else {
+      buf.put(">\n", 2);
+    }
+  }
+
+  // 2. Write associated metrics
+  if (doMetrics) {
+    writeMetricsXML(buf, metricBeg, metricEnd, oFlags, indent);
+    buf.put('\n');
+  }
+
+  return !isXMLLeaf; // whether to execute writeXML_post()
+}
+
+
+void
+ANode::writeXML_post(xml::OutBuffer& buf, uint oFlags, uint depth) const
+{
+  bool doTag = (type() != ANode::TyRoot);
+  if (!doTag) {
+    return;
+  }
+
+  buf.putSpaces((oFlags & Tree::OFlg_Compressed) ? 0 : 2 * depth);
+  buf.put("</", 2);
+  buf.put(ANodeTyToName(type()));
+  buf.put(">\n", 2);
+}
+
+
+//***************************************************************************
+// PathSet
+//***************************************************************************
+
+PathSet::PathSet(const ANode::Vec& nodes)
+{
+  typedef std::map<ANode*, uint> ANodeToDepthMap;
+
+  // -------------------------------------------------------
+  // Close 'nodes' under the ancestor relation, noting each node's
+  // depth.  Each upward walk stops at the first node already seen.
+  // -------------------------------------------------------
+  ANodeToDepthMap depthMap;
+  ANode::Vec path;
+
+  for (uint i = 0; i < nodes.size(); ++i) {
+    path.clear();
+
+    uint depth = 0;
+    for (ANode* x = nodes[i]; x; x = x->parent()) {
+      ANodeToDepthMap::iterator it = depthMap.find(x);
+      if (it != depthMap.end()) {
+	depth = it->second + 1;
+	break;
+      }
+      path.push_back(x);
+    }
+
+    for (uint j = path.size(); j > 0; --j, ++depth) {
+      depthMap.insert(std::make_pair(path[j - 1], depth));
+    }
+  }
+
+  // -------------------------------------------------------
+  // Order nodes from deepest to shallowest (ties by id for
+  // determinism) so that descendants precede their ancestors
+  // -------------------------------------------------------
+  std::vector<std::pair<uint, ANode*> > order;
+  order.reserve(depthMap.size());
+  for (ANodeToDepthMap::iterator it = depthMap.begin();
+       it != depthMap.end(); ++it) {
+    order.push_back(std::make_pair(it->second, it->first));
+  }
+  std::sort(order.begin(), order.end(), PathSet::cmpDeepestFirst);
+
+  m_nodes.reserve(order.size());
+  for (uint i = 0; i < order.size(); ++i) {
+    m_nodes.push_back(order[i].second);
+  }
+}
+
+
+bool
+PathSet::cmpDeepestFirst(const std::pair<uint, ANode*>& x,
+			 const std::pair<uint, ANode*>& y)
+{
+  if (x.first != y.first) {
+    return (x.first > y.first);
+  }
+  return (x.second->id() < y.second->id());
+}
+
+
+void
+PathSet::aggregateMetricsIncl(const VMAIntervalSet& ivalset)
+{
+  if (ivalset.empty()) {
+    return; // short circuit
+  }
+
+  for (uint i = 0; i < m_nodes.size(); ++i) {
+    ANode* n = m_nodes[i];
+    ANode* n_parent = n->parent();
+    if (!n_parent) {
+      continue;
+    }
+
+    for (VMAIntervalSet::const_iterator it = ivalset.begin();
+	 it != ivalset.end(); ++it) {
+      const VMAInterval& ival = *it;
+      uint mBegId = (uint)ival.beg(), mEndId = (uint)ival.end();
+
+      n->ensureMetricsSize(mEndId);
+      n_parent->accumulateMetrics(*n, mBegId, mEndId, mBegId);
+    }
+  }
+}
+
+
+void
+PathSet::aggregateMetricsExcl(const VMAIntervalSet& ivalset)
+{
+  if (ivalset.empty()) {
+    return; // short circuit
+  }
+
+  for (uint i = 0; i < m_nodes.size(); ++i) {
+    ANode* n = m_nodes[i];
+
+    bool isInlineMacro = false;
+    isLogicalProc(n, isInlineMacro);
+    if ( !(typeid(*n) == typeid(CCT::Stmt) || isInlineMacro) ) {
+      continue;
+    }
+
+    // Cf. ANode::aggregateMetricsExcl(): 'frame' is the closest
+    // logical procedure strictly above 'n'
+    ANode* n_parent = n->parent();
+    AProcNode* frame = NULL;
+    for (ANode* x = n_parent; x; x = x->parent()) {
+      bool isMacro;
+      if (isLogicalProc(x, isMacro)) {
+	frame = static_cast<AProcNode*>(x);
+	break;
+      }
+    }
+
+    for (VMAIntervalSet::const_iterator it = ivalset.begin();
+	 it != ivalset.end(); ++it) {
+      const VMAInterval& ival = *it;
+      uint mBegId = (uint)ival.beg(), mEndId = (uint)ival.end();
+
+      n->ensureMetricsSize(mEndId);
+      n_parent->accumulateMetrics(*n, mBegId, mEndId, mBegId);
+      if (frame && frame != n_parent) {
+	frame->accumulateMetrics(*n, mBegId, mEndId, mBegId);
+      }
+    }
+  }
+}
+
+
+void
+PathSet::computeMetricsIncr(const Metric::Mgr& mMgr, uint mBegId, uint mEndId,
+			    Metric::AExprIncr::FnTy fn, bool doBatch)
+{
+  if ( !(mBegId < mEndId) ) {
+    return;
+  }
+
+  if (doBatch) {
+    computeMetricsBatch(m_nodes, mMgr, mBegId, mEndId, true/*isIncr*/,
+			false/*doFinal*/, fn);
+    return;
+  }
+
+  for (uint i = 0; i < m_nodes.size(); ++i) {
+    m_nodes[i]->computeMetricsIncrMe(mMgr, mBegId, mEndId, fn);
+  }
+}
+
+
+void
+PathSet::zeroMetrics(uint mBegId, uint mEndId)
+{
+  for (uint i = 0; i < m_nodes.size(); ++i) {
+    ANode* n = m_nodes[i];
+    // N.B.: a node's metric vector may be shorter than 'mEndId'
+    uint mEndId_n = std::min(mEndId, n->numMetrics());
+    if (mBegId < mEndId_n) {
+      n->zeroMetrics(mBegId, mEndId_n);
+    }
+  }
+}
+
+
 //**********************************************************************
 // 
 //**********************************************************************
@@ -178,6 +178,12 @@ public:
   merge(const Tree* y, uint x_newMetricBegIdx,
 	uint mrgFlag = 0, uint oFlag = 0);
 
+  // mergedNodes: if non-NULL, subsequent merges append to 'x' each
+  // node of 'this' that receives metric values (cf. PathSet)
+  void
+  mergedNodes(std::vector<ANode*>* x)
+  { m_mergedNodes = x; }
+
   // -------------------------------------------------------
   // dense ids (only used when explicitly requested)
   // -------------------------------------------------------
@@ -224,6 +230,17 @@ public:
 	   uint metricEnd = Metric::IData::npos,
 	   uint oFlags = 0) const;
 
+  // writeXMLBuffered: Like writeXML(), but formats through large
+  // reusable buffers (xml::OutBuffer) without per-node strings.  With
+  // 'numThreads' > 1 (and OpenMP), runs of subtrees of bounded size are
+  // formatted into per-thread buffers in parallel and streamed to 'os'
+  // in order.  The output is identical to writeXML().
+  std::ostream&
+  writeXMLBuffered(std::ostream& os,
+		   uint metricBeg = Metric::IData::npos,
+		   uint metricEnd = Metric::IData::npos,
+		   uint oFlags = 0, uint numThreads = 1) const;
+
   std::ostream&
   dump(std::ostream& os = std::cerr, uint oFlags = 0) const;
   
@@ -252,6 +269,7 @@ private:
 
   // merge information, cached here for performance
   MergeContext* m_mergeCtxt;
+  std::vector<ANode*>* m_mergedNodes; // does not own
 };
 
 
@@ -318,19 +336,15 @@ public:
   ANode(ANodeTy type, ANode* parent, Struct::ACodeNode* strct = NULL)
     : NonUniformDegreeTreeNode(parent),
       Metric::IData(),
-      m_type(type), m_id(s_nextUniqueId), m_strct(strct)
-  {
-    s_nextUniqueId += 2; // cf. HPCRUN_FMT_RetainIdFlag
-  }
+      m_type(type), m_id(nextUniqueId()), m_strct(strct)
+  { }
 
   ANode(ANodeTy type,
 	ANode* parent, Struct::ACodeNode* strct, const Metric::IData& metrics)
     : NonUniformDegreeTreeNode(parent),
       Metric::IData(metrics),
-      m_type(type), m_id(s_nextUniqueId), m_strct(strct)
-  {
-    s_nextUniqueId += 2; // cf. HPCRUN_FMT_RetainIdFlag
-  }
+      m_type(type), m_id(nextUniqueId()), m_strct(strct)
+  { }
 
   virtual ~ANode()
   { }
@@ -342,7 +356,7 @@ public:
       m_type(x.m_type), /*m_id: skip*/ m_strct(x.m_strct)
   {
     zeroLinks();
-    s_nextUniqueId += 2; // cf. HPCRUN_FMT_RetainIdFlag
+    nextUniqueId();
   }
 
   // deep copy of internals (but without children)
@@ -359,6 +373,14 @@ public:
     return *this;
   }
 
+  // Nodes are allocated from a pool rather than with a general-purpose
+  // 'new' (cf. CCT-Tree.cpp); large CCTs are read node by node.
+  static void*
+  operator new(size_t sz);
+
+  static void
+  operator delete(void* p, size_t sz);
+
 
   // --------------------------------------------------------
   // General data
@@ -518,11 +540,13 @@ private:
 
 public:
   // computeMetrics: compute this subtree's Metric::DerivedDesc metric
-  //   values for metric ids [mBegId, mEndId)
+  //   values for metric ids [mBegId, mEndId).  If 'doBatch', compile
+  //   each metric's expression and evaluate it over blocks of nodes
+  //   (cf. Metric::AExprProgram).
   // computeMetricsMe: same, but for the node (not the subtree)
   void
   computeMetrics(const Metric::Mgr& mMgr, uint mBegId, uint mEndId,
-		 bool doFinal);
+		 bool doFinal, bool doBatch = false);
 
   void
   computeMetricsMe(const Metric::Mgr& mMgr, uint mBegId, uint mEndId,
@@ -530,11 +554,12 @@ public:
 
 
   // computeMetricsIncr: compute this subtree's Metric::DerivedIncrDesc metric
-  //   values for metric ids [mBegId, mEndId)
+  //   values for metric ids [mBegId, mEndId).  Cf. computeMetrics()
+  //   for 'doBatch'.
   // computeMetricsIncrMe: same, but for the node (not the subtree)
   void
   computeMetricsIncr(const Metric::Mgr& mMgr, uint mBegId, uint mEndId,
-		     Metric::AExprIncr::FnTy fn);
+		     Metric::AExprIncr::FnTy fn, bool doBatch = false);
 
   void
   computeMetricsIncrMe(const Metric::Mgr& mMgr, uint mBegId, uint mEndId,
@@ -626,6 +651,29 @@ public:
 	   uint metricEnd = Metric::IData::npos,
 	   uint oFlags = 0, const char* pfx = "") const;
 
+  // writeXML: As above, but format into 'buf', indenting by 'depth'
+  // (unless compressed).  'scratch' holds sorted children of nodes
+  // being written and is left as it was found.
+  void
+  writeXML(xml::OutBuffer& buf, uint metricBeg, uint metricEnd,
+	   uint oFlags, uint depth, ANode::Vec& scratch) const;
+
+  // writeXMLMe: Format this node's element name and attributes into
+  // 'buf', exactly as toStringMe() would for 'oFlags'.  Only valid when
+  // isWriteXMLMeOk(oFlags); debugging output goes through toStringMe().
+  virtual void
+  writeXMLMe(xml::OutBuffer& buf, uint oFlags = 0) const;
+
+  static bool
+  isWriteXMLMeOk(uint oFlags);
+
+  // writeXML_pre/writeXML_post: As the ostream versions (below), but
+  // format into 'buf'
+  bool
+  writeXML_pre(xml::OutBuffer& buf, uint metricBeg, uint metricEnd,
+	       uint oFlags, uint depth) const;
+  void
+  writeXML_post(xml::OutBuffer& buf, uint oFlags, uint depth) const;
 
   std::ostream&
   writeXML_path(std::ostream& os,
@@ -669,6 +717,12 @@ protected:
 
 
 private:
+  // N.B.: profiles may be read and merged by several threads at once
+  // (cf. hpcprof --threads)
+  static uint
+  nextUniqueId()
+  { return __sync_fetch_and_add(&s_nextUniqueId, 2); } // cf. HPCRUN_FMT_RetainIdFlag
+
   static uint s_nextUniqueId;
   
 protected:
@@ -1111,6 +1165,9 @@ public:
   // Dump contents for inspection
   virtual std::string
   toStringMe(uint oFlags = 0) const;
+
+  virtual void
+  writeXMLMe(xml::OutBuffer& buf, uint oFlags = 0) const;
   
 protected:
 private:
@@ -1167,6 +1224,9 @@ public:
   virtual std::string
   toStringMe(uint oFlags = 0) const;
 
+  virtual void
+  writeXMLMe(xml::OutBuffer& buf, uint oFlags = 0) const;
+
   virtual std::string
   codeName() const;
 
@@ -1207,6 +1267,9 @@ public:
   virtual std::string
   toStringMe(uint oFlags = 0) const;
 
+  virtual void
+  writeXMLMe(xml::OutBuffer& buf, uint oFlags = 0) const;
+
 private:
 };
 
@@ -1240,6 +1303,9 @@ public:
   // Dump contents for inspection
   virtual std::string
   toStringMe(uint oFlags = 0) const;
+
+  virtual void
+  writeXMLMe(xml::OutBuffer& buf, uint oFlags = 0) const;
   
 private:
 };
@@ -1292,6 +1358,9 @@ public:
   virtual std::string
   toStringMe(uint oFlags = 0) const;
 
+  virtual void
+  writeXMLMe(xml::OutBuffer& buf, uint oFlags = 0) const;
+
 };
 
 
@@ -1332,6 +1401,65 @@ class Stmt
   // Dump contents for inspection
   virtual std::string
   toStringMe(uint oFlags = 0) const;
+
+  virtual void
+  writeXMLMe(xml::OutBuffer& buf, uint oFlags = 0) const;
+};
+
+
+//***************************************************************************
+// PathSet
+//***************************************************************************
+
+// PathSet: A set of nodes (typically those that received metric values
+// in a merge; cf. Tree::mergedNodes()) closed under the ancestor
+// relation.  Aggregating, computing and zeroing metrics over a PathSet
+// visits only these paths rather than the whole tree, which matters
+// when many small CCTs are folded, one at a time, into a large one.
+//
+// ASSUMES: nodes outside the set have zero values for the metrics
+// involved.  Given that, the results match the corresponding ANode
+// routines applied to the tree's root (modulo the order in which
+// floating point values are summed).
+class PathSet
+  : public Unique // prevent copying
+{
+public:
+  PathSet(const ANode::Vec& nodes);
+
+  ~PathSet()
+  { }
+
+  uint
+  size() const
+  { return m_nodes.size(); }
+
+  // Cf. ANode::aggregateMetricsIncl()
+  void
+  aggregateMetricsIncl(const VMAIntervalSet& ivalset);
+
+  // Cf. ANode::aggregateMetricsExcl()
+  void
+  aggregateMetricsExcl(const VMAIntervalSet& ivalset);
+
+  // Cf. ANode::computeMetricsIncr().  N.B.: accumulating a zero source
+  // must be a no-op for 'fn' (true of FnAccum with non-negative data).
+  void
+  computeMetricsIncr(const Metric::Mgr& mMgr, uint mBegId, uint mEndId,
+		     Metric::AExprIncr::FnTy fn, bool doBatch = false);
+
+  // Cf. ANode::zeroMetricsDeep()
+  void
+  zeroMetrics(uint mBegId, uint mEndId);
+
+private:
+  static bool
+  cmpDeepestFirst(const std::pair<uint, ANode*>& x,
+		  const std::pair<uint, ANode*>& y);
+
+private:
+  // descendants always precede their ancestors
+  ANode::Vec m_nodes;
 };
 
 
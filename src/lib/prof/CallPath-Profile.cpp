@@ -80,6 +80,8 @@ using std::string;
 
 #include <stdint.h>
 #include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
@@ -227,7 +229,10 @@ Profile::merge(Profile& y, int mergeTy, uint mrgFlag)
   DIAG_WMsgIf(x.m_fmtVersion != y.m_fmtVersion,
 	      "CallPath::Profile::merge(): ignoring incompatible versions: "
 	      << x.m_fmtVersion << " vs. " << y.m_fmtVersion);
-  DIAG_WMsgIf(x.m_flags.bits != y.m_flags.bits,
+  // isSparseMetrics only describes how a file encodes its metrics
+  epoch_flags_t x_flags = x.m_flags, y_flags = y.m_flags;
+  x_flags.fields.isSparseMetrics = y_flags.fields.isSparseMetrics = false;
+  DIAG_WMsgIf(x_flags.bits != y_flags.bits,
 	      "CallPath::Profile::merge(): ignoring incompatible flags: "
 	      << x.m_flags.bits << " vs. " << y.m_flags.bits);
   DIAG_WMsgIf(x.m_measurementGranularity != y.m_measurementGranularity,
@@ -276,6 +281,13 @@ Profile::merge(Profile& y, int mergeTy, uint mrgFlag)
   y.merge_fixTrace(mrgEffects2);
   delete mrgEffects2;
 
+  // y's traces now belong to x, as do their pending cpId changes
+  for (StringToCpIdMap::iterator it = y.m_traceCpIdMaps.begin();
+       it != y.m_traceCpIdMaps.end(); ++it) {
+    x.m_traceCpIdMaps[it->first].swap(it->second);
+  }
+  y.m_traceCpIdMaps.clear();
+
   return firstMergedMetric;
 }
 
@@ -384,10 +396,8 @@ Profile::merge_fixCCT(const std::vector<LoadMap::MergeEffect>* mrgEffects)
 void
 Profile::merge_fixTrace(const CCT::MergeEffectList* mrgEffects)
 {
-  typedef std::map<uint, uint> UIntToUIntMap;
-
   // early exit for trivial case
-  if (m_traceFileName.empty()) {
+  if (m_traceFileNameSet.empty()) {
     return;
   }
   else if (!mrgEffects || mrgEffects->empty()) {
@@ -405,19 +415,62 @@ Profile::merge_fixTrace(const CCT::MergeEffectList* mrgEffects)
     cpIdMap.insert(std::make_pair(effct.old_cpId, effct.new_cpId));
   }
 
+  // This profile may itself be the result of a merge (cf. the pairwise
+  // reduction in Analysis::CallPath::read()), in which case its traces
+  // may already have pending changes; the traces are rewritten later,
+  // once, by fixTraceFiles().  Compose: trace cpId a becomes
+  // cpIdMap(pending(a)).
+  for (StringSet::const_iterator it = m_traceFileNameSet.begin();
+       it != m_traceFileNameSet.end(); ++it) {
+    UIntToUIntMap& pending = m_traceCpIdMaps[*it];
+
+    for (UIntToUIntMap::iterator it1 = pending.begin();
+	 it1 != pending.end(); ++it1) {
+      UIntToUIntMap::const_iterator it2 = cpIdMap.find(it1->second);
+      if (it2 != cpIdMap.end()) {
+	it1->second = it2->second;
+      }
+    }
+    for (UIntToUIntMap::const_iterator it2 = cpIdMap.begin();
+	 it2 != cpIdMap.end(); ++it2) {
+      pending.insert(*it2); // no effect if already translated above
+    }
+  }
+}
+
+
+void
+Profile::fixTraceFiles()
+{
+  for (StringToCpIdMap::const_iterator it = m_traceCpIdMaps.begin();
+       it != m_traceCpIdMaps.end(); ++it) {
+    if (!it->second.empty()) {
+      merge_fixTraceFile(it->first, it->second);
+    }
+  }
+  m_traceCpIdMaps.clear();
+}
+
+
+// merge_fixTraceFile: Rewrite the trace 'traceFileName' into
+// 'traceFileName'.tmp, translating cpIds with 'cpIdMap'.
+void
+Profile::merge_fixTraceFile(const string& traceFileName,
+			    const UIntToUIntMap& cpIdMap)
+{
   // ------------------------------------------------------------
   // Rewrite trace file
   // ------------------------------------------------------------
   int ret;
 
-  DIAG_MsgIf(0, "Profile::merge_fixTrace: " << m_traceFileName);
+  DIAG_MsgIf(0, "Profile::merge_fixTrace: " << traceFileName);
 
-  string traceFileNameTmp = m_traceFileName + "." + HPCPROF_TmpFnmSfx;
+  const string& inFnm = traceFileName;
+  string traceFileNameTmp = traceFileName + "." + HPCPROF_TmpFnmSfx;
 
   char* infsBuf = new char[HPCIO_RWBufferSz];
   char* outfsBuf = new char[HPCIO_RWBufferSz];
 
-  const string& inFnm = m_traceFileName;
   FILE* infs = hpcio_fopen_r(inFnm.c_str());
   if (!infs) {
     std::string errorString;
@@ -460,13 +513,21 @@ Profile::merge_fixTrace(const CCT::MergeEffectList* mrgEffects)
   ret = setvbuf(outfs, outfsBuf, _IOFBF, HPCIO_RWBufferSz);
   DIAG_AssertWarn(ret == 0, outFnm << ": Profile::merge_fixTrace: setvbuf!");
 
-  ret = hpctrace_fmt_hdr_fwrite(hdr.flags, outfs);
+  // N.B.: measurement traces may use the compact record format and a
+  // raw clock; the database trace is always written in the database
+  // format.
+  hpctrace_hdr_flags_t outFlags = hpctrace_fmt_db_flags(hdr.flags);
+
+  hpctrace_fmt_rdstate_t rdstate;
+  hpctrace_fmt_rdstate_init(&rdstate);
+
+  ret = hpctrace_fmt_hdr_fwrite(outFlags, outfs);
   if (ret == HPCFMT_ERR) goto badwrite;
 
   while ( !feof(infs) ) {
     // 1. Read trace record (exit on EOF)
     hpctrace_fmt_datum_t datum;
-    ret = hpctrace_fmt_datum_fread(&datum, hdr.flags, infs);
+    ret = hpctrace_fmt_datum_fread_any(&datum, hdr.flags, &rdstate, infs);
     if (ret == HPCFMT_EOF) {
       break;
     } else if (ret == HPCFMT_ERR) {
@@ -480,15 +541,16 @@ Profile::merge_fixTrace(const CCT::MergeEffectList* mrgEffects)
     // 2. Translate cct id
     uint cctId_old = datum.cpId;
     uint cctId_new = datum.cpId;
-    UIntToUIntMap::iterator it = cpIdMap.find(cctId_old);
+    UIntToUIntMap::const_iterator it = cpIdMap.find(cctId_old);
     if (it != cpIdMap.end()) {
       cctId_new = it->second;
       DIAG_MsgIf(0, "  " << cctId_old << " -> " << cctId_new);
     }
     datum.cpId = cctId_new;
+    datum.time = hpctrace_fmt_time_db(&hdr, datum.time);
 
     // 3. Write new trace record
-    ret = hpctrace_fmt_datum_fwrite(&datum, hdr.flags, outfs);
+    ret = hpctrace_fmt_datum_fwrite(&datum, outFlags, outfs);
     if (ret == HPCFMT_ERR) goto badwrite;
   }
 
@@ -933,6 +995,117 @@ fmt_cct_makeNode(hpcrun_fmt_cct_node_t& n_fmt, const Prof::CCT::ANode& n,
 		 epoch_flags_t flags);
 
 
+// ProfileFileMapping: If 'fs' reads a regular file, map that file
+// read-only and position a memory cursor at the current offset of
+// 'fs'.  On destruction, 'fs' is repositioned after the data consumed
+// through the cursor.  Streams without a file descriptor (e.g., memory
+// streams) are not mapped.
+class ProfileFileMapping
+{
+public:
+  ProfileFileMapping(FILE* fs)
+    : m_fs(fs), m_addr(NULL), m_len(0)
+  {
+    struct stat st;
+    int fd = fileno(fs);
+    if (fd < 0 || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)
+	|| st.st_size <= 0) {
+      return;
+    }
+
+    off_t offset = ftello(fs);
+    if (offset < 0) {
+      return;
+    }
+
+    void* addr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED) {
+      return; // use 'fs'
+    }
+    madvise(addr, st.st_size, MADV_SEQUENTIAL);
+
+    m_addr = addr;
+    m_len = st.st_size;
+    hpcfmt_cursor_init(&m_cursor, m_addr, m_len, offset);
+  }
+
+  ~ProfileFileMapping()
+  {
+    if (m_addr) {
+      fseeko(m_fs, (off_t)hpcfmt_cursor_offset(&m_cursor), SEEK_SET);
+      munmap(m_addr, m_len);
+    }
+  }
+
+  bool
+  isMapped() const
+  { return (m_addr != NULL); }
+
+  hpcfmt_cursor_t*
+  cursor()
+  { return &m_cursor; }
+
+private:
+  FILE* m_fs;
+  void* m_addr;
+  size_t m_len;
+  hpcfmt_cursor_t m_cursor;
+};
+
+
+// CCTIdToCCTNodeMap: Maps the CCT node ids of a profile being read to
+// nodes.  Ids are small, dense integers (positive or negative), so ids
+// within a window proportional to the number of nodes are indexed
+// directly; any others fall back to a std::map.
+class CCTIdToCCTNodeMap
+{
+public:
+  CCTIdToCCTNodeMap(uint64_t numNodes)
+    : m_maxDenseId(4 * numNodes + 64)
+  {
+    m_posIds.reserve(2 * numNodes + 2);
+  }
+
+  Prof::CCT::ANode*
+  find(int id) const
+  {
+    const std::vector<Prof::CCT::ANode*>& vec = (id >= 0) ? m_posIds : m_negIds;
+    uint64_t idx = (id >= 0) ? (uint64_t)id : (uint64_t)(-(int64_t)id);
+    if (idx < vec.size()) {
+      return vec[idx];
+    }
+    else if (idx > m_maxDenseId) {
+      std::map<int, Prof::CCT::ANode*>::const_iterator it = m_sparseIds.find(id);
+      return (it != m_sparseIds.end()) ? it->second : NULL;
+    }
+    return NULL;
+  }
+
+  void
+  insert(int id, Prof::CCT::ANode* n)
+  {
+    std::vector<Prof::CCT::ANode*>& vec = (id >= 0) ? m_posIds : m_negIds;
+    uint64_t idx = (id >= 0) ? (uint64_t)id : (uint64_t)(-(int64_t)id);
+    if (idx > m_maxDenseId) {
+      m_sparseIds.insert(std::make_pair(id, n));
+      return;
+    }
+    if (idx >= vec.size()) {
+      vec.resize(idx + 1, NULL);
+    }
+    if (!vec[idx]) { // cf. std::map::insert()
+      vec[idx] = n;
+    }
+  }
+
+private:
+  uint64_t m_maxDenseId;
+  std::vector<Prof::CCT::ANode*> m_posIds;
+  std::vector<Prof::CCT::ANode*> m_negIds;
+  std::map<int, Prof::CCT::ANode*> m_sparseIds;
+};
+
+
 //***************************************************************************
 
 namespace Prof {
@@ -978,10 +1151,7 @@ Profile::make(const char* fnm, uint rFlags, FILE* outfs)
   ret = setvbuf(fs, fsBuf, _IOFBF, HPCIO_RWBufferSz);
   DIAG_AssertWarn(ret == 0, "Profile::make: setvbuf!");
 
-  rFlags |= RFlg_HpcrunData; // TODO: for now assume an hpcrun file (verify!)
-
-  Profile* prof = NULL;
-  ret = fmt_fread(prof, fs, rFlags, fnm, fnm, outfs);
+  Profile* prof = make(fnm, fs, rFlags, outfs);
   
   hpcio_fclose(fs);
 
@@ -991,6 +1161,18 @@ Profile::make(const char* fnm, uint rFlags, FILE* outfs)
 }
 
 
+Profile*
+Profile::make(const char* fnm, FILE* infs, uint rFlags, FILE* outfs)
+{
+  rFlags |= RFlg_HpcrunData; // TODO: for now assume an hpcrun file (verify!)
+
+  Profile* prof = NULL;
+  fmt_fread(prof, infs, rFlags, fnm, fnm, outfs);
+
+  return prof;
+}
+
+
 int
 Profile::fmt_fread(Profile* &prof, FILE* infs, uint rFlags,
 		   std::string ctxtStr, const char* filename, FILE* outfs)
@@ -1007,7 +1189,8 @@ Profile::fmt_fread(Profile* &prof, FILE* infs, uint rFlags,
 	    "is not a profile or it is corrupted\n", filename);
     prof_abort(-1);
   }
-  if ( !(hdr.version >= HPCRUN_FMT_Version_20) ) {
+  if ( !(hdr.version >= HPCRUN_FMT_Version_20
+	 && hdr.version <= HPCRUN_FMT_Version_30) ) {
     DIAG_Throw("unsupported file version '" << hdr.versionStr << "'");
   }
 
@@ -1431,12 +1614,8 @@ Profile::fmt_cct_fread(Profile& prof, FILE* infs, uint rFlags,
 		       const metric_tbl_t& metricTbl,
 		       std::string ctxtStr, FILE* outfs)
 {
-  typedef std::map<int, CCT::ANode*> CCTIdToCCTNodeMap;
-
   DIAG_Assert(infs, "Bad file descriptor!");
   
-  CCTIdToCCTNodeMap cctNodeMap;
-
   int ret = HPCFMT_ERR;
 
   // ------------------------------------------------------------
@@ -1445,6 +1624,8 @@ Profile::fmt_cct_fread(Profile& prof, FILE* infs, uint rFlags,
   uint64_t numNodes = 0;
   hpcfmt_int8_fread(&numNodes, infs);
 
+  CCTIdToCCTNodeMap cctNodeMap(numNodes);
+
   // ------------------------------------------------------------
   // Read each CCT node
   // ------------------------------------------------------------
@@ -1473,13 +1654,48 @@ Profile::fmt_cct_fread(Profile& prof, FILE* infs, uint rFlags,
     (hpcrun_metricVal_t*)alloca(numMetricsSrc * sizeof(hpcrun_metricVal_t))
     : NULL;
 
-  ExprEval eval;
+  // ------------------------------------------
+  // check if the metric contains a formula
+  //  if this is the case, we'll compute the metric based on the formula
+  //  given by hpcrun.  Compile each formula once here rather than
+  //  re-parsing it for every node.
+  // FIXME: we don't check the validity of the formula (yet).
+  //        If hpcrun has incorrect formula, the result can be anything
+  // ------------------------------------------
+  metric_desc_t* m_lst = metricTbl.lst;
+
+  std::vector<ExprProgram> formulaPrograms(numMetricsSrc);
+  std::vector<uint> formulaMetricIds; // metrics with a (valid) formula
+  {
+    ExprEval eval;
+    VarMap var_map(nodeFmt.metrics, m_lst, numMetricsSrc);
+
+    for (uint i = 0; i < numMetricsSrc; i++) {
+      char *expr = (char*) m_lst[i].formula;
+      if (expr == NULL || strlen(expr)==0) continue;
+
+      // a malformed formula would fail for every node: skip it
+      if (eval.Compile(expr, &var_map, formulaPrograms[i])) {
+	formulaMetricIds.push_back(i);
+      }
+    }
+  }
+
+  // Decode nodes directly from a mapping of the file, if possible,
+  // rather than field by field through stdio
+  ProfileFileMapping mapping(infs);
+  hpcfmt_cursor_t* cursor = (mapping.isMapped()) ? mapping.cursor() : NULL;
 
   for (uint i = 0; i < numNodes; ++i) {
     // ----------------------------------------------------------
     // Read the node
     // ----------------------------------------------------------
-    ret = hpcrun_fmt_cct_node_fread(&nodeFmt, prof.m_flags, infs);
+    if (cursor) {
+      ret = hpcrun_fmt_cct_node_cread(&nodeFmt, prof.m_flags, cursor);
+    }
+    else {
+      ret = hpcrun_fmt_cct_node_fread(&nodeFmt, prof.m_flags, infs);
+    }
     if (ret != HPCFMT_OK) {
       DIAG_Throw("Error reading CCT node " << nodeFmt.id);
     }
@@ -1488,23 +1704,20 @@ Profile::fmt_cct_fread(Profile& prof, FILE* infs, uint rFlags,
 				 &metricTbl, "  ");
     }
     // ------------------------------------------
-    // check if the metric contains a formula
-    //  if this is the case, we'll compute the metric based on the formula
-    //  given by hpcrun.
-    // FIXME: we don't check the validity of the formula (yet).
-    //        If hpcrun has incorrect formula, the result can be anything
+    // compute formula metrics (in metric order, as a formula may refer
+    // to a metric computed by an earlier one)
     // ------------------------------------------
-    metric_desc_t* m_lst = metricTbl.lst;
-    VarMap var_map(nodeFmt.metrics, m_lst, numMetricsSrc);
+    if (!formulaMetricIds.empty()) {
+      VarMap var_map(nodeFmt.metrics, m_lst, numMetricsSrc);
 
-    for (uint i = 0; i < numMetricsSrc; i++) {
-      char *expr = (char*) m_lst[i].formula;
-      if (expr == NULL || strlen(expr)==0) continue;
+      for (uint k = 0; k < formulaMetricIds.size(); k++) {
+	uint mId = formulaMetricIds[k];
 
-      double res = eval.Eval(expr, &var_map);
-      if (eval.GetErr() == EEE_NO_ERROR) {
-        // the formula syntax looks "correct". Update the the metric value
-      	hpcrun_fmt_metric_set_value(m_lst[i], &nodeFmt.metrics[i], res);
+	EXPR_EVAL_ERR err;
+	double res = formulaPrograms[mId].Eval(&var_map, err);
+	if (err == EEE_NO_ERROR) {
+	  hpcrun_fmt_metric_set_value(m_lst[mId], &nodeFmt.metrics[mId], res);
+	}
       }
     }
 
@@ -1514,11 +1727,8 @@ Profile::fmt_cct_fread(Profile& prof, FILE* infs, uint rFlags,
     // Find parent of node
     CCT::ANode* node_parent = NULL;
     if (parentId != HPCRUN_FMT_CCTNodeId_NULL) {
-      CCTIdToCCTNodeMap::iterator it = cctNodeMap.find(parentId);
-      if (it != cctNodeMap.end()) {
-	      node_parent = it->second;
-      }
-      else {
+      node_parent = cctNodeMap.find(parentId);
+      if (!node_parent) {
 	      DIAG_Throw("Cannot find parent for CCT node " << nodeId);
       }
     }
@@ -1563,7 +1773,7 @@ Profile::fmt_cct_fread(Profile& prof, FILE* infs, uint rFlags,
       if (cct->empty()) cct->root(node);
     }
 
-    cctNodeMap.insert(std::make_pair(nodeFmt.id, node));
+    cctNodeMap.insert(nodeId, node);
   }
 
   if (outfs) {
@@ -1966,7 +2176,11 @@ cct_makeNode(Prof::CallPath::Profile& prof,
 	DIAG_Die(DIAG_UnexpectedInput);
     }
 
-    metricData.metric(i_dst) = mval * (double)mdesc->period();
+    // N.B.: 'metricData' is zero-initialized; writing only non-zero
+    // values keeps wide, mostly-zero metric vectors sparse
+    if (mval != 0.0) {
+      metricData.metric(i_dst) = mval * (double)mdesc->period();
+    }
 
     if (!hpcrun_metricVal_isZero(m)) {
       hasMetrics = true;
@@ -2067,7 +2281,7 @@ fmt_cct_makeNode(hpcrun_fmt_cct_node_t& n_fmt, const Prof::CCT::ANode& n,
     // support skipping the writing of metrics.
     for (uint i = 0; i < n_fmt.num_metrics; ++i) {
       hpcrun_metricVal_t m; // C99: (hpcrun_metricVal_t){.r = n_dyn.metric(i)};
-      m.r = n_dyn.metric(i);
+      m.r = n_dyn.peekMetric(i);
       n_fmt.metrics[i] = m;
     }
   }
@@ -67,6 +67,7 @@
 
 #include <vector>
 #include <set>
+#include <map>
 #include <string>
 
 
@@ -247,6 +248,13 @@ public:
   uint
   merge(Profile& y, int mergeTy, uint mrgFlag = 0);
 
+  // fixTraceFiles: With CCT::MrgFlg_NormalizeTraceFileY, merge() only
+  //   records how the cpIds of merged traces change.  Rewrite each such
+  //   trace file once, applying all recorded changes, into
+  //   <trace>.tmp (cf. Analysis::Util::copyTraceFiles()).
+  void
+  fixTraceFiles();
+
   // -------------------------------------------------------
   //
   // -------------------------------------------------------
@@ -287,6 +295,12 @@ public:
   static Profile*
   make(const char* fnm, uint rFlags, FILE* outfs);
 
+  // make: build a Profile from the already opened stream 'infs'
+  //   holding the contents of profile file 'fnm'.  'fnm' is only used
+  //   for diagnostics and to locate the corresponding trace file.
+  static Profile*
+  make(const char* fnm, FILE* infs, uint rFlags, FILE* outfs);
+
   
   // fmt_*_fread(): Reads the appropriate hpcrun_fmt object from the
   // file stream 'infs', checking for errors, and constructs
@@ -362,6 +376,13 @@ private:
   void
   merge_fixTrace(const CCT::MergeEffectList* mrgEffects);
 
+  typedef std::map<uint, uint> UIntToUIntMap;
+  typedef std::map<std::string, UIntToUIntMap> StringToCpIdMap;
+
+  void
+  merge_fixTraceFile(const std::string& traceFileName,
+		     const UIntToUIntMap& cpIdMap);
+
 
 private:
   std::string m_name;
@@ -374,6 +395,7 @@ private:
 
   std::string m_traceFileName;   // non-empty, if relevant
   StringSet m_traceFileNameSet;
+  StringToCpIdMap m_traceCpIdMaps; // pending cpId changes (fixTraceFiles())
   uint64_t m_traceMinTime, m_traceMaxTime;
 
   //typedef std::map<std::string, std::string> StrToStrMap;
@@ -113,10 +113,47 @@ AExpr::dump_opands(std::ostream& os, AExpr** opands, uint sz, const char* sep)
 }
 
 
+bool
+AExpr::compile_opands(AExprProgram& prog, AExpr** opands, uint sz)
+{
+  if (sz == 0) {
+    return false; // n-ary operations require operands
+  }
+  for (uint i = 0; i < sz; ++i) {
+    if (!opands[i]->compile(prog)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+bool
+AExpr::compileStdDevNF(AExprProgram& prog, AExpr** opands, uint sz) const
+{
+  // cf. evalStdDevNF()
+  if (!compile_opands(prog, opands, sz)) {
+    return false;
+  }
+  prog.emitOp(AExprProgram::OpSumSquares, sz);
+  prog.emitStore(m_accumId[1]); // sum of squares
+  prog.emitStore(m_accumId[0]); // sum
+  return true;
+}
+
+
 // ----------------------------------------------------------------------
 // class Const
 // ----------------------------------------------------------------------
 
+bool
+Const::compile(AExprProgram& prog) const
+{
+  prog.emitConst(m_c);
+  return true;
+}
+
+
 std::ostream&
 Const::dumpMe(std::ostream& os) const
 {
@@ -139,6 +176,17 @@ Neg::eval(const Metric::IData& mdata) const
 }
 
 
+bool
+Neg::compile(AExprProgram& prog) const
+{
+  if (!m_expr->compile(prog)) {
+    return false;
+  }
+  prog.emitOp(AExprProgram::OpNeg);
+  return true;
+}
+
+
 std::ostream&
 Neg::dumpMe(std::ostream& os) const
 {
@@ -153,6 +201,14 @@ Neg::dumpMe(std::ostream& os) const
 // class Var
 // ----------------------------------------------------------------------
 
+bool
+Var::compile(AExprProgram& prog) const
+{
+  prog.emitLoad(m_metricId);
+  return true;
+}
+
+
 std::ostream&
 Var::dumpMe(std::ostream& os) const
 {
@@ -177,6 +233,17 @@ Power::eval(const Metric::IData& mdata) const
 }
 
 
+bool
+Power::compile(AExprProgram& prog) const
+{
+  if (!m_base->compile(prog) || !m_exponent->compile(prog)) {
+    return false;
+  }
+  prog.emitOp(AExprProgram::OpPower);
+  return true;
+}
+
+
 std::ostream&
 Power::dumpMe(std::ostream& os) const
 {
@@ -209,6 +276,17 @@ Divide::eval(const Metric::IData& mdata) const
 }
 
 
+bool
+Divide::compile(AExprProgram& prog) const
+{
+  if (!m_numerator->compile(prog) || !m_denominator->compile(prog)) {
+    return false;
+  }
+  prog.emitOp(AExprProgram::OpDivide);
+  return true;
+}
+
+
 std::ostream&
 Divide::dumpMe(std::ostream& os) const
 {
@@ -237,6 +315,17 @@ Minus::eval(const Metric::IData& mdata) const
 }
 
 
+bool
+Minus::compile(AExprProgram& prog) const
+{
+  if (!m_minuend->compile(prog) || !m_subtrahend->compile(prog)) {
+    return false;
+  }
+  prog.emitOp(AExprProgram::OpMinus);
+  return true;
+}
+
+
 std::ostream&
 Minus::dumpMe(std::ostream& os) const
 {
@@ -271,6 +360,17 @@ Plus::eval(const Metric::IData& mdata) const
 }
 
 
+bool
+Plus::compile(AExprProgram& prog) const
+{
+  if (!compile_opands(prog, m_opands, m_sz)) {
+    return false;
+  }
+  prog.emitOp(AExprProgram::OpPlus, m_sz);
+  return true;
+}
+
+
 std::ostream&
 Plus::dumpMe(std::ostream& os) const
 {
@@ -308,6 +408,17 @@ Times::eval(const Metric::IData& mdata) const
 }
 
 
+bool
+Times::compile(AExprProgram& prog) const
+{
+  if (!compile_opands(prog, m_opands, m_sz)) {
+    return false;
+  }
+  prog.emitOp(AExprProgram::OpTimes, m_sz);
+  return true;
+}
+
+
 std::ostream&
 Times::dumpMe(std::ostream& os) const
 {
@@ -345,6 +456,17 @@ Max::eval(const Metric::IData& mdata) const
 }
 
 
+bool
+Max::compile(AExprProgram& prog) const
+{
+  if (!compile_opands(prog, m_opands, m_sz)) {
+    return false;
+  }
+  prog.emitOp(AExprProgram::OpMax, m_sz);
+  return true;
+}
+
+
 std::ostream&
 Max::dumpMe(std::ostream& os) const
 {
@@ -386,6 +508,17 @@ Min::eval(const Metric::IData& mdata) const
 }
 
 
+bool
+Min::compile(AExprProgram& prog) const
+{
+  if (!compile_opands(prog, m_opands, m_sz)) {
+    return false;
+  }
+  prog.emitOp(AExprProgram::OpMin, m_sz);
+  return true;
+}
+
+
 std::ostream&
 Min::dumpMe(std::ostream& os) const
 {
@@ -419,6 +552,30 @@ Mean::eval(const Metric::IData& mdata) const
 }
 
 
+bool
+Mean::compile(AExprProgram& prog) const
+{
+  if (!compile_opands(prog, m_opands, m_sz)) {
+    return false;
+  }
+  prog.emitOp(AExprProgram::OpMean, m_sz);
+  return true;
+}
+
+
+bool
+Mean::compileNF(AExprProgram& prog) const
+{
+  // cf. evalNF()
+  if (!compile_opands(prog, m_opands, m_sz)) {
+    return false;
+  }
+  prog.emitOp(AExprProgram::OpPlus, m_sz);
+  prog.emitStore(m_accumId[0]);
+  return true;
+}
+
+
 std::ostream&
 Mean::dumpMe(std::ostream& os) const
 {
@@ -453,6 +610,24 @@ StdDev::eval(const Metric::IData& mdata) const
 }
 
 
+bool
+StdDev::compile(AExprProgram& prog) const
+{
+  if (!compile_opands(prog, m_opands, m_sz)) {
+    return false;
+  }
+  prog.emitOp(AExprProgram::OpStdDev, m_sz);
+  return true;
+}
+
+
+bool
+StdDev::compileNF(AExprProgram& prog) const
+{
+  return compileStdDevNF(prog, m_opands, m_sz);
+}
+
+
 std::ostream&
 StdDev::dumpMe(std::ostream& os) const
 {
@@ -492,6 +667,24 @@ CoefVar::eval(const Metric::IData& mdata) const
 }
 
 
+bool
+CoefVar::compile(AExprProgram& prog) const
+{
+  if (!compile_opands(prog, m_opands, m_sz)) {
+    return false;
+  }
+  prog.emitOp(AExprProgram::OpCoefVar, m_sz, 1.0);
+  return true;
+}
+
+
+bool
+CoefVar::compileNF(AExprProgram& prog) const
+{
+  return compileStdDevNF(prog, m_opands, m_sz);
+}
+
+
 std::ostream&
 CoefVar::dumpMe(std::ostream& os) const
 {
@@ -531,6 +724,24 @@ RStdDev::eval(const Metric::IData& mdata) const
 }
 
 
+bool
+RStdDev::compile(AExprProgram& prog) const
+{
+  if (!compile_opands(prog, m_opands, m_sz)) {
+    return false;
+  }
+  prog.emitOp(AExprProgram::OpCoefVar, m_sz, 100.0);
+  return true;
+}
+
+
+bool
+RStdDev::compileNF(AExprProgram& prog) const
+{
+  return compileStdDevNF(prog, m_opands, m_sz);
+}
+
+
 std::ostream&
 RStdDev::dumpMe(std::ostream& os) const
 {
@@ -545,6 +756,14 @@ RStdDev::dumpMe(std::ostream& os) const
 // class NumSource
 // ----------------------------------------------------------------------
 
+bool
+NumSource::compile(AExprProgram& prog) const
+{
+  prog.emitConst((double)m_numSrc);
+  return true;
+}
+
+
 std::ostream&
 NumSource::dumpMe(std::ostream& os) const
 {
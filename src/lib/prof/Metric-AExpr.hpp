@@ -87,6 +87,7 @@
 
 #include "Metric-IData.hpp"
 #include "Metric-IDBExpr.hpp"
+#include "Metric-AExprProgram.hpp"
 
 #include <lib/support/NaN.h>
 #include <lib/support/Unique.hpp>
@@ -147,6 +148,23 @@ public:
     return z;
   }
 
+  // compile: append to 'prog' a flat form of eval() for batch
+  //   evaluation; returns false if the expression is unsupported
+  virtual bool
+  compile(AExprProgram& GCC_ATTR_UNUSED prog) const
+  { return false; }
+
+  // compileNF: same, but for evalNF()
+  virtual bool
+  compileNF(AExprProgram& prog) const
+  {
+    if (!compile(prog)) {
+      return false;
+    }
+    prog.emitStore(m_accumId[0]);
+    return true;
+  }
+
 
   static bool
   isok(double x)
@@ -322,6 +340,13 @@ protected:
   static void
   dump_opands(std::ostream& os, AExpr** opands, uint sz,
 	      const char* sep = ", ");
+
+
+  static bool
+  compile_opands(AExprProgram& prog, AExpr** opands, uint sz);
+
+  bool
+  compileStdDevNF(AExprProgram& prog, AExpr** opands, uint sz) const;
   
 protected:
   uint m_accumId[maxAccums];    // used only for Metric::IDBExpr routines
@@ -349,6 +374,9 @@ public:
   eval(const Metric::IData& GCC_ATTR_UNUSED mdata) const
   { return m_c; }
 
+  virtual bool
+  compile(AExprProgram& prog) const;
+
 
   // ------------------------------------------------------------
   // Metric::IDBExpr: exported formulas for Flat and Callers view
@@ -390,6 +418,9 @@ public:
   virtual double
   eval(const Metric::IData& mdata) const;
 
+  virtual bool
+  compile(AExprProgram& prog) const;
+
 
   // ------------------------------------------------------------
   // Metric::IDBExpr: exported formulas for Flat and Callers view
@@ -435,6 +466,9 @@ public:
   eval(const Metric::IData& mdata) const
   { return mdata.demandMetric(m_metricId); }
 
+  virtual bool
+  compile(AExprProgram& prog) const;
+
 
   // ------------------------------------------------------------
   // Metric::IDBExpr: exported formulas for Flat and Callers view
@@ -490,6 +524,9 @@ public:
   virtual double
   eval(const Metric::IData& mdata) const;
 
+  virtual bool
+  compile(AExprProgram& prog) const;
+
 
   // ------------------------------------------------------------
   // Metric::IDBExpr:
@@ -540,6 +577,9 @@ public:
   virtual double
   eval(const Metric::IData& mdata) const;
 
+  virtual bool
+  compile(AExprProgram& prog) const;
+
   // ------------------------------------------------------------
   // Metric::IDBExpr:
   // ------------------------------------------------------------
@@ -587,6 +627,9 @@ public:
   virtual double
   eval(const Metric::IData& mdata) const;
 
+  virtual bool
+  compile(AExprProgram& prog) const;
+
   // ------------------------------------------------------------
   // Metric::IDBExpr:
   // ------------------------------------------------------------
@@ -631,6 +674,9 @@ public:
   virtual double
   eval(const Metric::IData& mdata) const;
 
+  virtual bool
+  compile(AExprProgram& prog) const;
+
   // ------------------------------------------------------------
   // Metric::IDBExpr:
   // ------------------------------------------------------------
@@ -681,6 +727,9 @@ public:
   virtual double
   eval(const Metric::IData& mdata) const;
 
+  virtual bool
+  compile(AExprProgram& prog) const;
+
   // ------------------------------------------------------------
   // Metric::IDBExpr:
   // ------------------------------------------------------------
@@ -727,6 +776,9 @@ public:
   virtual double
   eval(const Metric::IData& mdata) const;
 
+  virtual bool
+  compile(AExprProgram& prog) const;
+
   // ------------------------------------------------------------
   // Metric::IDBExpr:
   // ------------------------------------------------------------
@@ -776,6 +828,9 @@ public:
   virtual double
   eval(const Metric::IData& mdata) const;
 
+  virtual bool
+  compile(AExprProgram& prog) const;
+
   // ------------------------------------------------------------
   // Metric::IDBExpr:
   // ------------------------------------------------------------
@@ -833,6 +888,12 @@ public:
     return z;
   }
 
+  virtual bool
+  compile(AExprProgram& prog) const;
+
+  virtual bool
+  compileNF(AExprProgram& prog) const;
+
 
   // ------------------------------------------------------------
   // Metric::IDBExpr:
@@ -890,6 +951,12 @@ public:
   evalNF(Metric::IData& mdata) const
   { return evalStdDevNF(mdata, m_opands, m_sz); }
 
+  virtual bool
+  compile(AExprProgram& prog) const;
+
+  virtual bool
+  compileNF(AExprProgram& prog) const;
+
 
   // ------------------------------------------------------------
   // Metric::IDBExpr: exported formulas for Flat and Callers view
@@ -956,6 +1023,12 @@ public:
   evalNF(Metric::IData& mdata) const
   { return evalStdDevNF(mdata, m_opands, m_sz); }
 
+  virtual bool
+  compile(AExprProgram& prog) const;
+
+  virtual bool
+  compileNF(AExprProgram& prog) const;
+
 
   // ------------------------------------------------------------
   // Metric::IDBExpr: exported formulas for Flat and Callers view
@@ -1022,6 +1095,12 @@ public:
   evalNF(Metric::IData& mdata) const
   { return evalStdDevNF(mdata, m_opands, m_sz); }
 
+  virtual bool
+  compile(AExprProgram& prog) const;
+
+  virtual bool
+  compileNF(AExprProgram& prog) const;
+
 
   // ------------------------------------------------------------
   // Metric::IDBExpr: exported formulas for Flat and Callers view
@@ -1086,6 +1165,9 @@ public:
   eval(const Metric::IData& GCC_ATTR_UNUSED mdata) const
   { return (double)m_numSrc; }
 
+  virtual bool
+  compile(AExprProgram& prog) const;
+
 
   // ------------------------------------------------------------
   // Metric::IDBExpr: exported formulas for Flat and Callers view
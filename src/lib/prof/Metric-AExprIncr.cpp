@@ -60,6 +60,7 @@ using std::endl;
 #include <algorithm>
 
 #include <cmath>
+#include <cfloat>
 
 //************************* User Include Files *******************************
 
@@ -102,10 +103,121 @@ AExprIncr::toString() const
 }
 
 
+bool
+AExprIncr::compileStdDev(AExprProgram& prog, FnTy fn) const
+{
+  switch (fn) {
+    case FnInit: // cf. initializeStdDev()
+      prog.emitConst(0.0);
+      prog.emitStore(m_accumId[0]);
+      prog.emitConst(0.0);
+      prog.emitStore(m_accumId[1]);
+      break;
+    case FnInitSrc: // cf. initializeSrcStdDev()
+      prog.emitConst(0.0);
+      prog.emitStore(m_srcId[0]);
+      if (isSetSrc(1)) {
+	prog.emitConst(0.0);
+	prog.emitStore(m_srcId[1]);
+      }
+      break;
+    case FnAccum: // cf. accumulateStdDev()
+      prog.emitLoad(m_accumId[0]);
+      prog.emitLoad(m_srcId[0]);
+      prog.emitOp(AExprProgram::OpPlus, 2);
+      prog.emitLoad(m_accumId[1]);
+      prog.emitLoad(m_srcId[0]);
+      prog.emitLoad(m_srcId[0]);
+      prog.emitOp(AExprProgram::OpTimes, 2);
+      prog.emitOp(AExprProgram::OpPlus, 2);
+      prog.emitStore(m_accumId[1]);
+      prog.emitStore(m_accumId[0]);
+      break;
+    case FnCombine: // cf. combineStdDev()
+      prog.emitLoad(m_accumId[0]);
+      prog.emitLoad(m_srcId[0]);
+      prog.emitOp(AExprProgram::OpPlus, 2);
+      prog.emitLoad(m_accumId[1]);
+      prog.emitLoad(m_srcId[1]);
+      prog.emitOp(AExprProgram::OpPlus, 2);
+      prog.emitStore(m_accumId[1]);
+      prog.emitStore(m_accumId[0]);
+      break;
+    case FnFini: // cf. finalizeStdDev()
+      prog.emitLoad(m_accumId[0]);
+      prog.emitLoad(m_accumId[1]);
+      compileNumSrc(prog);
+      prog.emitOp(AExprProgram::OpStdDevFini);
+      prog.emitStore(m_accumId[1]);
+      prog.emitStore(m_accumId[0]);
+      break;
+    default:
+      return false;
+  }
+  return true;
+}
+
+
+bool
+AExprIncr::compileCoefVarFini(AExprProgram& prog, double scale) const
+{
+  prog.emitLoad(m_accumId[0]);
+  prog.emitLoad(m_accumId[1]);
+  compileNumSrc(prog);
+  prog.emitOp(AExprProgram::OpStdDevFini);
+  prog.emitStoreKeep(m_accumId[1]); // mean
+  prog.emitOp(AExprProgram::OpCoefVarFini, 0, scale);
+  prog.emitStore(m_accumId[0]);
+  return true;
+}
+
+
+void
+AExprIncr::compileNumSrc(AExprProgram& prog) const
+{
+  if (hasNumSrcVar()) {
+    prog.emitLoad(m_numSrcVarId);
+    prog.emitOp(AExprProgram::OpNumSrc);
+  }
+  else {
+    prog.emitConst((double)m_numSrcFxd);
+  }
+}
+
+
 // ----------------------------------------------------------------------
 // class MinIncr
 // ----------------------------------------------------------------------
 
+bool
+MinIncr::compile(AExprProgram& prog, FnTy fn) const
+{
+  switch (fn) {
+    case FnInit:
+      prog.emitConst(DBL_MIN);
+      prog.emitStore(m_accumId[0]);
+      break;
+    case FnInitSrc:
+      prog.emitConst(DBL_MIN);
+      prog.emitStore(m_srcId[0]);
+      break;
+    case FnAccum:
+    case FnCombine:
+      prog.emitLoad(m_accumId[0]);
+      prog.emitLoad(m_srcId[0]);
+      prog.emitOp(AExprProgram::OpMinIncr);
+      prog.emitStore(m_accumId[0]);
+      break;
+    case FnFini:
+      prog.touch(m_accumId[0]);
+      break;
+    default:
+      return false;
+  }
+  return true;
+}
+
+
 std::ostream&
 MinIncr::dumpMe(std::ostream& os) const
 {
@@ -118,6 +230,35 @@ MinIncr::dumpMe(std::ostream& os) const
 // class MaxIncr
 // ----------------------------------------------------------------------
 
+bool
+MaxIncr::compile(AExprProgram& prog, FnTy fn) const
+{
+  switch (fn) {
+    case FnInit:
+      prog.emitConst(0.0);
+      prog.emitStore(m_accumId[0]);
+      break;
+    case FnInitSrc:
+      prog.emitConst(0.0);
+      prog.emitStore(m_srcId[0]);
+      break;
+    case FnAccum:
+    case FnCombine:
+      prog.emitLoad(m_accumId[0]);
+      prog.emitLoad(m_srcId[0]);
+      prog.emitOp(AExprProgram::OpMax, 2);
+      prog.emitStore(m_accumId[0]);
+      break;
+    case FnFini:
+      prog.touch(m_accumId[0]);
+      break;
+    default:
+      return false;
+  }
+  return true;
+}
+
+
 std::ostream&
 MaxIncr::dumpMe(std::ostream& os) const
 {
@@ -130,6 +271,35 @@ MaxIncr::dumpMe(std::ostream& os) const
 // class SumIncr
 // ----------------------------------------------------------------------
 
+bool
+SumIncr::compile(AExprProgram& prog, FnTy fn) const
+{
+  switch (fn) {
+    case FnInit:
+      prog.emitConst(0.0);
+      prog.emitStore(m_accumId[0]);
+      break;
+    case FnInitSrc:
+      prog.emitConst(0.0);
+      prog.emitStore(m_srcId[0]);
+      break;
+    case FnAccum:
+    case FnCombine:
+      prog.emitLoad(m_accumId[0]);
+      prog.emitLoad(m_srcId[0]);
+      prog.emitOp(AExprProgram::OpPlus, 2);
+      prog.emitStore(m_accumId[0]);
+      break;
+    case FnFini:
+      prog.touch(m_accumId[0]);
+      break;
+    default:
+      return false;
+  }
+  return true;
+}
+
+
 std::ostream&
 SumIncr::dumpMe(std::ostream& os) const
 {
@@ -142,6 +312,38 @@ SumIncr::dumpMe(std::ostream& os) const
 // class MeanIncr
 // ----------------------------------------------------------------------
 
+bool
+MeanIncr::compile(AExprProgram& prog, FnTy fn) const
+{
+  switch (fn) {
+    case FnInit:
+      prog.emitConst(0.0);
+      prog.emitStore(m_accumId[0]);
+      break;
+    case FnInitSrc:
+      prog.emitConst(0.0);
+      prog.emitStore(m_srcId[0]);
+      break;
+    case FnAccum:
+    case FnCombine:
+      prog.emitLoad(m_accumId[0]);
+      prog.emitLoad(m_srcId[0]);
+      prog.emitOp(AExprProgram::OpPlus, 2);
+      prog.emitStore(m_accumId[0]);
+      break;
+    case FnFini:
+      prog.emitLoad(m_accumId[0]);
+      compileNumSrc(prog);
+      prog.emitOp(AExprProgram::OpMeanFini);
+      prog.emitStore(m_accumId[0]);
+      break;
+    default:
+      return false;
+  }
+  return true;
+}
+
+
 std::ostream&
 MeanIncr::dumpMe(std::ostream& os) const
 {
@@ -154,6 +356,13 @@ MeanIncr::dumpMe(std::ostream& os) const
 // class StdDevIncr
 // ----------------------------------------------------------------------
 
+bool
+StdDevIncr::compile(AExprProgram& prog, FnTy fn) const
+{
+  return compileStdDev(prog, fn);
+}
+
+
 std::ostream&
 StdDevIncr::dumpMe(std::ostream& os) const
 {
@@ -166,6 +375,16 @@ StdDevIncr::dumpMe(std::ostream& os) const
 // class CoefVarIncr
 // ----------------------------------------------------------------------
 
+bool
+CoefVarIncr::compile(AExprProgram& prog, FnTy fn) const
+{
+  if (fn == FnFini) {
+    return compileCoefVarFini(prog, 1.0);
+  }
+  return compileStdDev(prog, fn);
+}
+
+
 std::ostream&
 CoefVarIncr::dumpMe(std::ostream& os) const
 {
@@ -178,6 +397,16 @@ CoefVarIncr::dumpMe(std::ostream& os) const
 // class RStdDevIncr
 // ----------------------------------------------------------------------
 
+bool
+RStdDevIncr::compile(AExprProgram& prog, FnTy fn) const
+{
+  if (fn == FnFini) {
+    return compileCoefVarFini(prog, 100.0);
+  }
+  return compileStdDev(prog, fn);
+}
+
+
 std::ostream&
 RStdDevIncr::dumpMe(std::ostream& os) const
 {
@@ -190,6 +419,28 @@ RStdDevIncr::dumpMe(std::ostream& os) const
 // class NumSourceIncr
 // ----------------------------------------------------------------------
 
+bool
+NumSourceIncr::compile(AExprProgram& prog, FnTy fn) const
+{
+  switch (fn) {
+    case FnInit:
+      prog.emitConst((double)numSrcFxd());
+      prog.emitStore(m_accumId[0]);
+      break;
+    case FnInitSrc:
+      break;
+    case FnAccum:
+    case FnCombine:
+    case FnFini:
+      prog.touch(m_accumId[0]);
+      break;
+    default:
+      return false;
+  }
+  return true;
+}
+
+
 std::ostream&
 NumSourceIncr::dumpMe(std::ostream& os) const
 {
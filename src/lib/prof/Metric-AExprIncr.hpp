@@ -86,6 +86,7 @@
 
 #include "Metric-IData.hpp"
 #include "Metric-IDBExpr.hpp"
+#include "Metric-AExprProgram.hpp"
 
 #include <lib/support/diagnostics.h>
 #include <lib/support/NaN.h>
@@ -173,6 +174,13 @@ public:
   virtual double
   finalize(Metric::IData& mdata) const = 0;
 
+  // compile: append to 'prog' a flat form of function 'fn' for batch
+  // evaluation; returns false if the expression is unsupported
+  virtual bool
+  compile(AExprProgram& GCC_ATTR_UNUSED prog,
+	  FnTy GCC_ATTR_UNUSED fn) const
+  { return false; }
+
 
   // ------------------------------------------------------------
   // Metric::IDBExpr: exported formulas for Flat and Callers view
@@ -373,6 +381,20 @@ public:
   }
 
 
+  // compileStdDev: cf. the above functions
+  bool
+  compileStdDev(AExprProgram& prog, FnTy fn) const;
+
+  // compileCoefVarFini: finalize with (sdev / mean) * scale
+  bool
+  compileCoefVarFini(AExprProgram& prog, double scale) const;
+
+protected:
+  // compileNumSrc: push numSrc()
+  void
+  compileNumSrc(AExprProgram& prog) const;
+
+public:
   // ------------------------------------------------------------
   //
   // ------------------------------------------------------------
@@ -471,6 +493,9 @@ public:
   finalize(Metric::IData& mdata) const
   { return accumVar(0, mdata); }
 
+  virtual bool
+  compile(AExprProgram& prog, FnTy fn) const;
+
 
   // ------------------------------------------------------------
   // Metric::IDBExpr: exported formulas for Flat and Callers view
@@ -542,6 +567,9 @@ public:
   finalize(Metric::IData& mdata) const
   { return accumVar(0, mdata); }
 
+  virtual bool
+  compile(AExprProgram& prog, FnTy fn) const;
+
 
   // ------------------------------------------------------------
   // Metric::IDBExpr: exported formulas for Flat and Callers view
@@ -613,6 +641,9 @@ public:
   finalize(Metric::IData& mdata) const
   { return accumVar(0, mdata); }
 
+  virtual bool
+  compile(AExprProgram& prog, FnTy fn) const;
+
 
   // ------------------------------------------------------------
   // Metric::IDBExpr: exported formulas for Flat and Callers view
@@ -693,6 +724,9 @@ public:
     return z;
   }
 
+  virtual bool
+  compile(AExprProgram& prog, FnTy fn) const;
+
 
   // ------------------------------------------------------------
   // Metric::IDBExpr: exported formulas for Flat and Callers view
@@ -762,6 +796,9 @@ public:
   finalize(Metric::IData& mdata) const
   { return finalizeStdDev(mdata); }
 
+  virtual bool
+  compile(AExprProgram& prog, FnTy fn) const;
+
 
   // ------------------------------------------------------------
   // Metric::IDBExpr: exported formulas for Flat and Callers view
@@ -848,6 +885,9 @@ public:
     return z;
   }
 
+  virtual bool
+  compile(AExprProgram& prog, FnTy fn) const;
+
 
   // ------------------------------------------------------------
   // Metric::IDBExpr: exported formulas for Flat and Callers view
@@ -934,6 +974,9 @@ public:
     return z;
   }
 
+  virtual bool
+  compile(AExprProgram& prog, FnTy fn) const;
+
 
   // ------------------------------------------------------------
   // Metric::IDBExpr: exported formulas for Flat and Callers view
@@ -1015,6 +1058,9 @@ public:
   finalize(Metric::IData& mdata) const
   { return accumVar(0, mdata); }
 
+  virtual bool
+  compile(AExprProgram& prog, FnTy fn) const;
+
 
   // ------------------------------------------------------------
   // Metric::IDBExpr: exported formulas for Flat and Callers view
@@ -0,0 +1,711 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+//  Prof::Metric::AExprProgram
+//
+//***************************************************************************
+
+//************************ System Include Files ******************************
+
+#include <iostream>
+using std::endl;
+
+#include <vector>
+#include <algorithm>
+
+#include <cmath>
+#include <cfloat>
+
+//************************* User Include Files *******************************
+
+#include <include/uint.h>
+
+#include "Metric-AExprProgram.hpp"
+#include "Metric-AExpr.hpp" // epsilon
+
+#include <lib/support/diagnostics.h>
+#include <lib/support/NaN.h>
+
+//************************ Forward Declarations ******************************
+
+static inline bool
+isok(double x)
+{
+  return !(c_isnan_d(x) || c_isinf_d(x));
+}
+
+
+//****************************************************************************
+
+namespace Prof {
+
+namespace Metric {
+
+const uint AExprProgram::BlockSz;
+
+
+void
+AExprProgram::emit(OpCode op, uint arg, double c)
+{
+  uint numPop = 0, numPush = 0;
+  switch (op) {
+    case OpConst:
+    case OpLoad:
+      numPush = 1; break;
+    case OpStore:
+      numPop = 1; break;
+    case OpStoreKeep:
+      numPop = 1; numPush = 1; break;
+    case OpNeg:
+    case OpNumSrc:
+      numPop = 1; numPush = 1; break;
+    case OpPower:
+    case OpDivide:
+    case OpMinus:
+    case OpMinIncr:
+    case OpMeanFini:
+    case OpCoefVarFini:
+      numPop = 2; numPush = 1; break;
+    case OpPlus:
+    case OpTimes:
+    case OpMin:
+    case OpMax:
+    case OpMean:
+    case OpStdDev:
+    case OpCoefVar:
+      DIAG_Assert(arg > 0, "AExprProgram: n-ary operation without operands");
+      numPop = arg; numPush = 1; break;
+    case OpSumSquares:
+      DIAG_Assert(arg > 0, "AExprProgram: n-ary operation without operands");
+      numPop = arg; numPush = 2; break;
+    case OpStdDevFini:
+      numPop = 3; numPush = 2; break;
+    default:
+      DIAG_Die(DIAG_UnexpectedInput);
+  }
+
+  DIAG_Assert(m_depth >= numPop, "AExprProgram: stack underflow");
+  m_depth = m_depth - numPop + numPush;
+  m_maxDepth = std::max(m_maxDepth, m_depth);
+
+  Instr instr;
+  instr.op  = op;
+  instr.arg = arg;
+  instr.c   = c;
+  m_code.push_back(instr);
+}
+
+
+void
+AExprProgram::execute(IData* const* data, uint numData, uint size) const
+{
+  size = std::max(size, m_size);
+  for (uint i = 0; i < numData; ++i) {
+    data[i]->ensureMetricsSize(size);
+  }
+
+  // operand stack, plus two scratch rows, each of 'BlockSz' lanes
+  std::vector<double> stack((m_maxDepth + 2) * BlockSz);
+
+  for (uint beg = 0; beg < numData; beg += BlockSz) {
+    uint sz = std::min(BlockSz, numData - beg);
+    executeBlock(data + beg, sz, &stack[0]);
+  }
+}
+
+
+void
+AExprProgram::executeBlock(IData* const* data, uint n, double* stack) const
+{
+#define ROW(i) (stack + (size_t)(i) * BlockSz)
+
+  double* scratch1 = ROW(m_maxDepth);
+  double* scratch2 = ROW(m_maxDepth + 1);
+
+  uint sp = 0; // next free row
+
+  for (uint pc = 0; pc < m_code.size(); ++pc) {
+    const Instr& instr = m_code[pc];
+    
+    switch (instr.op) {
+      case OpConst: {
+	double* z = ROW(sp++);
+	for (uint j = 0; j < n; ++j) {
+	  z[j] = instr.c;
+	}
+	break;
+      }
+      case OpLoad: {
+	double* z = ROW(sp++);
+	for (uint j = 0; j < n; ++j) {
+	  const IData* x = data[j];
+	  z[j] = x->metric(instr.arg);
+	}
+	break;
+      }
+      case OpStore:
+      case OpStoreKeep: {
+	// setMetric: a zero result does not create a sparse slot
+	const double* x = ROW(sp - 1);
+	for (uint j = 0; j < n; ++j) {
+	  data[j]->setMetric(instr.arg, x[j]);
+	}
+	if (instr.op == OpStore) {
+	  sp--;
+	}
+	break;
+      }
+
+      // ----------------------------------------------------------
+      // cf. AExpr classes
+      // ----------------------------------------------------------
+      case OpNeg: {
+	double* z = ROW(sp - 1);
+	for (uint j = 0; j < n; ++j) {
+	  z[j] = -z[j];
+	}
+	break;
+      }
+      case OpPower: {
+	double* z = ROW(sp - 2);
+	const double* e = ROW(sp - 1);
+	for (uint j = 0; j < n; ++j) {
+	  z[j] = pow(z[j], e[j]);
+	}
+	sp--;
+	break;
+      }
+      case OpDivide: {
+	double* z = ROW(sp - 2);
+	const double* d = ROW(sp - 1);
+	for (uint j = 0; j < n; ++j) {
+	  z[j] = (isok(d[j]) && d[j] != 0.0) ? (z[j] / d[j]) : c_FP_NAN_d;
+	}
+	sp--;
+	break;
+      }
+      case OpMinus: {
+	double* z = ROW(sp - 2);
+	const double* s = ROW(sp - 1);
+	for (uint j = 0; j < n; ++j) {
+	  z[j] = z[j] - s[j];
+	}
+	sp--;
+	break;
+      }
+      case OpPlus:
+      case OpMean: {
+	uint base = sp - instr.arg;
+	double* z = ROW(base);
+	for (uint j = 0; j < n; ++j) {
+	  z[j] = 0.0 + z[j];
+	}
+	for (uint i = 1; i < instr.arg; ++i) {
+	  const double* x = ROW(base + i);
+	  for (uint j = 0; j < n; ++j) {
+	    z[j] += x[j];
+	  }
+	}
+	if (instr.op == OpMean) {
+	  double sz = (double)instr.arg;
+	  for (uint j = 0; j < n; ++j) {
+	    z[j] = z[j] / sz;
+	  }
+	}
+	sp = base + 1;
+	break;
+      }
+      case OpTimes: {
+	uint base = sp - instr.arg;
+	double* z = ROW(base);
+	for (uint j = 0; j < n; ++j) {
+	  z[j] = 1.0 * z[j];
+	}
+	for (uint i = 1; i < instr.arg; ++i) {
+	  const double* x = ROW(base + i);
+	  for (uint j = 0; j < n; ++j) {
+	    z[j] *= x[j];
+	  }
+	}
+	sp = base + 1;
+	break;
+      }
+      case OpMin: {
+	// observational min: ignores zeros; DBL_MIN if no observations
+	uint base = sp - instr.arg;
+	double* z = ROW(base);
+	for (uint j = 0; j < n; ++j) {
+	  z[j] = (z[j] != 0.0) ? std::min(DBL_MAX, z[j]) : DBL_MAX;
+	}
+	for (uint i = 1; i < instr.arg; ++i) {
+	  const double* x = ROW(base + i);
+	  for (uint j = 0; j < n; ++j) {
+	    if (x[j] != 0.0) {
+	      z[j] = std::min(z[j], x[j]);
+	    }
+	  }
+	}
+	for (uint j = 0; j < n; ++j) {
+	  if (z[j] == DBL_MAX) { z[j] = DBL_MIN; }
+	}
+	sp = base + 1;
+	break;
+      }
+      case OpMax: {
+	uint base = sp - instr.arg;
+	double* z = ROW(base);
+	for (uint i = 1; i < instr.arg; ++i) {
+	  const double* x = ROW(base + i);
+	  for (uint j = 0; j < n; ++j) {
+	    z[j] = std::max(z[j], x[j]);
+	  }
+	}
+	sp = base + 1;
+	break;
+      }
+      case OpStdDev:
+      case OpCoefVar: {
+	// cf. AExpr::evalVariance()
+	uint base = sp - instr.arg;
+	double* x_mean = scratch1;
+	double* x_var  = scratch2;
+	for (uint j = 0; j < n; ++j) {
+	  x_mean[j] = 0.0;
+	  x_var[j] = 0.0;
+	}
+	for (uint i = 0; i < instr.arg; ++i) {
+	  const double* t = ROW(base + i);
+	  for (uint j = 0; j < n; ++j) {
+	    double delta = t[j] - x_mean[j];
+	    x_mean[j] += delta / (i + 1);
+	    x_var[j] += delta * (t[j] - x_mean[j]);
+	  }
+	}
+
+	double* z = ROW(base);
+	for (uint j = 0; j < n; ++j) {
+	  double sdev = sqrt(x_var[j] / instr.arg);
+	  if (instr.op == OpStdDev) {
+	    z[j] = sdev;
+	  }
+	  else {
+	    z[j] = (x_mean[j] > epsilon) ? ((sdev / x_mean[j]) * instr.c) : 0.0;
+	  }
+	}
+	sp = base + 1;
+	break;
+      }
+      case OpSumSquares: {
+	// cf. AExpr::evalSumSquares()
+	uint base = sp - instr.arg;
+	double* z1 = scratch1;
+	double* z2 = scratch2;
+	for (uint j = 0; j < n; ++j) {
+	  z1[j] = 0.0;
+	  z2[j] = 0.0;
+	}
+	for (uint i = 0; i < instr.arg; ++i) {
+	  const double* x = ROW(base + i);
+	  for (uint j = 0; j < n; ++j) {
+	    z1[j] += x[j];
+	    z2[j] += (x[j] * x[j]);
+	  }
+	}
+	std::copy(z1, z1 + n, ROW(base));
+	std::copy(z2, z2 + n, ROW(base + 1));
+	sp = base + 2;
+	break;
+      }
+
+      // ----------------------------------------------------------
+      // cf. AExprIncr classes
+      // ----------------------------------------------------------
+      case OpMinIncr: {
+	double* a = ROW(sp - 2);
+	const double* s = ROW(sp - 1);
+	for (uint j = 0; j < n; ++j) {
+	  if (s[j] != DBL_MIN && s[j] != 0.0) {
+	    a[j] = (a[j] == DBL_MIN) ? s[j] : std::min(a[j], s[j]);
+	  }
+	}
+	sp--;
+	break;
+      }
+      case OpNumSrc: {
+	double* z = ROW(sp - 1);
+	for (uint j = 0; j < n; ++j) {
+	  z[j] = (double)(uint)z[j];
+	}
+	break;
+      }
+      case OpMeanFini: {
+	double* a = ROW(sp - 2);
+	const double* num = ROW(sp - 1);
+	for (uint j = 0; j < n; ++j) {
+	  if (num[j] > 0) {
+	    a[j] = a[j] / num[j];
+	  }
+	}
+	sp--;
+	break;
+      }
+      case OpStdDevFini: {
+	// cf. AExprIncr::finalizeStdDev()
+	double* a1 = ROW(sp - 3);
+	double* a2 = ROW(sp - 2);
+	const double* num = ROW(sp - 1);
+	for (uint j = 0; j < n; ++j) {
+	  if (num[j] > 0) {
+	    double mean = a1[j] / num[j];
+	    double z1 = (mean * mean);
+	    double z2 = a2[j] / num[j];
+	    a1[j] = sqrt(z2 - z1);
+	    a2[j] = mean;
+	  }
+	}
+	sp--;
+	break;
+      }
+      case OpCoefVarFini: {
+	double* z = ROW(sp - 2);
+	const double* mean = ROW(sp - 1);
+	for (uint j = 0; j < n; ++j) {
+	  z[j] = (mean[j] > epsilon) ? ((z[j] / mean[j]) * instr.c) : 0.0;
+	}
+	sp--;
+	break;
+      }
+
+      default:
+	DIAG_Die(DIAG_UnexpectedInput);
+    }
+  }
+
+#undef ROW
+}
+
+
+std::ostream&
+AExprProgram::dump(std::ostream& os) const
+{
+  static const char* opNames[] = {
+    "const", "load", "store", "store-keep",
+    "neg", "power", "divide", "minus", "plus", "times", "min", "max",
+    "mean", "stddev", "coefvar", "sum-squares",
+    "min-incr", "num-src", "mean-fini", "stddev-fini", "coefvar-fini"
+  };
+
+  for (uint pc = 0; pc < m_code.size(); ++pc) {
+    const Instr& instr = m_code[pc];
+    os << pc << ": " << opNames[instr.op] << " " << instr.arg;
+    if (instr.op == OpConst || instr.op == OpCoefVar
+	|| instr.op == OpCoefVarFini) {
+      os << " " << instr.c;
+    }
+    os << endl;
+  }
+  return os;
+}
+
+
+void
+AExprProgram::ddump() const
+{
+  dump(std::cerr);
+}
+
+
+//****************************************************************************
+
+} // namespace Metric
+
+} // namespace Prof
+
+
+//***************************************************************************
+
+#ifdef AEXPRPROGRAM_TEST
+
+// Self-test: AExprProgram::execute() must compute exactly what the
+// virtual AExpr::eval()/evalNF() and AExprIncr functions compute.
+// Build by compiling this file with -DAEXPRPROGRAM_TEST and linking
+// with libHPCprof.
+
+#include <cstdlib>
+#include <cstring>
+
+#include "Metric-AExprIncr.hpp"
+
+using namespace Prof::Metric;
+
+static const uint NumVars = 10;
+static const uint NumNodes = 600;
+
+
+static AExpr*
+randomExpr(int depth)
+{
+  int k = (depth > 3) ? (rand() % 3) : (rand() % 15);
+  if (k < 2) {
+    return new Const((double)(rand() % 5));
+  }
+  if (k < 4) {
+    return new Var("v", rand() % NumVars);
+  }
+  switch (k) {
+    case 4: return new Neg(randomExpr(depth + 1));
+    case 5: return new Power(randomExpr(depth + 1), new Const(rand() % 3));
+    case 6: return new Divide(randomExpr(depth + 1), randomExpr(depth + 1));
+    case 7: return new Minus(randomExpr(depth + 1), randomExpr(depth + 1));
+  }
+
+  uint n = 1 + rand() % 4;
+  AExpr** opands = new AExpr*[n];
+  for (uint i = 0; i < n; ++i) {
+    opands[i] = randomExpr(depth + 1);
+  }
+  switch (k) {
+    case 8:  return new Plus(opands, n);
+    case 9:  return new Times(opands, n);
+    case 10: return new Min(opands, n);
+    case 11: return new Max(opands, n);
+    case 12: return new Mean(opands, n);
+    case 13: return new StdDev(opands, n);
+    default:
+      if (rand() % 2) {
+	return new CoefVar(opands, n);
+      }
+      return new RStdDev(opands, n);
+  }
+}
+
+
+static bool
+isSame(double x, double y)
+{
+  return (x == y) || (c_isnan_d(x) && c_isnan_d(y))
+    || (memcmp(&x, &y, sizeof(x)) == 0);
+}
+
+
+static bool
+isSameMetrics(const std::vector<IData*>& x, const std::vector<IData*>& y)
+{
+  for (uint i = 0; i < x.size(); ++i) {
+    const IData* x_i = x[i];
+    const IData* y_i = y[i];
+    uint sz = std::max(x_i->numMetrics(), y_i->numMetrics());
+    for (uint mId = 0; mId < sz; ++mId) {
+      double x_v = x_i->peekMetric(mId);
+      double y_v = y_i->peekMetric(mId);
+      if (!isSame(x_v, y_v)) {
+	std::cerr << "node " << i << ", metric " << mId << ": "
+		  << x_v << " vs. " << y_v << endl;
+	return false;
+      }
+    }
+  }
+  return true;
+}
+
+
+static void
+deleteData(std::vector<IData*>& x)
+{
+  for (uint i = 0; i < x.size(); ++i) {
+    delete x[i];
+  }
+  x.clear();
+}
+
+
+// testAExpr: random derived-metric expressions (cf. computeMetricsMe())
+static bool
+testAExpr(uint numTests)
+{
+  const uint accumId = NumVars, accum2Id = NumVars + 1, resultId = NumVars + 2;
+
+  for (uint t = 0; t < numTests; ++t) {
+    AExpr* expr = randomExpr(0);
+    expr->accumId(0, accumId);
+    expr->accumId(1, accum2Id);
+
+    std::vector<IData*> x, y;
+    for (uint i = 0; i < NumNodes; ++i) {
+      IData* x_i = new IData(NumVars);
+      for (uint v = 0; v < NumVars; ++v) {
+	if (rand() % 3) {
+	  x_i->metric(v) = (rand() % 7) - 1.5 * (rand() % 2);
+	}
+      }
+      x.push_back(x_i);
+      y.push_back(new IData(*x_i));
+    }
+
+    for (uint i = 0; i < NumNodes; ++i) {
+      expr->evalNF(*x[i]);
+      x[i]->demandMetric(resultId) = expr->eval(*x[i]);
+    }
+
+    AExprProgram prog;
+    bool isOk = expr->compileNF(prog) && expr->compile(prog);
+    if (isOk) {
+      prog.emitStore(resultId);
+      prog.execute(&y[0], NumNodes);
+      isOk = isSameMetrics(x, y);
+    }
+    if (!isOk) {
+      std::cerr << "AExpr test " << t << " failed: ";
+      expr->dump(std::cerr);
+      std::cerr << endl;
+    }
+
+    deleteData(x);
+    deleteData(y);
+    delete expr;
+
+    if (!isOk) {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+// testAExprIncr: each incremental metric kind through the sequence of
+// functions applied by hpcprof-mpi (cf. computeMetricsIncrMe())
+static bool
+testAExprIncr(uint numTests)
+{
+  const uint accumId = 0, accum2Id = 1, src0Id = 2, src1Id = 3, numSrcId = 4;
+
+  static const AExprIncr::FnTy fns[] = {
+    AExprIncr::FnInit, AExprIncr::FnInitSrc, AExprIncr::FnAccum,
+    AExprIncr::FnAccum, AExprIncr::FnCombine, AExprIncr::FnFini
+  };
+  static const uint numFns = sizeof(fns) / sizeof(fns[0]);
+
+  for (uint t = 0; t < numTests; ++t) {
+    AExprIncr* expr = NULL;
+    switch (t % 8) {
+      case 0: expr = new MinIncr(accumId, src0Id); break;
+      case 1: expr = new MaxIncr(accumId, src0Id); break;
+      case 2: expr = new SumIncr(accumId, src0Id); break;
+      case 3: expr = new MeanIncr(accumId, src0Id); break;
+      case 4: expr = new StdDevIncr(accumId, accum2Id, src0Id); break;
+      case 5: expr = new CoefVarIncr(accumId, accum2Id, src0Id); break;
+      case 6: expr = new RStdDevIncr(accumId, accum2Id, src0Id); break;
+      default: expr = new NumSourceIncr(accumId, src0Id); break;
+    }
+    expr->srcId(1, src1Id);
+    expr->numSrcFxd(3);
+    expr->numSrcVarId(numSrcId);
+
+    std::vector<IData*> x, y;
+    for (uint i = 0; i < NumNodes; ++i) {
+      x.push_back(new IData(3));
+      y.push_back(new IData(3));
+    }
+
+    bool isOk = true;
+    for (uint f = 0; f < numFns && isOk; ++f) {
+      for (uint i = 0; i < NumNodes; ++i) {
+	double v0 = (rand() % 5) * (rand() % 2);
+	double v1 = rand() % 4;
+	double vn = rand() % 4;
+	x[i]->demandMetric(src0Id) = y[i]->demandMetric(src0Id) = v0;
+	x[i]->demandMetric(src1Id) = y[i]->demandMetric(src1Id) = v1;
+	x[i]->demandMetric(numSrcId) = y[i]->demandMetric(numSrcId) = vn;
+      }
+
+      for (uint i = 0; i < NumNodes; ++i) {
+	switch (fns[f]) {
+	  case AExprIncr::FnInit:    expr->initialize(*x[i]); break;
+	  case AExprIncr::FnInitSrc: expr->initializeSrc(*x[i]); break;
+	  case AExprIncr::FnAccum:   expr->accumulate(*x[i]); break;
+	  case AExprIncr::FnCombine: expr->combine(*x[i]); break;
+	  default:                   expr->finalize(*x[i]); break;
+	}
+      }
+
+      AExprProgram prog;
+      isOk = expr->compile(prog, fns[f]);
+      if (isOk) {
+	prog.execute(&y[0], NumNodes);
+	isOk = isSameMetrics(x, y);
+      }
+      if (!isOk) {
+	std::cerr << "AExprIncr test " << t << " failed (fn " << fns[f]
+		  << "): ";
+	expr->dump(std::cerr);
+	std::cerr << endl;
+      }
+    }
+
+    deleteData(x);
+    deleteData(y);
+    delete expr;
+
+    if (!isOk) {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+int
+main(int argc, char** argv)
+{
+  srand(3);
+  bool isOk = testAExpr(3000) && testAExprIncr(500);
+  std::cerr << ((isOk) ? "AExprProgram: ok" : "AExprProgram: FAILED") << endl;
+  return (isOk) ? 0 : 1;
+}
+
+#endif // AEXPRPROGRAM_TEST
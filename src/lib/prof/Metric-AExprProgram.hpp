@@ -0,0 +1,229 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// class Prof::Metric::AExprProgram
+//
+// A flat (stack machine) form of a Metric::AExpr or Metric::AExprIncr
+// expression tree that is evaluated over many metric vectors at once.
+//
+// Each instruction operates on a block of lanes (one lane per metric
+// vector) so that evaluation is a sequence of simple loops over
+// arrays of doubles rather than a virtual call per operand per node.
+// Results match the corresponding eval(), evalNF() and AExprIncr
+// functions.
+//
+// Cf. Metric::AExpr::compile() and Metric::AExprIncr::compile().
+//
+//***************************************************************************
+
+#ifndef prof_Prof_Metric_AExprProgram_hpp
+#define prof_Prof_Metric_AExprProgram_hpp
+
+//************************ System Include Files ******************************
+
+#include <iostream>
+#include <vector>
+
+//************************* User Include Files *******************************
+
+#include <include/uint.h>
+
+#include "Metric-IData.hpp"
+
+
+//************************ Forward Declarations ******************************
+
+//****************************************************************************
+
+namespace Prof {
+
+namespace Metric {
+
+class AExprProgram
+{
+public:
+
+  // Operations.  Unless noted, an n-ary operation pops 'n' operands
+  // and pushes one result.
+  enum OpCode {
+    OpConst,        // push c
+    OpLoad,         // push metric 'mId'
+    OpStore,        // pop into metric 'mId'
+    OpStoreKeep,    // store top into metric 'mId' (no pop)
+
+    OpNeg,          // cf. AExpr classes
+    OpPower,
+    OpDivide,
+    OpMinus,
+    OpPlus,         // n-ary
+    OpTimes,        // n-ary
+    OpMin,          // n-ary, observational min
+    OpMax,          // n-ary
+    OpMean,         // n-ary
+    OpStdDev,       // n-ary
+    OpCoefVar,      // n-ary, scaled by c
+    OpSumSquares,   // n-ary, pushes <sum, sum of squares>
+
+    OpMinIncr,      // cf. AExprIncr classes: <accum, src> -> accum
+    OpNumSrc,       // (uint) truncation of a num-src variable
+    OpMeanFini,     // <accum, numSrc> -> accum
+    OpStdDevFini,   // <accum, accum2, numSrc> -> <accum, accum2>
+    OpCoefVarFini   // <sdev, mean> -> accum, scaled by c
+  };
+
+  // number of lanes evaluated by each instruction
+  static const uint BlockSz = 256;
+
+public:
+  AExprProgram()
+    : m_depth(0), m_maxDepth(0), m_size(0)
+  { }
+
+  ~AExprProgram()
+  { }
+
+  // ------------------------------------------------------------
+  // Construction
+  // ------------------------------------------------------------
+
+  void
+  emitConst(double c)
+  { emit(OpConst, 0, c); }
+
+  void
+  emitLoad(uint mId)
+  {
+    touch(mId);
+    emit(OpLoad, mId);
+  }
+
+  void
+  emitStore(uint mId)
+  {
+    touch(mId);
+    emit(OpStore, mId);
+  }
+
+  void
+  emitStoreKeep(uint mId)
+  {
+    touch(mId);
+    emit(OpStoreKeep, mId);
+  }
+
+  // emitOp: emit an operation with 'n' operands (if n-ary) and
+  // constant 'c' (if scaled)
+  void
+  emitOp(OpCode op, uint n = 0, double c = 0.0)
+  { emit(op, n, c); }
+
+  // touch: note that metric 'mId' must exist in each metric vector
+  // (cf. IData::demandMetric()) without otherwise accessing it
+  void
+  touch(uint mId)
+  {
+    if (mId + 1 > m_size) {
+      m_size = mId + 1;
+    }
+  }
+
+
+  bool
+  empty() const
+  { return m_code.empty(); }
+
+
+  // ------------------------------------------------------------
+  // Evaluation
+  // ------------------------------------------------------------
+
+  // execute: run the program over each of 'data[0 .. numData)' (in
+  // that order), first ensuring each metric vector has at least
+  // 'size' entries
+  void
+  execute(IData* const* data, uint numData, uint size = 0) const;
+
+
+  // ------------------------------------------------------------
+  //
+  // ------------------------------------------------------------
+
+  std::ostream&
+  dump(std::ostream& os = std::cerr) const;
+
+  void
+  ddump() const;
+
+private:
+  struct Instr {
+    OpCode op;
+    uint   arg; // metric id or number of operands
+    double c;
+  };
+
+  void
+  emit(OpCode op, uint arg, double c = 0.0);
+
+  void
+  executeBlock(IData* const* data, uint numData, double* stack) const;
+
+private:
+  std::vector<Instr> m_code;
+  uint m_depth;    // stack depth after the last instruction
+  uint m_maxDepth; // maximum stack depth
+  uint m_size;     // minimum metric vector size (max metric id + 1)
+};
+
+
+} // namespace Metric
+
+} // namespace Prof
+
+//****************************************************************************
+
+#endif /* prof_Prof_Metric_AExprProgram_hpp */
@@ -110,6 +110,19 @@ IData::writeMetricsXML(std::ostream& os, uint mBegId, uint mEndId,
   }
   mEndId = std::min(numMetrics(), mEndId);
 
+  if (m_sparse) {
+    for (SparseMetricMap::const_iterator it = m_sparse->lower_bound(mBegId);
+	 it != m_sparse->end() && it->first < mEndId; ++it) {
+      if (it->second != 0.0) {
+	os << ((!wasMetricWritten) ? pfx : "");
+	os << "<M " << "n" << xml::MakeAttrNum(it->first) 
+	   << " v" << xml::MakeAttrNum(it->second) << "/>";
+	wasMetricWritten = true;
+      }
+    }
+    return os;
+  }
+
   for (uint i = mBegId; i < mEndId; i++) {
     if (hasMetric(i)) {
       double m = metric(i);
@@ -124,6 +137,51 @@ IData::writeMetricsXML(std::ostream& os, uint mBegId, uint mEndId,
 }
 
 
+void
+IData::writeMetricsXML(xml::OutBuffer& buf, uint mBegId, uint mEndId,
+		       int GCC_ATTR_UNUSED oFlags, uint indent) const
+{
+  bool wasMetricWritten = false;
+
+  if (mBegId == IData::npos) {
+    mBegId = 0;
+  }
+  mEndId = std::min(numMetrics(), mEndId);
+
+  if (m_sparse) {
+    for (SparseMetricMap::const_iterator it = m_sparse->lower_bound(mBegId);
+	 it != m_sparse->end() && it->first < mEndId; ++it) {
+      if (it->second != 0.0) {
+	if (!wasMetricWritten) {
+	  buf.putSpaces(indent);
+	}
+	buf.put("<M n", 4);
+	buf.putAttrNum(it->first);
+	buf.put(" v", 2);
+	buf.putAttrNum(it->second);
+	buf.put("/>", 2);
+	wasMetricWritten = true;
+      }
+    }
+    return;
+  }
+
+  for (uint i = mBegId; i < mEndId; i++) {
+    if (hasMetric(i)) {
+      if (!wasMetricWritten) {
+	buf.putSpaces(indent);
+      }
+      buf.put("<M n", 4);
+      buf.putAttrNum(i);
+      buf.put(" v", 2);
+      buf.putAttrNum(metric(i));
+      buf.put("/>", 2);
+      wasMetricWritten = true;
+    }
+  }
+}
+
+
 std::ostream&
 IData::dumpMetrics(std::ostream& os, int GCC_ATTR_UNUSED oFlags,
 		   const char* GCC_ATTR_UNUSED pfx) const
@@ -139,6 +197,34 @@ IData::ddumpMetrics() const
 }
 
 
+void
+IData::makeSparse() const
+{
+  m_sparse = new SparseMetricMap;
+  m_sparseSize = m_metrics.size();
+  for (uint i = 0; i < m_metrics.size(); ++i) {
+    if (m_metrics[i] != 0.0) {
+      m_sparse->insert(m_sparse->end(), std::make_pair(i, m_metrics[i]));
+    }
+  }
+  MetricVec().swap(m_metrics); // release storage
+}
+
+
+void
+IData::makeDense() const
+{
+  m_metrics.assign(m_sparseSize, 0.0);
+  for (SparseMetricMap::const_iterator it = m_sparse->begin();
+       it != m_sparse->end(); ++it) {
+    m_metrics[it->first] = it->second;
+  }
+  delete m_sparse;
+  m_sparse = NULL;
+  m_sparseSize = 0;
+}
+
+
 //***************************************************************************
 
 } // namespace Metric
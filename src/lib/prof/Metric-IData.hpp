@@ -66,6 +66,7 @@
 
 #include <string>
 #include <vector>
+#include <map>
 
 #include <typeinfo>
 #include <algorithm>
@@ -81,6 +82,9 @@
 
 //*************************** Forward Declarations **************************
 
+namespace xml {
+  class OutBuffer;
+}
 
 //***************************************************************************
 
@@ -102,28 +106,42 @@ public:
   
   typedef std::vector<double> MetricVec;
 
+  // SparseMetricMap: metric id -> value for the non-zero metrics of a
+  // node.  A map (rather than parallel sorted vectors) keeps references
+  // returned by metric() stable when other slots are materialized.
+  typedef std::map<uint, double> SparseMetricMap;
+
 public:
   // --------------------------------------------------------
   // Create/Destroy
   // --------------------------------------------------------
   IData(size_t size = 0)
+    : m_sparse(NULL), m_sparseSize(0)
   {
     ensureMetricsSize(size);
   }
 
   virtual ~IData()
   {
+    delete m_sparse;
   }
   
   IData(const IData& x)
-    : m_metrics(x.m_metrics)
+    : m_metrics(x.m_metrics),
+      m_sparse((x.m_sparse) ? new SparseMetricMap(*x.m_sparse) : NULL),
+      m_sparseSize(x.m_sparseSize)
   {
   }
   
   IData&
   operator=(const IData& x)
   {
-    m_metrics = x.m_metrics;
+    if (this != &x) {
+      m_metrics = x.m_metrics;
+      delete m_sparse;
+      m_sparse = (x.m_sparse) ? new SparseMetricMap(*x.m_sparse) : NULL;
+      m_sparseSize = x.m_sparseSize;
+    }
     return *this;
   }
 
@@ -142,6 +160,16 @@ public:
     }
     mEndId = std::min(numMetrics(), mEndId);
 
+    if (m_sparse) {
+      for (SparseMetricMap::const_iterator it = m_sparse->lower_bound(mBegId);
+	   it != m_sparse->end() && it->first < mEndId; ++it) {
+	if (it->second != 0.0) {
+	  return true;
+	}
+      }
+      return false;
+    }
+
     for (uint i = mBegId; i < mEndId; ++i) {
       if (hasMetric(i)) {
 	return true;
@@ -152,20 +180,86 @@ public:
 
   bool
   hasMetric(size_t mId) const
-  { return (m_metrics[mId] != 0.0); }
+  { return (metric(mId) != 0.0); }
 
   bool
   hasMetricSlow(size_t mId) const
-  { return (mId < m_metrics.size() && hasMetric(mId)); }
+  { return (mId < numMetrics() && hasMetric(mId)); }
 
 
   double
   metric(size_t mId) const
-  { return m_metrics[mId]; }
+  {
+    if (m_sparse) {
+      SparseMetricMap::const_iterator it = m_sparse->find(mId);
+      return (it != m_sparse->end()) ? it->second : 0.0;
+    }
+    return m_metrics[mId];
+  }
 
+  // N.B.: for sparse storage, materializes a slot for 'mId' (even if
+  // only read); cf. peekMetric(), setMetric() and pruneZeroMetrics()
   double&
   metric(size_t mId)
-  { return m_metrics[mId]; }
+  {
+    if (m_sparse) {
+      return (*m_sparse)[mId];
+    }
+    return m_metrics[mId];
+  }
+
+  // peekMetric: the value of metric 'mId', or 0.0 if 'mId' is beyond
+  // numMetrics().  Unlike metric() on a non-const object, never
+  // materializes a sparse slot; use it where a value is only read.
+  double
+  peekMetric(size_t mId) const
+  {
+    if (m_sparse) {
+      SparseMetricMap::const_iterator it = m_sparse->find(mId);
+      return (it != m_sparse->end()) ? it->second : 0.0;
+    }
+    return (mId < m_metrics.size()) ? m_metrics[mId] : 0.0;
+  }
+
+  // setMetric: metric(mId) = x, except that for sparse storage, a zero
+  // value drops the slot for 'mId' rather than materializing it
+  void
+  setMetric(size_t mId, double x)
+  {
+    if (m_sparse) {
+      if (x != 0.0) {
+	(*m_sparse)[mId] = x;
+	densifyIfFull();
+      }
+      else {
+	m_sparse->erase(mId);
+      }
+      return;
+    }
+    m_metrics[mId] = x;
+  }
+
+  // pruneZeroMetrics: for sparse storage, drop the slots holding zero,
+  // e.g., those materialized by reads through the non-const metric()
+  // while evaluating metric expressions (cf. Metric::AExprIncr::var()).
+  // Storage that is still too full to be sparse becomes dense.
+  void
+  pruneZeroMetrics()
+  {
+    if (!m_sparse) {
+      return;
+    }
+    SparseMetricMap::iterator it = m_sparse->begin();
+    while (it != m_sparse->end()) {
+      if (it->second == 0.0) {
+	m_sparse->erase(it++);
+      }
+      else {
+	++it;
+      }
+    }
+    densifyIfFull();
+  }
 
 
   double
@@ -190,35 +284,119 @@ public:
   void
   zeroMetrics(uint mBegId, uint mEndId)
   {
+    if (m_sparse) {
+      m_sparse->erase(m_sparse->lower_bound(mBegId),
+		      m_sparse->lower_bound(mEndId));
+      return;
+    }
     for (uint i = mBegId; i < mEndId; ++i) {
       metric(i) = 0.0;
     }
   }
 
 
+  // accumulateMetrics: x[xBegId + (i - yBegId)] += y[i] for i in
+  // [yBegId, yEndId), ensuring x is large enough.  Only the non-zero
+  // values of 'y' are visited; when both are dense, this is a loop
+  // over two contiguous arrays.
+  void
+  accumulateMetrics(const IData& y, uint yBegId, uint yEndId, uint xBegId)
+  {
+    yEndId = std::min(y.numMetrics(), yEndId);
+    uint n = (yBegId < yEndId) ? (yEndId - yBegId) : 0;
+    ensureMetricsSize(xBegId + n);
+    if (n == 0) {
+      return;
+    }
+
+    if (y.m_sparse) {
+      for (SparseMetricMap::const_iterator it = y.m_sparse->lower_bound(yBegId);
+	   it != y.m_sparse->end() && it->first < yEndId; ++it) {
+	if (it->second != 0.0) {
+	  metric(xBegId + (it->first - yBegId)) += it->second;
+	}
+      }
+    }
+    else if (m_sparse) {
+      for (uint y_i = yBegId; y_i < yEndId; ++y_i) {
+	double yVal = y.m_metrics[y_i];
+	if (yVal != 0.0) {
+	  (*m_sparse)[xBegId + (y_i - yBegId)] += yVal;
+	}
+      }
+    }
+    else {
+      double* x_vec = &m_metrics[xBegId];
+      const double* y_vec = &y.m_metrics[yBegId];
+      for (uint i = 0; i < n; ++i) {
+	x_vec[i] += y_vec[i];
+      }
+    }
+    densifyIfFull();
+  }
+
+
   void
   clearMetrics()
   {
-    m_metrics.clear();;
+    m_metrics.clear();
+    delete m_sparse;
+    m_sparse = NULL;
+    m_sparseSize = 0;
   }
 
   // ensureMetricsSize: ensures a vector of the requested size exists
+  //
+  // Storage is re-chosen when the vector grows (which, as with a
+  // std::vector resize, may invalidate references from metric()):
+  // wide vectors with few non-zeros are kept sparse.  A dense vector
+  // is not rescanned: it becomes sparse only if its old size bounds
+  // its non-zeros tightly enough, e.g., when it starts out empty.
+  // Sparse storage that fills up becomes dense again (cf.
+  // densifyIfFull()).
   void
   ensureMetricsSize(size_t size) const
   {
-    if (size > m_metrics.size())
+    size_t oldSize = numMetrics();
+    if (size <= oldSize) {
+      return;
+    }
+
+    if (m_sparse) {
+      m_sparseSize = size;
+      densifyIfFull();
+    }
+    else if (isSparseProfitable(oldSize, size)) {
+      makeSparse();
+      m_sparseSize = size;
+    }
+    else {
       m_metrics.resize(size, 0.0 /*value*/); // inserts at end
+    }
   }
 
   void
   insertMetricsBefore(size_t numMetrics) 
   {
+    if (m_sparse) {
+      SparseMetricMap* shifted = new SparseMetricMap;
+      for (SparseMetricMap::const_iterator it = m_sparse->begin();
+	   it != m_sparse->end(); ++it) {
+	shifted->insert(shifted->end(),
+			std::make_pair(it->first + (uint)numMetrics,
+				       it->second));
+      }
+      delete m_sparse;
+      m_sparse = shifted;
+      m_sparseSize += numMetrics;
+      return;
+    }
     m_metrics.insert(m_metrics.begin(), numMetrics, 0.0);
   }
   
   uint
   numMetrics() const
-  { return m_metrics.size(); }
+  { return (m_sparse) ? m_sparseSize : m_metrics.size(); }
 
 
   // --------------------------------------------------------
@@ -236,6 +414,11 @@ public:
 		  uint mEndId = Metric::IData::npos,
 		  int oFlags = 0, const char* pfx = "") const;
 
+  // As above, but format into 'buf', prefixing 'indent' spaces
+  void
+  writeMetricsXML(xml::OutBuffer& buf, uint mBegId, uint mEndId,
+		  int oFlags, uint indent) const;
+
 
   std::ostream&
   dumpMetrics(std::ostream& os = std::cerr, int oFlags = 0,
@@ -244,9 +427,39 @@ public:
   void
   ddumpMetrics() const;
 
+
+private:
+  // A sparse entry costs several times a dense slot; use sparse
+  // storage only for wide vectors that are mostly zero.
+  static const size_t SparseMinSize = 32;
+  static const size_t SparseRatio   = 8;
+
+  static bool
+  isSparseProfitable(size_t nnz, size_t size)
+  { return (size >= SparseMinSize && nnz * SparseRatio <= size); }
+
+  void
+  makeSparse() const;
+
+  void
+  makeDense() const;
+
+  // densifyIfFull: makes sparse storage dense once it holds too many
+  // slots.  N.B.: invalidates references from metric(); called only
+  // where none may be live.
+  void
+  densifyIfFull() const
+  {
+    if (m_sparse && !isSparseProfitable(m_sparse->size(), m_sparseSize)) {
+      makeDense();
+    }
+  }
+
   
 private:
-  mutable MetricVec m_metrics;
+  mutable MetricVec m_metrics;        // dense storage (when !m_sparse)
+  mutable SparseMetricMap* m_sparse;  // sparse storage (or NULL)
+  mutable size_t m_sparseSize;        // vector size for sparse storage
 };
 
 //***************************************************************************
@@ -18,6 +18,7 @@
 #include <iostream>
 #include <map>
 #include <string.h>
+#include <pthread.h>
 
 #include <lib/support/dictionary.h>
 
@@ -98,6 +99,8 @@ static const char *fakeProcedures[] = {
 static NameMappings_t renamingMap;
 static NameMappings_t fakeProcedureMap;
 
+static pthread_once_t renamingOnce = PTHREAD_ONCE_INIT;
+
 
 //******************************************************************************
 // private operations
@@ -107,10 +110,6 @@ static NameMappings_t fakeProcedureMap;
 static void 
 normalize_name_load_renamings()
 {
-  static int initialized = 0;
-  if (initialized) return;
-  initialized = 1;
-
   for (unsigned int i = 0; i < sizeof(renamingTable) / sizeof(NameMapping); i++) {
     renamingMap[renamingTable[i].in] =  renamingTable[i].out;
   }
@@ -147,7 +146,8 @@ normalize_name_rename(const char *in, bool &fake_procedure)
 const char *
 normalize_name(const char *in, bool &fake_procedure)
 {
-  normalize_name_load_renamings();
+  // N.B.: profiles may be read concurrently (cf. hpcprof --threads)
+  pthread_once(&renamingOnce, normalize_name_load_renamings);
   return normalize_name_rename(in, fake_procedure);
 }
 
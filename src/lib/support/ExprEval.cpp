@@ -2,6 +2,7 @@
 // This file is a modified version from Expression Evaluator published at
 //   https://www.strchr.com/expression_evaluator
 #include <assert.h>
+#include <alloca.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -151,6 +152,210 @@ double ExprEval::Eval(EVAL_CHAR* expr, BaseVarMap *var_map)
   return res;
 }
 
+// ================================
+//   Compiled expressions
+// ================================
+
+// Compile a number, a variable or an expression in parenthesis
+void ExprEval::CompileAtom(EVAL_CHAR*& expr) 
+{
+    // Skip spaces
+    while(*expr == ' ')
+      expr++;
+
+    // Handle the sign before parenthesis (or before number)
+    bool negative = false;
+    if(*expr == '-') {
+      negative = true;
+      expr++;
+    }
+    if(*expr == '+') {
+      expr++;
+    }
+
+    // Check if there is parenthesis
+    if(*expr == '(') {
+      expr++;
+      _paren_count++;
+      CompileSummands(expr);
+      if(*expr != ')') {
+        // Unmatched opening parenthesis
+        _err = EEE_PARENTHESIS;
+        _err_pos = expr;
+        return;
+      }
+      expr++;
+      _paren_count--;
+      if (negative)
+        _prog->Emit(ExprProgram::OP_NEG);
+      return;
+    }
+  
+    // check if this is variable
+    bool variable = _var_map->isVariable(expr);
+    if (variable) {
+      expr++;
+    }
+
+    // It should be a number; convert it to double
+    char* end_ptr;
+    double res = strtod(expr, &end_ptr);
+    if(end_ptr == expr) {
+      // Report error
+      _err = EEE_WRONG_CHAR;
+      _err_pos = expr;
+      return;
+    }
+
+    // variables are substituted when the program is evaluated
+    if (variable) {
+      _prog->Emit(ExprProgram::OP_VAR, 0, (unsigned int) res);
+      if (negative)
+        _prog->Emit(ExprProgram::OP_NEG);
+    }
+    else {
+      _prog->Emit(ExprProgram::OP_CONST, negative ? -res : res);
+    }
+
+    // Advance the pointer
+    expr = end_ptr;
+}
+
+// Compile multiplication and division
+void ExprEval::CompileFactors(EVAL_CHAR*& expr) 
+{
+    CompileAtom(expr);
+    for(;;) {
+      // Skip spaces
+      while(*expr == ' ')
+        expr++;
+      EVAL_CHAR op = *expr;
+      if(op != '/' && op != '*')
+        return;
+      expr++;
+      CompileAtom(expr);
+      _prog->Emit((op == '/') ? ExprProgram::OP_DIV : ExprProgram::OP_MUL);
+    }
+}
+
+// Compile addition and subtraction
+void ExprEval::CompileSummands(EVAL_CHAR*& expr) 
+{
+    CompileFactors(expr);
+    for(;;) {
+      // Skip spaces
+      while(*expr == ' ')
+        expr++;
+      EVAL_CHAR op = *expr;
+      if(op != '-' && op != '+')
+        return;
+      expr++;
+      CompileFactors(expr);
+      _prog->Emit((op == '-') ? ExprProgram::OP_SUB : ExprProgram::OP_ADD);
+    }
+}
+
+bool ExprEval::Compile(EVAL_CHAR* expr, BaseVarMap *var_map,
+		       ExprProgram& prog)
+{
+  _paren_count  = 0;
+  _err          = EEE_NO_ERROR;
+  _var_map	= var_map;
+  _prog         = &prog;
+
+  prog._code.clear();
+  prog._depth = 0;
+  prog._max_depth = 0;
+
+  CompileSummands(expr);
+
+  // Now, expr should point to '\0', and _paren_count should be zero
+  if(_paren_count != 0 || *expr == ')') {
+    _err = EEE_PARENTHESIS;
+    _err_pos = expr;
+  }
+  else if(*expr != '\0') {
+    _err = EEE_WRONG_CHAR;
+    _err_pos = expr;
+  }
+
+  _prog = NULL;
+  if (_err != EEE_NO_ERROR) {
+    prog._code.clear();
+    return false;
+  }
+  return true;
+}
+
+void ExprProgram::Emit(OpCode op, double val, unsigned int var)
+{
+  Instr instr;
+  instr.op  = op;
+  instr.val = val;
+  instr.var = var;
+  _code.push_back(instr);
+
+  if (op == OP_CONST || op == OP_VAR) {
+    _depth++;
+    if (_depth > _max_depth)
+      _max_depth = _depth;
+  }
+  else if (op != OP_NEG) {
+    _depth--;
+  }
+}
+
+double ExprProgram::Eval(BaseVarMap *var_map, EXPR_EVAL_ERR& err) const
+{
+  double* stack = (double*) alloca(_max_depth * sizeof(double));
+  int sp = 0;
+
+  err = EEE_NO_ERROR;
+
+  for (size_t i = 0; i < _code.size(); i++) {
+    const Instr& instr = _code[i];
+    switch (instr.op) {
+      case OP_CONST:
+        stack[sp++] = instr.val;
+        break;
+      case OP_VAR: {
+        double val = var_map->getValue(instr.var);
+        if (var_map->getErrorCode() != 0) {
+          err = EEE_INCORRECT_VAR;
+          return 0;
+        }
+        stack[sp++] = val;
+        break;
+      }
+      case OP_NEG:
+        stack[sp-1] = -stack[sp-1];
+        break;
+      case OP_ADD:
+        sp--;
+        stack[sp-1] += stack[sp];
+        break;
+      case OP_SUB:
+        sp--;
+        stack[sp-1] -= stack[sp];
+        break;
+      case OP_MUL:
+        sp--;
+        stack[sp-1] *= stack[sp];
+        break;
+      case OP_DIV:
+        sp--;
+        // Handle division by zero
+        if (stack[sp] == 0) {
+          err = EEE_DIVIDE_BY_ZERO;
+          return 0;
+        }
+        stack[sp-1] /= stack[sp];
+        break;
+    }
+  }
+  return (sp > 0) ? stack[0] : 0;
+}
+
 EXPR_EVAL_ERR ExprEval::GetErr() 
 {
   return _err;
@@ -167,88 +372,180 @@ EVAL_CHAR* ExprEval::GetErrPos()
 // =======
 
 #ifdef _DEBUG
+// Variables $0 .. $7 for the tests; any other variable is an error
+class TestVarMap : public BaseVarMap {
+public:
+  TestVarMap() : _err(0) { }
+
+  bool isVariable(char *expr) {
+    return *expr == '$';
+  }
+
+  double getValue(unsigned int var) {
+    static const double vals[] = { 0, 1, -2, 0.5, 3e10, -1e-3, 7, 42 };
+    _err = (var < sizeof(vals) / sizeof(vals[0])) ? 0 : 1;
+    return (_err == 0) ? vals[var] : 0;
+  }
+
+  int getErrorCode() {
+    return _err;
+  }
+
+private:
+  int _err;
+};
+
+// Write a random, sometimes malformed, expression at buf
+static void RandomExpr(EVAL_CHAR*& buf, int depth)
+{
+  static const char* atoms[] = { "0", "1", "2.5", ".25", "1e3", "$0", "$1",
+                                 "$2", "$3", "$4", "$5", "$6", "$7", "$9" };
+  static const char ops[] = "+-*/";
+  static const char junk[] = ")(x*";
+
+  int nterms = 1 + rand() % 4;
+  for (int i = 0; i < nterms; i++) {
+    if (i > 0)
+      *buf++ = ops[rand() % 4];
+    if (rand() % 4 == 0)
+      *buf++ = ' ';
+    int sign = rand() % 6;
+    if (sign == 0)
+      *buf++ = '-';
+    else if (sign == 1)
+      *buf++ = '+';
+
+    if (depth > 0 && rand() % 3 == 0) {
+      *buf++ = '(';
+      RandomExpr(buf, depth - 1);
+      *buf++ = ')';
+    }
+    else {
+      const char* atom = atoms[rand() % (sizeof(atoms) / sizeof(atoms[0]))];
+      strcpy(buf, atom);
+      buf += strlen(atom);
+    }
+  }
+  if (rand() % 50 == 0)
+    *buf++ = junk[rand() % 4];
+}
+
+// Compiled expressions must agree with ExprEval::Eval().  (The error
+// codes may differ: e.g., Eval() stops at "2/0*3" and then reports the
+// unparsed "*3", while the compiled program reports the division.)
+void TestExprEvalCompiled() {
+  ExprEval eval;
+  ExprProgram prog;
+  TestVarMap var_map;
+  EVAL_CHAR expr[16384]; // enough for RandomExpr(., 3)
+
+  srand(1);
+  for (int i = 0; i < 20000; i++) {
+    EVAL_CHAR* end = expr;
+    RandomExpr(end, 3);
+    *end = '\0';
+
+    double res1 = eval.Eval(expr, &var_map);
+    bool ok1 = (eval.GetErr() == EEE_NO_ERROR);
+
+    EXPR_EVAL_ERR err2 = EEE_NO_ERROR;
+    double res2 = 0;
+    if (eval.Compile(expr, &var_map, prog))
+      res2 = prog.Eval(&var_map, err2);
+    else
+      err2 = eval.GetErr();
+    bool ok2 = (err2 == EEE_NO_ERROR);
+
+    assert(ok1 == ok2);
+    assert(!ok1 || res1 == res2 || (res1 != res1 && res2 != res2));
+  }
+}
+
 void TestExprEval() {
   ExprEval eval;
+  TestVarMap var_map;
   // Some simple expressions
-  assert(eval.Eval("1234") == 1234 && eval.GetErr() == EEE_NO_ERROR);
-  assert(eval.Eval("1+2*3") == 7 && eval.GetErr() == EEE_NO_ERROR);
+  assert(eval.Eval("1234", &var_map) == 1234 && eval.GetErr() == EEE_NO_ERROR);
+  assert(eval.Eval("1+2*3", &var_map) == 7 && eval.GetErr() == EEE_NO_ERROR);
 
   // Parenthesis
-  assert(eval.Eval("5*(4+4+1)") == 45 && eval.GetErr() == EEE_NO_ERROR);
-  assert(eval.Eval("5*(2*(1+3)+1)") == 45 && eval.GetErr() == EEE_NO_ERROR);
-  assert(eval.Eval("5*((1+3)*2+1)") == 45 && eval.GetErr() == EEE_NO_ERROR);
+  assert(eval.Eval("5*(4+4+1)", &var_map) == 45 && eval.GetErr() == EEE_NO_ERROR);
+  assert(eval.Eval("5*(2*(1+3)+1)", &var_map) == 45 && eval.GetErr() == EEE_NO_ERROR);
+  assert(eval.Eval("5*((1+3)*2+1)", &var_map) == 45 && eval.GetErr() == EEE_NO_ERROR);
 
   // Spaces
-  assert(eval.Eval("5 * ((1 + 3) * 2 + 1)") == 45 && eval.GetErr() == EEE_NO_ERROR);
-  assert(eval.Eval("5 - 2 * ( 3 )") == -1 && eval.GetErr() == EEE_NO_ERROR);
-  assert(eval.Eval("5 - 2 * ( ( 4 )  - 1 )") == -1 && eval.GetErr() == EEE_NO_ERROR);
+  assert(eval.Eval("5 * ((1 + 3) * 2 + 1)", &var_map) == 45 && eval.GetErr() == EEE_NO_ERROR);
+  assert(eval.Eval("5 - 2 * ( 3 )", &var_map) == -1 && eval.GetErr() == EEE_NO_ERROR);
+  assert(eval.Eval("5 - 2 * ( ( 4 )  - 1 )", &var_map) == -1 && eval.GetErr() == EEE_NO_ERROR);
 
   // Sign before parenthesis
-  assert(eval.Eval("-(2+1)*4") == -12 && eval.GetErr() == EEE_NO_ERROR);
-  assert(eval.Eval("-4*(2+1)") == -12 && eval.GetErr() == EEE_NO_ERROR);
+  assert(eval.Eval("-(2+1)*4", &var_map) == -12 && eval.GetErr() == EEE_NO_ERROR);
+  assert(eval.Eval("-4*(2+1)", &var_map) == -12 && eval.GetErr() == EEE_NO_ERROR);
   
   // Fractional numbers
-  assert(eval.Eval("1.5/5") == 0.3 && eval.GetErr() == EEE_NO_ERROR);
-  assert(eval.Eval("1/5e10") == 2e-11 && eval.GetErr() == EEE_NO_ERROR);
-  assert(eval.Eval("(4-3)/(4*4)") == 0.0625 && eval.GetErr() == EEE_NO_ERROR);
-  assert(eval.Eval("1/2/2") == 0.25 && eval.GetErr() == EEE_NO_ERROR);
-  assert(eval.Eval("0.25 * .5 * 0.5") == 0.0625 && eval.GetErr() == EEE_NO_ERROR);
-  assert(eval.Eval(".25 / 2 * .5") == 0.0625 && eval.GetErr() == EEE_NO_ERROR);
+  assert(eval.Eval("1.5/5", &var_map) == 0.3 && eval.GetErr() == EEE_NO_ERROR);
+  assert(eval.Eval("1/5e10", &var_map) == 2e-11 && eval.GetErr() == EEE_NO_ERROR);
+  assert(eval.Eval("(4-3)/(4*4)", &var_map) == 0.0625 && eval.GetErr() == EEE_NO_ERROR);
+  assert(eval.Eval("1/2/2", &var_map) == 0.25 && eval.GetErr() == EEE_NO_ERROR);
+  assert(eval.Eval("0.25 * .5 * 0.5", &var_map) == 0.0625 && eval.GetErr() == EEE_NO_ERROR);
+  assert(eval.Eval(".25 / 2 * .5", &var_map) == 0.0625 && eval.GetErr() == EEE_NO_ERROR);
   
   // Repeated operators
-  assert(eval.Eval("1+-2") == -1 && eval.GetErr() == EEE_NO_ERROR);
-  assert(eval.Eval("--2") == 2 && eval.GetErr() == EEE_NO_ERROR);
-  assert(eval.Eval("2---2") == 0 && eval.GetErr() == EEE_NO_ERROR);
-  assert(eval.Eval("2-+-2") == 4 && eval.GetErr() == EEE_NO_ERROR);
+  assert(eval.Eval("1+-2", &var_map) == -1 && eval.GetErr() == EEE_NO_ERROR);
+  assert(eval.Eval("--2", &var_map) == 2 && eval.GetErr() == EEE_NO_ERROR);
+  assert(eval.Eval("2---2", &var_map) == 0 && eval.GetErr() == EEE_NO_ERROR);
+  assert(eval.Eval("2-+-2", &var_map) == 4 && eval.GetErr() == EEE_NO_ERROR);
 
   // === Errors ===
   // Parenthesis error
-  eval.Eval("5*((1+3)*2+1");
+  eval.Eval("5*((1+3)*2+1", &var_map);
   assert(eval.GetErr() == EEE_PARENTHESIS && strcmp(eval.GetErrPos(), "") == 0);
-  eval.Eval("5*((1+3)*2)+1)");
+  eval.Eval("5*((1+3)*2)+1)", &var_map);
   assert(eval.GetErr() == EEE_PARENTHESIS && strcmp(eval.GetErrPos(), ")") == 0);
   
   // Repeated operators (wrong)
-  eval.Eval("5*/2");
+  eval.Eval("5*/2", &var_map);
   assert(eval.GetErr() == EEE_WRONG_CHAR && strcmp(eval.GetErrPos(), "/2") == 0);
   
   // Wrong position of an operator
-  eval.Eval("*2");
+  eval.Eval("*2", &var_map);
   assert(eval.GetErr() == EEE_WRONG_CHAR && strcmp(eval.GetErrPos(), "*2") == 0);
-  eval.Eval("2+");
+  eval.Eval("2+", &var_map);
   assert(eval.GetErr() == EEE_WRONG_CHAR && strcmp(eval.GetErrPos(), "") == 0);
-  eval.Eval("2*");
+  eval.Eval("2*", &var_map);
   assert(eval.GetErr() == EEE_WRONG_CHAR && strcmp(eval.GetErrPos(), "") == 0);
   
   // Division by zero
-  eval.Eval("2/0");
+  eval.Eval("2/0", &var_map);
   assert(eval.GetErr() == EEE_DIVIDE_BY_ZERO && strcmp(eval.GetErrPos(), "/0") == 0);
-  eval.Eval("3+1/(5-5)+4");
+  eval.Eval("3+1/(5-5)+4", &var_map);
   assert(eval.GetErr() == EEE_DIVIDE_BY_ZERO && strcmp(eval.GetErrPos(), "/(5-5)+4") == 0);
-  eval.Eval("2/"); // Erroneously detected as division by zero, but that's ok for us
+  eval.Eval("2/", &var_map); // Erroneously detected as division by zero, but that's ok for us
   assert(eval.GetErr() == EEE_DIVIDE_BY_ZERO && strcmp(eval.GetErrPos(), "/") == 0);
   
   // Invalid characters
-  eval.Eval("~5");
+  eval.Eval("~5", &var_map);
   assert(eval.GetErr() == EEE_WRONG_CHAR && strcmp(eval.GetErrPos(), "~5") == 0);
-  eval.Eval("5x");
+  eval.Eval("5x", &var_map);
   assert(eval.GetErr() == EEE_WRONG_CHAR && strcmp(eval.GetErrPos(), "x") == 0);
 
   // Multiply errors
-  eval.Eval("3+1/0+4$"); // Only one error will be detected (in this case, the last one)
+  eval.Eval("3+1/0+4$", &var_map); // Only one error will be detected (in this case, the last one)
   assert(eval.GetErr() == EEE_WRONG_CHAR && strcmp(eval.GetErrPos(), "$") == 0);
-  eval.Eval("3+1/0+4");
+  eval.Eval("3+1/0+4", &var_map);
   assert(eval.GetErr() == EEE_DIVIDE_BY_ZERO && strcmp(eval.GetErrPos(), "/0+4") == 0);
-  eval.Eval("q+1/0)"); // ...or the first one
+  eval.Eval("q+1/0)", &var_map); // ...or the first one
   assert(eval.GetErr() == EEE_WRONG_CHAR && strcmp(eval.GetErrPos(), "q+1/0)") == 0);
-  eval.Eval("+1/0)");
+  eval.Eval("+1/0)", &var_map);
   assert(eval.GetErr() == EEE_PARENTHESIS && strcmp(eval.GetErrPos(), ")") == 0);
-  eval.Eval("+1/0");
+  eval.Eval("+1/0", &var_map);
   assert(eval.GetErr() == EEE_DIVIDE_BY_ZERO && strcmp(eval.GetErrPos(), "/0") == 0);
   
   // An emtpy string
-  eval.Eval("");
+  eval.Eval("", &var_map);
   assert(eval.GetErr() == EEE_WRONG_CHAR && strcmp(eval.GetErrPos(), "") == 0);
+
+  TestExprEvalCompiled();
 }
 #endif
 
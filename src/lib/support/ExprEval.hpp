@@ -4,6 +4,8 @@
 #ifndef __ExprEval_H__
 #define  __ExprEval_H__
 
+#include <vector>
+
 #include <lib/support/BaseVarMap.hpp>   // basic var map class
 
 // Error codes enumeration
@@ -19,6 +21,38 @@ enum EXPR_EVAL_ERR {
 #define EVAL_CHAR char
 
 
+// A math expression compiled by ExprEval::Compile() into a postfix
+// program, so that it can be evaluated many times (e.g., once per CCT
+// node) without re-parsing the text
+class ExprProgram {
+  friend class ExprEval;
+
+public:
+  ExprProgram() : _max_depth(0) { }
+
+  // evaluate the program, substituting variables from var_map.  'err'
+  // is set as ExprEval::GetErr() would be by ExprEval::Eval()
+  double Eval(BaseVarMap *var_map, EXPR_EVAL_ERR& err) const;
+
+  bool empty() const { return _code.empty(); }
+
+private:
+  enum OpCode { OP_CONST, OP_VAR, OP_NEG, OP_ADD, OP_SUB, OP_MUL, OP_DIV };
+
+  struct Instr {
+    OpCode op;
+    double val;          // OP_CONST
+    unsigned int var;    // OP_VAR
+  };
+
+  void Emit(OpCode op, double val = 0, unsigned int var = 0);
+
+  std::vector<Instr> _code;
+  int _depth;            // stack depth while compiling
+  int _max_depth;
+};
+
+
 // Parser class to evaluate math expression
 // The math expression has to be simple operators:
 // +,-,*, /, ( and ) 
@@ -41,10 +75,23 @@ private:
   // parse a sum or substraction
   double ParseSummands(EVAL_CHAR*& expr) ;
 
+  // As above, but emit code into _prog rather than computing a value
+  void CompileAtom(EVAL_CHAR*& expr) ;
+  void CompileFactors(EVAL_CHAR*& expr) ;
+  void CompileSummands(EVAL_CHAR*& expr) ;
+
+  ExprProgram *_prog;
+
 public:
   // main method to evaluate a math expression
   double  Eval(EVAL_CHAR* expr, BaseVarMap *var_map);
 
+  // compile a math expression for repeated evaluation with
+  // ExprProgram::Eval().  Returns false (and sets the error code) if
+  // the expression is malformed.  var_map is only used to recognize
+  // variables.
+  bool    Compile(EVAL_CHAR* expr, BaseVarMap *var_map, ExprProgram& prog);
+
   // get the error code
   EXPR_EVAL_ERR GetErr();
 
@@ -62,6 +62,8 @@
 #include <string>
 using std::string;
 
+#include <pthread.h>
+
 
 //*************************** User Include Files ****************************
 
@@ -86,6 +88,10 @@ using std::string;
 
 static RealPathMgr s_singleton;
 
+// serializes RealPathMgr::realpath(), whose cache (and the PathFindMgr
+// it consults) may be used by several profile readers at once
+static pthread_mutex_t s_realpathLock = PTHREAD_MUTEX_INITIALIZER;
+
 
 // Constructor with static singleton objects for PathFindMgr and
 // PathReplacementMgr.
@@ -132,6 +138,8 @@ RealPathMgr::realpath(string& pathNm) const
   
   // INVARIANT: 'pathNm' is not empty
 
+  pthread_mutex_lock(&s_realpathLock);
+
   // INVARIANT: all entries in the map are non-empty
   MyMap::iterator it = m_cache.find(pathNm);
 
@@ -199,6 +207,9 @@ RealPathMgr::realpath(string& pathNm) const
       m_cache.insert(make_pair(pathNm_orig, pathNm_real));
     }
   }
+
+  pthread_mutex_unlock(&s_realpathLock);
+
   return (pathNm[0] == '/'); // fully resolved
 }
 
@@ -65,6 +65,8 @@
 using std::string;
 
 #include <cstring>
+#include <cstdio>
+#include <algorithm>
 
 //*************************** User Include Files ****************************
 
@@ -184,6 +186,122 @@ xml::substitute(const char* str, const string* fromStrs, const string* toStrs)
   return retStr;
 }
 
+
+//****************************************************************************
+// OutBuffer
+//****************************************************************************
+
+const size_t OutBuffer::DefaultCapacity;
+
+
+OutBuffer::OutBuffer(std::ostream* os, size_t capacity)
+  : m_os(os), m_len(0), m_capacity((capacity > 64) ? capacity : 64)
+{
+  m_buf = new char[m_capacity];
+}
+
+
+OutBuffer::~OutBuffer()
+{
+  flush();
+  delete[] m_buf;
+}
+
+
+void
+OutBuffer::putEscaped(const char* s)
+{
+  if (!s) {
+    return;
+  }
+
+  // copy runs of ordinary chars at once
+  const char* run = s;
+  for ( ; *s != '\0'; ++s) {
+    const char* esc = NULL;
+    switch (*s) {
+      case '<':  esc = "&lt;";   break;
+      case '>':  esc = "&gt;";   break;
+      case '&':  esc = "&amp;";  break;
+      case '"':  esc = "&quot;"; break;
+      default:   break;
+    }
+    if (esc) {
+      put(run, s - run);
+      put(esc);
+      run = s + 1;
+    }
+  }
+  put(run, s - run);
+}
+
+
+void
+OutBuffer::putNum(uint64_t x)
+{
+  char str[24];
+  char* p = str + sizeof(str);
+  do {
+    *--p = (char)('0' + (x % 10));
+    x /= 10;
+  } while (x != 0);
+  put(p, (str + sizeof(str)) - p);
+}
+
+
+void
+OutBuffer::putNum(double x)
+{
+  // "%g" never needs more than 6 significant digits, a sign, a
+  // point and an exponent; 32 chars is ample.
+  const size_t maxLen = 32;
+  reserve(maxLen);
+  int len = snprintf(m_buf + m_len, maxLen, "%g", x);
+  if (len > 0) {
+    m_len += std::min((size_t)len, maxLen - 1);
+  }
+}
+
+
+void
+OutBuffer::writeTo(std::ostream& os)
+{
+  if (m_len > 0) {
+    os.write(m_buf, m_len);
+    m_len = 0;
+  }
+}
+
+
+void
+OutBuffer::flush()
+{
+  if (m_os) {
+    writeTo(*m_os);
+  }
+}
+
+
+void
+OutBuffer::makeRoom(size_t n)
+{
+  flush();
+  if (m_len + n <= m_capacity) {
+    return;
+  }
+
+  // no stream (or a request larger than the buffer): grow
+  size_t capacity = m_capacity;
+  while (m_len + n > capacity) {
+    capacity *= 2;
+  }
+  char* buf = new char[capacity];
+  memcpy(buf, m_buf, m_len);
+  delete[] m_buf;
+  m_buf = buf;
+  m_capacity = capacity;
+}
+
 //****************************************************************************
 //
 //****************************************************************************
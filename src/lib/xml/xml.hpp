@@ -67,6 +67,8 @@
 #include <iostream>
 #include <string>
 
+#include <cstring>
+
 #include <inttypes.h>
 
 //*************************** User Include Files ****************************
@@ -249,6 +251,172 @@ namespace xml {
     return (attB + StrUtil::toStr(x, format) + attE);
   }
 
+
+  // -------------------------------------------------------  
+  // OutBuffer: a large, reusable output buffer for writing XML without
+  // building intermediate strings.  Output accumulates in the buffer
+  // and, if a stream is attached, is written to it whenever the buffer
+  // fills and on flush().  Without a stream, the buffer simply grows
+  // and may be written later with writeTo(); clear() keeps the
+  // storage for reuse.
+  //
+  // The put* routines produce exactly the text of the corresponding
+  // MakeAttr*/EscapeStr routines.  Unlike those (which format through
+  // static scratch space), they are safe to use from concurrent
+  // threads, provided each thread uses its own OutBuffer.
+  // -------------------------------------------------------  
+
+  class OutBuffer {
+  public:
+    static const size_t DefaultCapacity = (1 << 20); // 1 MB
+
+    OutBuffer(std::ostream* os = NULL, size_t capacity = DefaultCapacity);
+    ~OutBuffer();
+
+    // -------------------------------------------------------
+    // raw text
+    // -------------------------------------------------------
+    void
+    put(char c)
+    {
+      reserve(1);
+      m_buf[m_len++] = c;
+    }
+
+    void
+    put(const char* s, size_t len)
+    {
+      reserve(len);
+      memcpy(m_buf + m_len, s, len);
+      m_len += len;
+    }
+
+    void
+    put(const char* s)
+    { put(s, strlen(s)); }
+
+    void
+    put(const std::string& s)
+    { put(s.data(), s.length()); }
+
+    void
+    putSpaces(size_t n)
+    {
+      reserve(n);
+      memset(m_buf + m_len, ' ', n);
+      m_len += n;
+    }
+
+    // escape reserved XML chars (cf. EscapeStr)
+    void
+    putEscaped(const char* s);
+
+    // -------------------------------------------------------
+    // numbers (decimal, or "%g" for doubles)
+    // -------------------------------------------------------
+    void
+    putNum(uint64_t x);
+
+    void
+    putNum(int64_t x)
+    {
+      if (x < 0) {
+	put('-');
+	putNum((uint64_t)0 - (uint64_t)x);
+      }
+      else {
+	putNum((uint64_t)x);
+      }
+    }
+
+    void
+    putNum(unsigned int x)
+    { putNum((uint64_t)x); }
+
+    void
+    putNum(int x)
+    { putNum((int64_t)x); }
+
+    void
+    putNum(double x);
+
+    // -------------------------------------------------------
+    // attribute values, including 'attB' and 'attE' (cf. MakeAttr*)
+    // -------------------------------------------------------
+    template <class T>
+    void
+    putAttrNum(T x)
+    {
+      put("=\"", 2);
+      putNum(x);
+      put('"');
+    }
+
+    void
+    putAttrStr(const char* x, int flags = ESC_TRUE)
+    {
+      put("=\"", 2);
+      if (flags & ESC_TRUE) {
+	putEscaped(x);
+      }
+      else {
+	put(x);
+      }
+      put('"');
+    }
+
+    void
+    putAttrStr(const std::string& x, int flags = ESC_TRUE)
+    { putAttrStr(x.c_str(), flags); }
+
+    // -------------------------------------------------------
+    // buffer management
+    // -------------------------------------------------------
+    const char*
+    data() const
+    { return m_buf; }
+
+    size_t
+    size() const
+    { return m_len; }
+
+    // discard contents, retaining storage
+    void
+    clear()
+    { m_len = 0; }
+
+    // write contents to 'os' (and discard them)
+    void
+    writeTo(std::ostream& os);
+
+    // write contents to the attached stream, if any
+    void
+    flush();
+
+  private:
+    // ensure room for 'n' more chars, flushing or growing as needed
+    void
+    reserve(size_t n)
+    {
+      if (m_len + n > m_capacity) {
+	makeRoom(n);
+      }
+    }
+
+    void
+    makeRoom(size_t n);
+
+    // not copyable
+    OutBuffer(const OutBuffer& x);
+    OutBuffer& operator=(const OutBuffer& x);
+
+  private:
+    std::ostream* m_os;
+    char*  m_buf;
+    size_t m_len;
+    size_t m_capacity;
+  };
+
 }
 
 #endif /* xml_xml_hpp */
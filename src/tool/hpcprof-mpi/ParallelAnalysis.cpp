@@ -382,9 +382,9 @@ packMetrics(const Prof::CallPath::Profile& profile,
   DIAG_Assert(packedMetrics.numMetrics() == mDrvdEnd - mDrvdBeg, "");
 
   for (Prof::CCT::ANodeIterator it(cct.root()); it.Current(); ++it) {
-    Prof::CCT::ANode* n = it.current();
+    const Prof::CCT::ANode* n = it.current();
     for (uint mId1 = 0, mId2 = mDrvdBeg; mId2 < mDrvdEnd; ++mId1, ++mId2) {
-      packedMetrics.idx(n->id(), mId1) = n->metric(mId2);
+      packedMetrics.idx(n->id(), mId1) = n->peekMetric(mId2);
     }
   }
 }
@@ -415,7 +415,8 @@ unpackMetrics(Prof::CallPath::Profile& profile,
   uint mDrvdBeg = packedMetrics.mDrvdBegId();
   uint mDrvdEnd = packedMetrics.mDrvdEndId();
   cct.root()->computeMetricsIncr(*profile.metricMgr(), mDrvdBeg, mDrvdEnd,
-				 Prof::Metric::AExprIncr::FnCombine);
+				 Prof::Metric::AExprIncr::FnCombine,
+				 packedMetrics.doBatchMetrics());
 }
 
 
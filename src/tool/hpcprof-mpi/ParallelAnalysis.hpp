@@ -96,10 +96,11 @@ class PackedMetrics
 public:
   // [mBegId, mEndId)
   PackedMetrics(uint numNodes, uint mBegId, uint mEndId,
-		uint mDrvdBegId, uint mDrvdEndId)
+		uint mDrvdBegId, uint mDrvdEndId, bool doBatchMetrics = false)
     : m_numNodes(numNodes), m_numMetrics(mEndId - mBegId),
       m_mBegId(mBegId), m_mEndId(mEndId),
-      m_mDrvdBegId(mDrvdBegId), m_mDrvdEndId(mDrvdEndId)
+      m_mDrvdBegId(mDrvdBegId), m_mDrvdEndId(mDrvdEndId),
+      m_doBatchMetrics(doBatchMetrics)
   {
     size_t sz = dataSize();
     m_packedData = new double[sz];
@@ -155,6 +156,12 @@ public:
   mDrvdEndId() const
   { return m_mDrvdEndId; }
 
+  // doBatchMetrics: update derived metrics with batch evaluation
+  //   (cf. Prof::CCT::ANode::computeMetricsIncr())
+  bool
+  doBatchMetrics() const
+  { return m_doBatchMetrics; }
+
 
   bool
   verify() const
@@ -185,6 +192,7 @@ private:
   uint m_mBegId, m_mEndId; // [ )
 
   uint m_mDrvdBegId, m_mDrvdEndId; // [ )
+  bool m_doBatchMetrics;
 
   double* m_packedData; // use row-major layout
 
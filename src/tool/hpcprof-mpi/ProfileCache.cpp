@@ -0,0 +1,270 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   [The purpose of this file]
+//
+// Description:
+//   [The set of functions, macros, etc. defined in the file]
+//
+//***************************************************************************
+
+//************************* System Include Files ****************************
+
+#include <string>
+using std::string;
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+//*************************** User Include Files ****************************
+
+#include "ProfileCache.hpp"
+
+#include <lib/support/diagnostics.h>
+
+//*************************** Forward Declarations **************************
+
+static bool
+readAll(int fd, char* buf, size_t size, off_t offset);
+
+static bool
+writeAll(int fd, const char* buf, size_t size, off_t offset);
+
+//***************************************************************************
+// ProfileCache
+//***************************************************************************
+
+ProfileCache::ProfileCache(size_t memLimit, const string& scratchDir)
+  : m_memLimit(memLimit), m_memSz(0),
+    m_scratchDir(scratchDir), m_spillFd(-1), m_spillSz(0),
+    m_rdBuf(NULL), m_rdBufSz(0)
+{
+}
+
+
+ProfileCache::~ProfileCache()
+{
+  for (EntryMap::iterator it = m_entries.begin();
+       it != m_entries.end(); ++it) {
+    delete[] it->second.data;
+  }
+  if (m_spillFd >= 0) {
+    ::close(m_spillFd); // the scratch file is already unlinked
+  }
+  delete[] m_rdBuf;
+}
+
+
+bool
+ProfileCache::insert(const string& fnm)
+{
+  if (m_entries.find(fnm) != m_entries.end()) {
+    return true;
+  }
+
+  int fd = ::open(fnm.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false; // the normal read path reports the error
+  }
+
+  struct stat sb;
+  if (fstat(fd, &sb) != 0) {
+    ::close(fd);
+    return false;
+  }
+
+  Entry entry;
+  entry.size = (size_t)sb.st_size;
+  entry.offset = 0;
+  entry.data = new char[entry.size + 1];
+
+  bool isOk = readAll(fd, entry.data, entry.size, 0);
+  ::close(fd);
+
+  if (isOk && (m_memSz + entry.size > m_memLimit)) {
+    isOk = spill(entry.data, entry.size, entry.offset);
+    delete[] entry.data;
+    entry.data = NULL;
+  }
+
+  if (!isOk) {
+    delete[] entry.data;
+    return false;
+  }
+
+  if (entry.data) {
+    m_memSz += entry.size;
+  }
+  m_entries.insert(std::make_pair(fnm, entry));
+
+  return true;
+}
+
+
+FILE*
+ProfileCache::open(const string& fnm)
+{
+  EntryMap::iterator it = m_entries.find(fnm);
+  if (it == m_entries.end() || it->second.size == 0) {
+    return NULL;
+  }
+
+  const Entry& entry = it->second;
+  char* data = entry.data;
+
+  if (!data) {
+    if (m_rdBufSz < entry.size) {
+      delete[] m_rdBuf;
+      m_rdBufSz = entry.size;
+      m_rdBuf = new char[m_rdBufSz];
+    }
+    if (!readAll(m_spillFd, m_rdBuf, entry.size, entry.offset)) {
+      DIAG_WMsg(1, "ProfileCache: failed to read back '" << fnm
+		<< "' from scratch file; re-reading original file");
+      return NULL;
+    }
+    data = m_rdBuf;
+  }
+
+  return fmemopen(data, entry.size, "r");
+}
+
+
+void
+ProfileCache::close(FILE* fs)
+{
+  if (fs) {
+    fclose(fs);
+  }
+}
+
+
+bool
+ProfileCache::spill(const char* data, size_t size, off_t& offset)
+{
+  if (m_spillFd < 0 && !m_scratchDir.empty()) {
+    string fnm = m_scratchDir + "/hpcprof-cache.XXXXXX";
+    char* fnmBuf = new char[fnm.size() + 1];
+    strcpy(fnmBuf, fnm.c_str());
+
+    m_spillFd = mkstemp(fnmBuf);
+    if (m_spillFd < 0) {
+      DIAG_WMsg(1, "ProfileCache: cannot create scratch file in '"
+		<< m_scratchDir << "' (" << strerror(errno)
+		<< "); profiles beyond the memory limit will be re-read");
+      m_scratchDir.clear(); // do not try again
+    }
+    else {
+      unlink(fnmBuf); // storage is reclaimed when the process exits
+    }
+    delete[] fnmBuf;
+  }
+
+  if (m_spillFd < 0) {
+    return false;
+  }
+
+  if (!writeAll(m_spillFd, data, size, m_spillSz)) {
+    return false;
+  }
+
+  offset = m_spillSz;
+  m_spillSz += (off_t)size;
+  return true;
+}
+
+
+//***************************************************************************
+
+static bool
+readAll(int fd, char* buf, size_t size, off_t offset)
+{
+  while (size > 0) {
+    ssize_t ret = pread(fd, buf, size, offset);
+    if (ret < 0 && errno == EINTR) {
+      continue;
+    }
+    if (ret <= 0) {
+      return false;
+    }
+    buf += ret;
+    size -= (size_t)ret;
+    offset += ret;
+  }
+  return true;
+}
+
+
+static bool
+writeAll(int fd, const char* buf, size_t size, off_t offset)
+{
+  while (size > 0) {
+    ssize_t ret = pwrite(fd, buf, size, offset);
+    if (ret < 0 && errno == EINTR) {
+      continue;
+    }
+    if (ret <= 0) {
+      return false;
+    }
+    buf += ret;
+    size -= (size_t)ret;
+    offset += ret;
+  }
+  return true;
+}
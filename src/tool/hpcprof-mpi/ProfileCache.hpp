@@ -0,0 +1,149 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   Keep a copy of each local profile file so that hpcprof-mpi reads
+//   it from the (parallel) file system only once.
+//
+// Description:
+//   [The set of functions, macros, etc. defined in the file]
+//
+//***************************************************************************
+
+#ifndef ProfileCache_hpp
+#define ProfileCache_hpp
+
+//************************* System Include Files ****************************
+
+#include <string>
+#include <map>
+
+#include <cstdio>
+
+#include <sys/types.h>
+
+//*************************** User Include Files ****************************
+
+#include <include/uint.h>
+
+#include <lib/support/Unique.hpp>
+
+//*************************** Forward Declarations **************************
+
+//***************************************************************************
+// ProfileCache
+//***************************************************************************
+
+// ProfileCache: Holds the raw contents of profile files.  Up to
+// 'memLimit' bytes are kept in memory; the remainder is appended to
+// an (unlinked) scratch file in 'scratchDir', which should be on a
+// node-local file system.  An empty 'scratchDir' disables spilling;
+// files that do not fit are then simply not cached.
+class ProfileCache
+  : public Unique // prevent copying
+{
+public:
+  ProfileCache(size_t memLimit, const std::string& scratchDir);
+
+  ~ProfileCache();
+
+  // insert: read profile file 'fnm' into the cache.  Returns false
+  //   (and caches nothing) if 'fnm' could not be read or stored.
+  bool
+  insert(const std::string& fnm);
+
+  // open: return a read-only stream over the cached contents of 'fnm'
+  //   or NULL if 'fnm' is not cached.  At most one stream may be open
+  //   at a time; release it with close().
+  FILE*
+  open(const std::string& fnm);
+
+  void
+  close(FILE* fs);
+
+  size_t
+  memSize() const
+  { return m_memSz; }
+
+  size_t
+  spillSize() const
+  { return (size_t)m_spillSz; }
+
+private:
+  bool
+  spill(const char* data, size_t size, off_t& offset);
+
+private:
+  // an entry either holds its 'data' or lives at 'offset' within the
+  // scratch file
+  struct Entry {
+    char*  data;
+    off_t  offset;
+    size_t size;
+  };
+
+  typedef std::map<std::string, Entry> EntryMap;
+
+  EntryMap m_entries;
+
+  size_t m_memLimit;
+  size_t m_memSz;
+
+  std::string m_scratchDir;
+  int   m_spillFd;
+  off_t m_spillSz;
+
+  char*  m_rdBuf; // staging buffer for spilled entries
+  size_t m_rdBufSz;
+};
+
+
+#endif // ProfileCache_hpp
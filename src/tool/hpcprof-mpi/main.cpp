@@ -87,6 +87,7 @@ using std::vector;
 
 #include "Args.hpp"
 #include "ParallelAnalysis.hpp"
+#include "ProfileCache.hpp"
 
 #include <lib/analysis/CallPath.hpp>
 #include <lib/analysis/Util.hpp>
@@ -114,19 +115,50 @@ myNormalizeProfileArgs(const Analysis::Util::StringVec& profileFiles,
 		       int myRank, int numRanks);
 
 
+static Prof::CallPath::Profile*
+readProfile(const string& profileFile, uint groupId, uint rFlags,
+	    ProfileCache* cache);
+
+
+// ProfileStager: Stage each profile file in 'cache' as it is first
+// read by Analysis::CallPath::read().
+class ProfileStager : public Analysis::CallPath::ProfileSource {
+public:
+  ProfileStager(ProfileCache& cache)
+    : m_cache(cache)
+  { }
+
+  virtual FILE*
+  open(const string& fnm)
+  {
+    m_cache.insert(fnm);
+    return m_cache.open(fnm);
+  }
+
+  virtual void
+  close(FILE* fs)
+  {
+    m_cache.close(fs);
+  }
+
+private:
+  ProfileCache& m_cache;
+};
+
+
 static void
 makeSummaryMetrics(Prof::CallPath::Profile& profGbl,
 		   const Analysis::Args& args,
 		   const Analysis::Util::NormalizeProfileArgs_t& nArgs,
 		   const vector<uint>& groupIdToGroupSizeMap,
-		   int myRank, int numRanks);
+		   ProfileCache* cache, int myRank, int numRanks);
 
 static void
 makeThreadMetrics(Prof::CallPath::Profile& profGbl,
 		  const Analysis::Args& args,
 		  const Analysis::Util::NormalizeProfileArgs_t& nArgs,
 		  const vector<uint>& groupIdToGroupSizeMap,
-		  int myRank, int numRanks);
+		  ProfileCache* cache, int myRank, int numRanks);
 
 static uint
 makeDerivedMetricDescs(Prof::CallPath::Profile& profGbl,
@@ -142,20 +174,20 @@ makeSummaryMetrics_Lcl(Prof::CallPath::Profile& profGbl,
 		       const string& profileFile,
 		       const Analysis::Args& args, uint groupId, uint groupMax,
 		       vector<VMAIntervalSet*>& groupIdToGroupMetricsMap,
-		       int myRank);
+		       ProfileCache* cache, int myRank);
 
 static void
 makeThreadMetrics_Lcl(Prof::CallPath::Profile& profGbl,
 		      const string& profileFile,
 		      const Analysis::Args& args, uint groupId, uint groupMax,
-		      int myRank);
+		      ProfileCache* cache, int myRank);
 
 static string
 makeDBFileName(const string& dbDir, uint groupId, const string& profileFile);
 
 static void
 writeMetricsDB(Prof::CallPath::Profile& profGbl, uint mBegId, uint mEndId,
-	       const string& metricDBFnm);
+	       const string& metricDBFnm, bool isSparse);
 
 
 static void
@@ -308,7 +340,24 @@ realmain(int argc, char* const* argv)
   Analysis::Util::UIntVec* groupMap =
     (nArgs.groupMax > 1) ? nArgs.groupMap : NULL;
 
-  profLcl = Analysis::CallPath::read(*nArgs.paths, groupMap, mergeTy, rFlags);
+  // With --read-once, each local profile file is read from the file
+  // system here and only here; later passes replay the cached copy.
+  ProfileCache* profCache = NULL;
+  if (args.prof_readOnce) {
+    const char* tmpDir = getenv("TMPDIR");
+    string scratchDir = (tmpDir && tmpDir[0] != '\0') ? tmpDir : "/tmp";
+    size_t memLimit = (size_t)args.prof_readOnceMemMB << 20;
+    profCache = new ProfileCache(memLimit, scratchDir);
+
+    ProfileStager stager(*profCache);
+    profLcl = Analysis::CallPath::read(*nArgs.paths, groupMap, mergeTy,
+				       rFlags, 0/*mrgFlags*/, 1/*numThreads*/,
+				       &stager);
+  }
+  else {
+    profLcl = Analysis::CallPath::read(*nArgs.paths, groupMap, mergeTy,
+				       rFlags);
+  }
 
   // -------------------------------------------------------
   // 1b. Create canonical CCT (metrics merged by <group>.<name>.*)
@@ -367,7 +416,7 @@ realmain(int argc, char* const* argv)
   // Post-INVARIANT: rank 0's 'profGbl' contains summary metrics
   // -------------------------------------------------------
   makeSummaryMetrics(*profGbl, args, nArgs, groupIdToGroupSizeMap,
-		     myRank, numRanks);
+		     profCache, myRank, numRanks);
 
   // -------------------------------------------------------
   // 2b. Prune and normalize canonical CCT
@@ -407,7 +456,9 @@ realmain(int argc, char* const* argv)
   // 2c. Create thread-level metric DB // Normalize trace files
   // -------------------------------------------------------
   makeThreadMetrics(*profGbl, args, nArgs, groupIdToGroupSizeMap,
-		    myRank, numRanks);
+		    profCache, myRank, numRanks);
+
+  delete profCache;
   
   // ------------------------------------------------------------
   // 3. Generate Experiment database
@@ -562,6 +613,26 @@ myNormalizeProfileArgs(const Analysis::Util::StringVec& profileFiles,
 }
 
 
+//***************************************************************************
+
+// readProfile: read 'profileFile', preferring its copy in 'cache' (if
+// any) over the file system
+static Prof::CallPath::Profile*
+readProfile(const string& profileFile, uint groupId, uint rFlags,
+	    ProfileCache* cache)
+{
+  FILE* fs = (cache) ? cache->open(profileFile) : NULL;
+
+  Prof::CallPath::Profile* prof =
+    Analysis::CallPath::read(profileFile.c_str(), fs, groupId, rFlags);
+
+  if (fs) {
+    cache->close(fs);
+  }
+  return prof;
+}
+
+
 //***************************************************************************
 
 // makeSummaryMetrics: Assumes 'profGbl' is the canonical CCT (with
@@ -571,7 +642,7 @@ makeSummaryMetrics(Prof::CallPath::Profile& profGbl,
 		   const Analysis::Args& args,
 		   const Analysis::Util::NormalizeProfileArgs_t& nArgs,
 		   const vector<uint>& groupIdToGroupSizeMap,
-		   int myRank, int numRanks)
+		   ProfileCache* cache, int myRank, int numRanks)
 {
   uint mDrvdBeg = 0, mDrvdEnd = 0;   // [ )
   uint mXDrvdBeg = 0, mXDrvdEnd = 0; // [ )
@@ -590,13 +661,14 @@ makeSummaryMetrics(Prof::CallPath::Profile& profGbl,
   // compute local contribution summary metrics (accumulate function)
   // -------------------------------------------------------
   cctRoot->computeMetricsIncr(mMgrGbl, mDrvdBeg, mDrvdEnd,
-			      Prof::Metric::AExprIncr::FnInit);
+			      Prof::Metric::AExprIncr::FnInit,
+			      args.prof_batchMetrics);
 
   for (uint i = 0; i < nArgs.paths->size(); ++i) {
     const string& fnm = (*nArgs.paths)[i];
     uint groupId = (*nArgs.groupMap)[i];
     makeSummaryMetrics_Lcl(profGbl, fnm, args, groupId, nArgs.groupMax,
-			   groupIdToGroupMetricsMap, myRank);
+			   groupIdToGroupMetricsMap, cache, myRank);
   }
 
   // -------------------------------------------------------
@@ -623,14 +695,16 @@ makeSummaryMetrics(Prof::CallPath::Profile& profGbl,
   // 2. Initialize temporary accumulators [mXDrvdBeg, mXDrvdEnd) used
   //    during the summary metrics reduction
   cctRoot->computeMetricsIncr(mMgrGbl, mXDrvdBeg, mXDrvdEnd,
-			      Prof::Metric::AExprIncr::FnInitSrc);
+			      Prof::Metric::AExprIncr::FnInitSrc,
+			      args.prof_batchMetrics);
 
   // 3. Reduction
   uint maxCCTId = profGbl.cct()->maxDenseId();
 
   ParallelAnalysis::PackedMetrics* packedMetrics =
     new ParallelAnalysis::PackedMetrics(maxCCTId + 1, mXDrvdBeg, mXDrvdEnd,
-					mDrvdBeg, mDrvdEnd);
+					mDrvdBeg, mDrvdEnd,
+					args.prof_batchMetrics);
 
   // Post-INVARIANT: rank 0's 'profGbl' contains summary metrics
   ParallelAnalysis::reduce(std::make_pair(&profGbl, packedMetrics),
@@ -661,12 +735,13 @@ makeThreadMetrics(Prof::CallPath::Profile& profGbl,
 		  const Analysis::Args& args,
 		  const Analysis::Util::NormalizeProfileArgs_t& nArgs,
 		  const vector<uint>& groupIdToGroupSizeMap,
-		  int myRank, int numRanks)
+		  ProfileCache* cache, int myRank, int numRanks)
 {
   for (uint i = 0; i < nArgs.paths->size(); ++i) {
     string& fnm = (*nArgs.paths)[i];
     uint groupId = (*nArgs.groupMap)[i];
-    makeThreadMetrics_Lcl(profGbl, fnm, args, groupId, nArgs.groupMax, myRank);
+    makeThreadMetrics_Lcl(profGbl, fnm, args, groupId, nArgs.groupMax,
+			  cache, myRank);
   }
 }
 
@@ -779,11 +854,10 @@ makeSummaryMetrics_Lcl(Prof::CallPath::Profile& profGbl,
 		       const string& profileFile,
 		       const Analysis::Args& args, uint groupId, uint groupMax,
 		       vector<VMAIntervalSet*>& groupIdToGroupMetricsMap,
-		       int myRank)
+		       ProfileCache* cache, int myRank)
 {
   Prof::Metric::Mgr* mMgrGbl = profGbl.metricMgr();
   Prof::CCT::Tree* cctGbl = profGbl.cct();
-  Prof::CCT::ANode* cctRootGbl = cctGbl->root();
 
   // -------------------------------------------------------
   // read profile file
@@ -793,7 +867,7 @@ makeSummaryMetrics_Lcl(Prof::CallPath::Profile& profGbl,
   uint rGroupId = (groupMax > 1) ? groupId : 0;
 
   Prof::CallPath::Profile* prof =
-    Analysis::CallPath::read(profileFile, rGroupId, rFlags);
+    readProfile(profileFile, rGroupId, rFlags, cache);
 
   // -------------------------------------------------------
   // merge into canonical CCT
@@ -815,8 +889,20 @@ makeSummaryMetrics_Lcl(Prof::CallPath::Profile& profGbl,
   Analysis::CallPath::noteStaticStructureOnLeaves(*prof);
   prof->structure(NULL);
 
+  // Note the canonical CCT nodes that receive this profile's values.
+  // Since all other nodes hold zeros for [mBeg, mEnd), the steps below
+  // only visit these nodes and their ancestors instead of the whole
+  // canonical CCT.
+  Prof::CCT::ANode::Vec mergedNodes;
+  cctGbl->mergedNodes(&mergedNodes);
+
   uint mBeg = profGbl.merge(*prof, mergeTy, mergeFlg); // [closed begin
   uint mEnd = mBeg + prof->metricMgr()->size();        //  open end)
+  profGbl.fixTraceFiles();
+
+  cctGbl->mergedNodes(NULL);
+
+  Prof::CCT::PathSet touchedPaths(mergedNodes);
 
   // -------------------------------------------------------
   // compute local incl/excl sampled metrics and update local derived metrics
@@ -836,8 +922,8 @@ makeSummaryMetrics_Lcl(Prof::CallPath::Profile& profGbl,
     }
   }
 
-  cctRootGbl->aggregateMetricsIncl(ivalsetIncl);
-  cctRootGbl->aggregateMetricsExcl(ivalsetExcl);
+  touchedPaths.aggregateMetricsIncl(ivalsetIncl);
+  touchedPaths.aggregateMetricsExcl(ivalsetExcl);
 
 
   // 2. Batch compute local derived metrics
@@ -849,8 +935,9 @@ makeSummaryMetrics_Lcl(Prof::CallPath::Profile& profGbl,
     uint mDrvdEnd = (uint)ival.end();
 
     DIAG_MsgIf(0, "[" << myRank << "] grp " << groupId << ": [" << mDrvdBeg << ", " << mDrvdEnd << ")");
-    cctRootGbl->computeMetricsIncr(*mMgrGbl, mDrvdBeg, mDrvdEnd,
-				   Prof::Metric::AExprIncr::FnAccum);
+    touchedPaths.computeMetricsIncr(*mMgrGbl, mDrvdBeg, mDrvdEnd,
+				    Prof::Metric::AExprIncr::FnAccum,
+				    args.prof_batchMetrics);
   }
 
   // -------------------------------------------------------
@@ -863,7 +950,7 @@ makeSummaryMetrics_Lcl(Prof::CallPath::Profile& profGbl,
   // two; and (b) use a CCT init (which whould initialize using
   // assignment) instead of CCT::merge() (which initializes based on
   // addition against 0).
-  cctRootGbl->zeroMetricsDeep(mBeg, mEnd); // cf. FnInitSrc
+  touchedPaths.zeroMetrics(mBeg, mEnd); // cf. FnInitSrc
   
   delete prof;
 }
@@ -879,7 +966,7 @@ static void
 makeThreadMetrics_Lcl(Prof::CallPath::Profile& profGbl,
 		      const string& profileFile,
 		      const Analysis::Args& args, uint groupId, uint groupMax,
-		      int myRank)
+		      ProfileCache* cache, int myRank)
 {
   Prof::Metric::Mgr* mMgrGbl = profGbl.metricMgr();
   Prof::CCT::Tree* cctGbl = profGbl.cct();
@@ -893,7 +980,7 @@ makeThreadMetrics_Lcl(Prof::CallPath::Profile& profGbl,
   uint rGroupId = (groupMax > 1) ? groupId : 0;
 
   Prof::CallPath::Profile* prof =
-    Analysis::CallPath::read(profileFile, rGroupId, rFlags);
+    readProfile(profileFile, rGroupId, rFlags, cache);
 
   // -------------------------------------------------------
   // merge into canonical CCT
@@ -917,10 +1004,10 @@ makeThreadMetrics_Lcl(Prof::CallPath::Profile& profGbl,
   prof->structure(NULL);
 
   uint mBeg = profGbl.merge(*prof, mergeTy, mergeFlg); // [closed begin
+  uint mEnd = mBeg + prof->metricMgr()->size();        //  open end)
+  profGbl.fixTraceFiles();
 
   if (args.db_makeMetricDB) {
-    uint mEnd = mBeg + prof->metricMgr()->size(); // open end)
-
     // -------------------------------------------------------
     // compute local incl/excl sampled metrics
     // -------------------------------------------------------
@@ -946,7 +1033,7 @@ makeThreadMetrics_Lcl(Prof::CallPath::Profile& profGbl,
     // -------------------------------------------------------
 
     string dbFnm = makeDBFileName(args.db_dir, groupId, profileFile);
-    writeMetricsDB(profGbl, mBeg, mEnd, dbFnm);
+    writeMetricsDB(profGbl, mBeg, mEnd, dbFnm, args.db_sparseMetricDB);
 
     // -------------------------------------------------------
     // reinitialize metric values for next time
@@ -977,7 +1064,7 @@ makeDBFileName(const string& dbDir, uint groupId, const string& profileFile)
 // [mBegId, mEndId)
 static void
 writeMetricsDB(Prof::CallPath::Profile& profGbl, uint mBegId, uint mEndId,
-	       const string& metricDBFnm)
+	       const string& metricDBFnm, bool isSparse)
 {
   const Prof::CCT::Tree& cct = *(profGbl.cct());
 
@@ -1008,28 +1095,56 @@ writeMetricsDB(Prof::CallPath::Profile& profGbl, uint mBegId, uint mEndId,
   DIAG_MsgIf(0, "writeMetricsDB: " << metricDBFnm);
 
   uint numNodes = packedMetrics.numNodes() - 1;
+  uint numMetrics = mEndId - mBegId; // [mBegId mEndId)
 
   // 1. header
   hpcmetricDB_fmt_hdr_t hdr;
   hdr.numNodes = numNodes;
-  hdr.numMetrics = mEndId - mBegId; // [mBegId mEndId)
+  hdr.numMetrics = numMetrics;
+  hdr.isSparse = isSparse;
+  hdr.numEntries = 0;
+
+  // sparse: node index, i.e., the number of non-zero values before
+  // each node
+  std::vector<uint64_t> nodeIndex;
+  if (isSparse) {
+    nodeIndex.resize(numNodes + 1);
+    nodeIndex[0] = 0;
+    for (uint nodeId = 1; nodeId < numNodes + 1; ++nodeId) {
+      uint64_t numNonZero = 0;
+      for (uint mId1 = 0; mId1 < numMetrics; ++mId1) {
+	if (packedMetrics.idx(nodeId, mId1) != 0.0) {
+	  numNonZero++;
+	}
+      }
+      nodeIndex[nodeId] = nodeIndex[nodeId - 1] + numNonZero;
+    }
+    hdr.numEntries = nodeIndex[numNodes];
+  }
 
   int ret;
   ret = hpcmetricDB_fmt_hdr_fwrite(&hdr, fs);
   if (ret == HPCFMT_ERR) goto badwrite;
 
+  if (isSparse) {
+    ret = hpcmetricDB_fmt_sparse_index_fwrite(&nodeIndex[0], numNodes, fs);
+    if (ret == HPCFMT_ERR) goto badwrite;
+  }
+
   // 2. metric values
   //    - first row corresponds to node 1.
   //    - first column corresponds to first sampled metric.
   // cf. ParallelAnalysis::unpackMetrics: 
 
   for (uint nodeId = 1; nodeId < numNodes + 1; ++nodeId) {
-    for (uint mId1 = 0, mId2 = mBegId; mId2 < mEndId; ++mId1, ++mId2) {
-      double mval = packedMetrics.idx(nodeId, mId1);
-      DIAG_MsgIf(0,  "  " << nodeId << " -> " << mval);
-      ret = hpcfmt_real8_fwrite(mval, fs);
-      if (ret == HPCFMT_ERR) goto badwrite;
+    const double* row = &packedMetrics.idx(nodeId, 0);
+    if (isSparse) {
+      ret = hpcmetricDB_fmt_sparse_row_fwrite(row, numMetrics, fs);
+    }
+    else {
+      ret = hpcmetricDB_fmt_row_fwrite(row, numMetrics, fs);
     }
+    if (ret == HPCFMT_ERR) goto badwrite;
   }
 
   hpcio_fclose(fs);
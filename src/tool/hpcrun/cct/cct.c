@@ -78,6 +78,7 @@
 #include <memory/hpcrun-malloc.h>
 #include <hpcrun/metrics.h>
 #include <messages/messages.h>
+#include <hpcrun/env.h>
 #include <lib/prof-lean/splay-macros.h>
 #include <lib/prof-lean/hpcrun-fmt.h>
 #include <lib/prof-lean/hpcrun-fmt.h>
@@ -114,10 +115,56 @@ struct cct_node_t {
   struct cct_node_t* children;
 
   // left and right pointers for splay tree of siblings
+  // (for hashed sibling sets, the siblings form a list through 'right')
   struct cct_node_t* left;
   struct cct_node_t* right;
+
+  // lookup index over the children list of a hashed sibling set;
+  // NULL while the fan-out is small enough to scan the list
+  struct cct_child_index_t* child_index;
+
+  // ---------------------------------------------------------
+  // metrics: set associated with this node (see cct2metrics.h),
+  // or NULL if none has been associated yet
+  // ---------------------------------------------------------
+  metric_set_t* metrics;
 };
 
+//
+// open-addressing (linear probing) table of the children of a node,
+// used when sibling sets are hashed. a table is never modified in
+// place beyond adding entries: when it fills past half, a new one
+// twice the size is built from the children list, and the old one is
+// retired for reuse by the next index of its size.
+//
+typedef struct cct_child_index_t {
+  uint32_t mask;   // number of slots - 1 (number of slots is a power of 2)
+  uint32_t count;  // number of occupied slots
+  struct cct_child_index_t* next_free; // link while retired
+  cct_node_t* slots[];
+} cct_child_index_t;
+
+// largest fan-out for which a hashed sibling set is searched by a list scan
+#define CCT_CHILD_LIST_MAX 8
+
+// initial number of slots in a child index (> 2 * CCT_CHILD_LIST_MAX)
+#define CCT_CHILD_INDEX_MIN_SLOTS 32
+
+//
+// selects the sibling set representation for all ccts (HPCRUN_CCT_CHILDREN)
+//   false: splay tree of siblings (default)
+//   true:  sibling list, indexed by a hash table once the fan-out grows.
+//          lookups do not restructure anything.
+//
+static bool cct_children_hashed = false;
+
+//
+// thread local free lists of retired child indices, by log2 of the
+// number of slots (hpcrun_malloc'd memory is never freed). freeable
+// memory is reclaimed wholesale, so indices in it are not recycled.
+//
+static __thread cct_child_index_t* child_index_free[32];
+
 //
 // cache of info from most recent splay
 //
@@ -169,6 +216,8 @@ cct_node_create(cct_addr_t* addr, cct_node_t* parent)
   node->children = NULL;
   node->left = NULL;
   node->right = NULL;
+  node->child_index = NULL;
+  node->metrics = NULL;
 
   node->is_leaf = false;
 
@@ -201,6 +250,139 @@ splay(cct_node_t* cct, cct_addr_t* addr)
 #undef l_lt
 #undef l_gt
 
+//
+// ******* HASHED SIBLING SET section ********
+//
+// Children are kept on a list threaded through 'right' (newest first).
+// Small sets are searched by scanning the list; once the fan-out
+// exceeds CCT_CHILD_LIST_MAX, an open-addressing index is built from
+// hpcrun_malloc'd memory. Lookups only read, so a hit on the sampling
+// path writes nothing.
+//
+
+static cct_child_index_t*
+child_index_new(uint32_t nslots)
+{
+  size_t sz = sizeof(cct_child_index_t) + nslots * sizeof(cct_node_t*);
+  cct_child_index_t** free_list = &child_index_free[__builtin_ctz(nslots)];
+  cct_child_index_t* index;
+
+  if (ENABLED(FREEABLE)) {
+    index = hpcrun_malloc_freeable(sz);
+  }
+  else if (*free_list) {
+    index = *free_list;
+    *free_list = index->next_free;
+  }
+  else {
+    index = hpcrun_malloc(sz);
+  }
+  if (! index) return NULL;
+
+  memset(index, 0, sz);
+  index->mask = nslots - 1;
+  return index;
+}
+
+static void
+child_index_add(cct_child_index_t* index, cct_node_t* child)
+{
+  uint32_t i = cct_addr_hash(&(child->addr)) & index->mask;
+  while (index->slots[i]) {
+    i = (i + 1) & index->mask;
+  }
+  index->slots[i] = child;
+  index->count++;
+}
+
+//
+// (re)build the index of parent's children with nslots slots.
+// if memory is exhausted, drop the index: lookups fall back to the list.
+//
+static void
+child_index_build(cct_node_t* parent, uint32_t nslots)
+{
+  cct_child_index_t* old = parent->child_index;
+  cct_child_index_t* index = child_index_new(nslots);
+  if (index) {
+    for (cct_node_t* c = parent->children; c; c = c->right) {
+      child_index_add(index, c);
+    }
+  }
+  parent->child_index = index;
+
+  if (old && ! ENABLED(FREEABLE)) {
+    cct_child_index_t** free_list =
+      &child_index_free[__builtin_ctz(old->mask + 1)];
+    old->next_free = *free_list;
+    *free_list = old;
+  }
+}
+
+//
+// look up addr among the children of parent.
+// if parent has no index and addr is not found, *fanout is set to the
+// number of children scanned.
+//
+static cct_node_t*
+hashed_child_find(cct_node_t* parent, cct_addr_t* addr, uint32_t* fanout)
+{
+  cct_child_index_t* index = parent->child_index;
+
+  if (index) {
+    uint32_t i = cct_addr_hash(addr) & index->mask;
+    for (cct_node_t* c; (c = index->slots[i]); i = (i + 1) & index->mask) {
+      if (cct_addr_eq(addr, &(c->addr))) return c;
+    }
+    return NULL;
+  }
+
+  uint32_t n = 0;
+  for (cct_node_t* c = parent->children; c; c = c->right, n++) {
+    if (cct_addr_eq(addr, &(c->addr))) return c;
+  }
+  if (fanout) *fanout = n;
+  return NULL;
+}
+
+//
+// link child (whose addr is NOT among parent's children) into the
+// sibling set of parent. fanout is the number of children of parent
+// (only consulted when parent has no index).
+//
+static void
+hashed_child_link(cct_node_t* parent, cct_node_t* child, uint32_t fanout)
+{
+  child->left = NULL;
+  child->right = parent->children;
+  parent->children = child;
+
+  cct_child_index_t* index = parent->child_index;
+  if (index) {
+    if (2 * (index->count + 1) > index->mask + 1) {
+      child_index_build(parent, 2 * (index->mask + 1));
+    }
+    else {
+      child_index_add(index, child);
+    }
+  }
+  else if (fanout + 1 > CCT_CHILD_LIST_MAX) {
+    uint32_t nslots = CCT_CHILD_INDEX_MIN_SLOTS;
+    while (nslots < 2 * (fanout + 1)) nslots *= 2;
+    child_index_build(parent, nslots);
+  }
+}
+
+static uint32_t
+hashed_child_count(cct_node_t* parent)
+{
+  if (parent->child_index) return parent->child_index->count;
+
+  uint32_t n = 0;
+  for (cct_node_t* c = parent->children; c; c = c->right) n++;
+  return n;
+}
+
 //
 // helper for walking functions
 // 
@@ -208,25 +390,52 @@ splay(cct_node_t* cct, cct_addr_t* addr)
 //
 // lrs abbreviation for "left-right-self"
 //
+//
+// NOTE: a hashed sibling set is a list threaded through the right
+//       link, so rather than recursing once per right link, the walkers
+//       take up to CCT_WALK_CHUNK nodes of a right chain per call and
+//       visit them last, in reverse: the order is still left-right-self.
+//       As before, a node's right link is read before the node is
+//       visited, so the visit may relink the node into another set.
+//
+#define CCT_WALK_CHUNK 16
+
 static void
 walk_child_lrs(cct_node_t* cct, 
                cct_op_t op, cct_op_arg_t arg, size_t level,
                void (*wf)(cct_node_t* n, cct_op_t o, cct_op_arg_t a, size_t l))
 {
-  if (!cct) return;
+  cct_node_t* chain[CCT_WALK_CHUNK];
+  int n = 0;
 
-  walk_child_lrs(cct->left, op, arg, level, wf);
-  walk_child_lrs(cct->right, op, arg, level, wf);
-  wf(cct, op, arg, level);
+  for (; cct && n < CCT_WALK_CHUNK; cct = cct->right) {
+    walk_child_lrs(cct->left, op, arg, level, wf);
+    chain[n++] = cct;
+  }
+  if (cct) {
+    walk_child_lrs(cct, op, arg, level, wf);
+  }
+  while (n > 0) {
+    wf(chain[--n], op, arg, level);
+  }
 }
 
 static void
 walkset_l(cct_node_t* cct, cct_op_t fn, cct_op_arg_t arg, size_t level)
 {
-  if (! cct) return;
-  walkset_l(cct->left, fn, arg, level);
-  walkset_l(cct->right, fn, arg, level);
-  fn(cct, arg, level);
+  cct_node_t* chain[CCT_WALK_CHUNK];
+  int n = 0;
+
+  for (; cct && n < CCT_WALK_CHUNK; cct = cct->right) {
+    walkset_l(cct->left, fn, arg, level);
+    chain[n++] = cct;
+  }
+  if (cct) {
+    walkset_l(cct, fn, arg, level);
+  }
+  while (n > 0) {
+    fn(chain[--n], arg, level);
+  }
 }
 
 //
@@ -259,7 +468,6 @@ typedef struct {
   FILE* fs;
   epoch_flags_t flags;
   hpcrun_fmt_cct_node_t* tmp_node;
-  cct2metrics_t* cct2metrics_map;
 } write_arg_t;
 
 
@@ -292,7 +500,7 @@ lwrite(cct_node_t* node, cct_op_arg_t arg, size_t level)
   tmp->lm_ip = (hpcfmt_vma_t) (uintptr_t) (addr->ip_norm).lm_ip;
 
   tmp->num_metrics = my_arg->num_metrics;
-  metric_set_t* ms = hpcrun_get_metric_set_specific(&(my_arg->cct2metrics_map), node);
+  metric_set_t* ms = hpcrun_get_metric_set(node);
 
   hpcrun_metric_set_dense_copy(tmp->metrics, ms, my_arg->num_metrics);
   hpcrun_fmt_cct_node_fwrite(tmp, flags, my_arg->fs);
@@ -302,6 +510,33 @@ lwrite(cct_node_t* node, cct_op_arg_t arg, size_t level)
 // ********************* Interface procedures **********************
 //
 
+//
+// ********** Initialization
+//
+
+//
+// select the sibling set representation from HPCRUN_CCT_CHILDREN.
+// must be called before any cct is created.
+//
+void
+hpcrun_cct_children_init(void)
+{
+  cct_children_hashed = false;
+
+  const char* s = getenv(HPCRUN_CCT_CHILDREN);
+  if (s == NULL || strcmp(s, "splay") == 0) {
+    TMSG(CCT, "cct sibling sets: splay");
+  }
+  else if (strcmp(s, "hash") == 0) {
+    cct_children_hashed = true;
+    TMSG(CCT, "cct sibling sets: hash");
+  }
+  else {
+    EMSG("%s: unknown value '%s' (expected 'splay' or 'hash'), using splay",
+         HPCRUN_CCT_CHILDREN, s);
+  }
+}
+
 //
 // ********** Constructors
 //
@@ -361,6 +596,18 @@ hpcrun_cct_is_leaf(cct_node_t* node)
   return node ? (node->is_leaf) || (!(node->children)) : false;
 }
 
+metric_set_t*
+hpcrun_cct_metrics(cct_node_t* node)
+{
+  return node ? node->metrics : NULL;
+}
+
+void
+hpcrun_cct_set_metrics(cct_node_t* node, metric_set_t* metrics)
+{
+  node->metrics = metrics;
+}
+
 //
 // NOTE: having no children is not exactly the same as being a leaf
 //       A leaf represents a full path. There might be full paths
@@ -396,6 +643,17 @@ hpcrun_cct_insert_addr(cct_node_t* node, cct_addr_t* frm)
   if ( ! node)
     return NULL;
 
+  if (cct_children_hashed) {
+    uint32_t fanout = 0;
+    cct_node_t* found = hashed_child_find(node, frm, &fanout);
+    if (found) {
+      return found;
+    }
+    cct_node_t* new = cct_node_create(frm, node);
+    hashed_child_link(node, new, fanout);
+    return new;
+  }
+
   cct_node_t* found    = splay(node->children, frm);
     //
     // !! SPECIAL CASE for cct splay !!
@@ -454,6 +712,11 @@ hpcrun_cct_insert_node(cct_node_t* target, cct_node_t* src)
 {
   src->parent = target;
 
+  if (cct_children_hashed) {
+    hashed_child_link(target, src, hashed_child_count(target));
+    return src;
+  }
+
   cct_node_t* found = splay(target->children, &(src->addr));
   target->children = src;
   if (! found) {
@@ -585,7 +848,7 @@ hpcrun_cct_insert_path(cct_node_t ** root, cct_node_t* path)
 // Writing operation
 //
 int
-hpcrun_cct_fwrite(cct2metrics_t* cct2metrics_map, cct_node_t* cct, FILE* fs, epoch_flags_t flags)
+hpcrun_cct_fwrite(cct_node_t* cct, FILE* fs, epoch_flags_t flags)
 {
   if (!fs) return HPCRUN_ERR;
 
@@ -602,10 +865,6 @@ hpcrun_cct_fwrite(cct2metrics_t* cct2metrics_map, cct_node_t* cct, FILE* fs, epo
     .fs          = fs,
     .flags       = flags,
     .tmp_node    = &tmp_node,
-
-    // multithreaded code: add personalized cct2metrics_map for multithreading programs
-    // this is to allow a thread to write the profile data of another thread.
-    .cct2metrics_map = cct2metrics_map
   };
   
   hpcrun_metricVal_t metrics[num_metrics];
@@ -637,6 +896,10 @@ hpcrun_cct_find_addr(cct_node_t* cct, cct_addr_t* addr)
   if ( ! cct)
     return NULL;
 
+  if (cct_children_hashed) {
+    return hashed_child_find(cct, addr, NULL);
+  }
+
   cct_node_t* found    = splay(cct->children, addr);
     //
     // !! SPECIAL CASE for cct splay !!
@@ -704,6 +967,20 @@ merge_or_join(cct_node_t* n, cct_op_arg_t a, size_t l)
 {
   mjarg_t* the_arg = (mjarg_t*) a;
   cct_node_t* targ = the_arg->targ;
+
+  if (cct_children_hashed) {
+    uint32_t fanout = 0;
+    cct_node_t* found = hashed_child_find(targ, hpcrun_cct_addr(n), &fanout);
+    if (found) {
+      hpcrun_cct_merge(found, n, the_arg->fn, the_arg->arg);
+    }
+    else {
+      n->parent = targ;
+      hashed_child_link(targ, n, fanout);
+    }
+    return;
+  }
+
   if (cct_child_find_cache(targ, hpcrun_cct_addr(n)))
     hpcrun_cct_merge(splay_cache.node, n, the_arg->fn, the_arg->arg);
   else
@@ -116,6 +116,12 @@ typedef cct_node_t* cct_node_id_t;
 // Interface procedures
 //
 
+//
+// Initialization: select the representation of sibling sets
+// (HPCRUN_CCT_CHILDREN = splay | hash). Must precede any cct creation.
+//
+extern void hpcrun_cct_children_init(void);
+
 //
 // Constructors
 //
@@ -131,6 +137,13 @@ extern cct_node_t* hpcrun_cct_parent(cct_node_t* node);
 extern int32_t hpcrun_cct_persistent_id(cct_node_t* node);
 extern cct_addr_t* hpcrun_cct_addr(cct_node_t* node);
 extern bool hpcrun_cct_is_leaf(cct_node_t* node);
+
+//
+// metric set embedded in a node (NULL if none).
+// clients should go through the cct2metrics interface.
+//
+extern metric_set_t* hpcrun_cct_metrics(cct_node_t* node);
+extern void hpcrun_cct_set_metrics(cct_node_t* node, metric_set_t* metrics);
 //
 // NOTE: having no children is not exactly the same as being a leaf
 //       A leaf represents a full path. There might be full paths
@@ -243,14 +256,7 @@ extern void hpcrun_cct_walkset(cct_node_t* cct, cct_op_t fn, cct_op_arg_t arg);
 //
 // Writing operation
 //
-// cct2metrics_t is defined in cct2metrics.h but we cannot include this header
-//  beceause cct2metrics.h includes this file (cct.h)
-//
-// TODO: need to declare cct2metrics_t here to avoid to cyclic inclusion
-typedef struct cct2metrics_t cct2metrics_t;
-
-int hpcrun_cct_fwrite(cct2metrics_t* cct2metrics_map,
-                      cct_node_t* cct, FILE* fs, epoch_flags_t flags);
+int hpcrun_cct_fwrite(cct_node_t* cct, FILE* fs, epoch_flags_t flags);
 //
 // Utilities
 //
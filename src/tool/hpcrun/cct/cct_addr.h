@@ -98,6 +98,20 @@ cct_addr_gt(const cct_addr_t* a, const cct_addr_t* b)
   return cct_addr_lt(b, a);
 }
 
+//
+// hash of the physical component of an address, for hashed cct sibling
+// sets. addresses that compare equal always hash equal.
+//
+
+static inline uint32_t
+cct_addr_hash(const cct_addr_t* a)
+{
+  uint64_t h = ((uint64_t) a->ip_norm.lm_ip)
+    ^ (((uint64_t) a->ip_norm.lm_id) << 48);
+  h *= 0x9e3779b97f4a7c15ULL;
+  return (uint32_t) (h >> 32);
+}
+
 #define assoc_info_NULL {.bits = 0}
 
 #define NON_LUSH_ADDR_INI(id, ip) {.as_info = assoc_info_NULL, .ip_norm = {.lm_id = id, .lm_ip = ip}, .lip = NULL}
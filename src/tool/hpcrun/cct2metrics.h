@@ -10,23 +10,6 @@
 #include <cct/cct.h>
 
 
-//
-// ******** Typedef ********
-//
-//
-typedef struct cct2metrics_t cct2metrics_t;
-//
-// ******** initialization
-//
-// The cct2metrics map gets explicit reference
-// only at initialization time.
-//
-// Thereafter, the interface ops refer to it
-// implicitly.
-// [Singleton pattern for GangOf4 enthusiasts]
-
-extern void hpcrun_cct2metrics_init(cct2metrics_t** map);
-
 // ******** Interface operations **********
 // 
 
@@ -44,8 +27,6 @@ extern metric_set_t* hpcrun_reify_metric_set(cct_node_id_t cct_id);
 //
 extern metric_set_t* hpcrun_get_metric_set(cct_node_id_t cct_id);
 
-extern metric_set_t* hpcrun_get_metric_set_specific(cct2metrics_t **map, cct_node_id_t cct_id);
-
 //
 // check to see if node already has metrics
 //
@@ -53,8 +34,6 @@ extern bool hpcrun_has_metric_set(cct_node_id_t cct_id);
 
 extern void cct2metrics_assoc(cct_node_t* node, metric_set_t* metrics);
 
-//extern cct2metrics_t* cct2metrics_new(cct_node_id_t node, metric_set_t* metrics);
-
 typedef enum {SET, INCR} update_metric_t;
 
 static inline void
@@ -62,11 +41,8 @@ cct_metric_data_update(int metric_id,
 			  cct_node_t* x, update_metric_t type,
 			  cct_metric_data_t incr)
 {
-  if (! hpcrun_has_metric_set(x)) {
-    cct2metrics_assoc(x, hpcrun_metric_set_new());
-  }
-  metric_set_t* set = hpcrun_get_metric_set(x);
-  
+  metric_set_t* set = hpcrun_reify_metric_set(x);
+
   if (type == SET)
     hpcrun_metric_std_set(metric_id, set, incr);
   else if (type == INCR)
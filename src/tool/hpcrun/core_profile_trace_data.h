@@ -19,12 +19,8 @@ typedef struct core_profile_trace_data_t {
   // ----------------------------------------
   epoch_t* epoch;
 
-  //metrics: this is needed otherwise 
-  //hpcprof does not pick them up
-  cct2metrics_t* cct2metrics_map;
-
   // ----------------------------------------
-  // tracing
+  // tracing (in trace clock units; cf. hpcrun_trace_time_us())
   // ----------------------------------------
   uint64_t trace_min_time_us;
   uint64_t trace_max_time_us;
@@ -35,6 +31,7 @@ typedef struct core_profile_trace_data_t {
   FILE* hpcrun_file;
   void* trace_buffer;
   hpcio_outbuf_t trace_outbuf;
+  struct hpctrace_fmt_block_t* trace_block; // NULL => fixed-size records
 
   // ----------------------------------------
   // Perf support
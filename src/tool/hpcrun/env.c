@@ -49,6 +49,13 @@ const char* HPCRUN_OPT_LUSH_AGENTS = "HPCRUN_OPT_LUSH_AGENTS";
 
 const char* HPCRUN_OUT_PATH        = "HPCRUN_OUT_PATH";
 const char* HPCRUN_TRACE           = "HPCRUN_TRACE";
+const char* HPCRUN_TRACE_FORMAT    = "HPCRUN_TRACE_FORMAT";
+const char* HPCRUN_TRACE_FLUSH     = "HPCRUN_TRACE_FLUSH";
+const char* HPCRUN_TRACE_CLOCK     = "HPCRUN_TRACE_CLOCK";
+
+const char* HPCRUN_CCT_CHILDREN    = "HPCRUN_CCT_CHILDREN";
+
+const char* HPCRUN_PROFILE_FORMAT  = "HPCRUN_PROFILE_FORMAT";
 
 const char* PAPI_EVENT_LIST        = "PAPI_EVENT_LIST";
 
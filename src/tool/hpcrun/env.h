@@ -84,6 +84,13 @@ extern const char* HPCRUN_OPT_LUSH_AGENTS;
 extern const char* HPCRUN_OUT_PATH;
 
 extern const char* HPCRUN_TRACE;
+extern const char* HPCRUN_TRACE_FORMAT;
+extern const char* HPCRUN_TRACE_FLUSH;
+extern const char* HPCRUN_TRACE_CLOCK;
+
+extern const char* HPCRUN_CCT_CHILDREN;
+
+extern const char* HPCRUN_PROFILE_FORMAT;
 
 extern const char* HPCRUN_EVENT_LIST;
 extern const char* HPCRUN_MEMSIZE;
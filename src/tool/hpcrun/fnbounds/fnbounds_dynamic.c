@@ -108,6 +108,7 @@
 #include <messages/messages.h>
 
 #include <lib/prof-lean/spinlock.h>
+#include <lib/prof-lean/stdatomic.h>
 
 
 //*********************************************************************
@@ -127,15 +128,29 @@
 
 // locking functions to ensure that dynamic bounds data structures 
 // are consistent.
+//
+// fnbounds_seq makes the lock a seqlock: it is odd while the lock is
+// held (any holder may change the loadmap) and advances on release.
+// fnbounds_enclosing_addr first searches without the lock and keeps
+// the result only if fnbounds_seq was even and unchanged throughout.
+// A racing search may see a dso that was just unmapped, but neither
+// dso_info_t's nor their tables are ever reused or unmapped, and a
+// dso_info_t is fully built before being published (release fence in
+// hpcrun_loadmap_map), so table and nsymbols always belong together;
+// the stale result is simply discarded.
 
 static spinlock_t fnbounds_lock = SPINLOCK_UNLOCKED;
+static atomic_ulong fnbounds_seq = ATOMIC_VAR_INIT(0);
 
 #define FNBOUNDS_LOCK  do {			\
 	spinlock_lock(&fnbounds_lock);		\
 	TD_GET(fnbounds_lock) = 1;		\
+	atomic_fetch_add_explicit(&fnbounds_seq, 1, memory_order_relaxed); \
+	atomic_thread_fence(memory_order_release); \
 } while (0)
 
 #define FNBOUNDS_UNLOCK  do {			\
+	atomic_fetch_add_explicit(&fnbounds_seq, 1, memory_order_release); \
 	spinlock_unlock(&fnbounds_lock);	\
 	TD_GET(fnbounds_lock) = 0;		\
 } while (0)
@@ -154,6 +169,10 @@ fnbounds_compute(const char *filename, void *start, void *end);
 static void
 fnbounds_map_executable();
 
+static bool
+fnbounds_dso_enclosing_addr(dso_info_t* dso, void* ip,
+			    void** start, void** end);
+
 
 //*********************************************************************
 // interface operations
@@ -187,34 +206,45 @@ fnbounds_init()
 bool
 fnbounds_enclosing_addr(void* ip, void** start, void** end, load_module_t** lm)
 {
-  FNBOUNDS_LOCK;
+  void* start_ = NULL;
+  void* end_ = NULL;
 
-  bool ret = false; // failure unless otherwise reset to 0 below
-  
-  load_module_t* lm_ = fnbounds_get_loadModule(ip);
-  dso_info_t* dso = (lm_) ? lm_->dso_info : NULL;
-  
-  if (dso && dso->nsymbols > 0) {
-    void* ip_norm = ip;
-    if (dso->is_relocatable) {
-      ip_norm = (void*) (((unsigned long) ip_norm) - dso->start_to_ref_dist);
+  //
+  // lock-free fast path (see fnbounds_seq). a miss falls through to
+  // the locked path when it may analyze a dso being dlopen'ed.
+  //
+  unsigned long seq = atomic_load_explicit(&fnbounds_seq, memory_order_acquire);
+  if ((seq & 1) == 0) {
+    load_module_t* lm_ = hpcrun_loadmap_findByAddr(ip, ip);
+    dso_info_t* dso = (lm_) ? lm_->dso_info : NULL;
+    atomic_thread_fence(memory_order_acquire); // pairs with hpcrun_loadmap_map
+
+    if (dso || ! (ENABLED(DLOPEN_RISKY) && hpcrun_dlopen_pending() > 0)) {
+      bool ret = dso && fnbounds_dso_enclosing_addr(dso, ip, &start_, &end_);
+
+      atomic_thread_fence(memory_order_acquire);
+      if (atomic_load_explicit(&fnbounds_seq, memory_order_relaxed) == seq) {
+	if (ret) {
+	  *start = start_;
+	  *end = end_;
+	}
+	if (lm) {
+	  *lm = lm_;
+	}
+	return ret;
+      }
     }
+  }
 
-     // no dso table means no enclosing addr
+  FNBOUNDS_LOCK;
 
-    if (dso->table) {
-      // N.B.: works on normalized IPs
-      int rv = fnbounds_table_lookup(dso->table, dso->nsymbols, ip_norm, 
-				     (void**) start, (void**) end);
+  load_module_t* lm_ = fnbounds_get_loadModule(ip);
+  dso_info_t* dso = (lm_) ? lm_->dso_info : NULL;
 
-      ret = (rv == 0);
-      // Convert 'start' and 'end' into unnormalized IPs since they are
-      // currently normalized.
-      if (rv == 0 && dso->is_relocatable) {
-	*start = PERFORM_RELOCATION(*start, dso->start_to_ref_dist);
-	*end   = PERFORM_RELOCATION(*end  , dso->start_to_ref_dist);
-      }
-    }
+  bool ret = dso && fnbounds_dso_enclosing_addr(dso, ip, &start_, &end_);
+  if (ret) {
+    *start = start_;
+    *end = end_;
   }
 
   if (lm) {
@@ -485,6 +515,46 @@ fnbounds_compute(const char* incoming_filename, void* start, void* end)
 }
 
 
+// fnbounds_dso_enclosing_addr(): look up the (unnormalized) IP 'ip'
+// in the function bounds table of 'dso'. On success, return true with
+// the unnormalized bounds of the enclosing function in 'start', 'end'.
+// May be called without fnbounds_lock, in which case the caller must
+// validate the result against fnbounds_seq.
+static bool
+fnbounds_dso_enclosing_addr(dso_info_t* dso, void* ip,
+			    void** start, void** end)
+{
+  // no dso table means no enclosing addr
+  void** table = dso->table;
+  unsigned long nsymbols = dso->nsymbols;
+  if (table == NULL || nsymbols == 0) {
+    return false;
+  }
+
+  uintptr_t start_to_ref_dist = dso->start_to_ref_dist;
+  int is_relocatable = dso->is_relocatable;
+
+  void* ip_norm = ip;
+  if (is_relocatable) {
+    ip_norm = (void*) (((unsigned long) ip_norm) - start_to_ref_dist);
+  }
+
+  // N.B.: works on normalized IPs
+  int rv = fnbounds_table_lookup(table, nsymbols, ip_norm, start, end);
+  if (rv != 0) {
+    return false;
+  }
+
+  // Convert 'start' and 'end' into unnormalized IPs since they are
+  // currently normalized.
+  if (is_relocatable) {
+    *start = PERFORM_RELOCATION(*start, start_to_ref_dist);
+    *end   = PERFORM_RELOCATION(*end  , start_to_ref_dist);
+  }
+  return true;
+}
+
+
 // fnbounds_get_loadModule(): Given the (unnormalized) IP 'ip',
 // attempt to return the enclosing load module.  Note that the
 // function may fail.
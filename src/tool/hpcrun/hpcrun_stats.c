@@ -45,11 +45,20 @@
 // ******************************************************* EndRiceCopyright *
 
 
+//***************************************************************************
+// system include files
+//***************************************************************************
+#include <stddef.h>
+#include <string.h>
+
+
 //***************************************************************************
 // local include files
 //***************************************************************************
 #include "sample_event.h"
 #include "disabled.h"
+#include "hpcrun_stats.h"
+#include "thread_data.h"
 
 #include <memory/hpcrun-malloc.h>
 #include <messages/messages.h>
@@ -79,6 +88,59 @@ static atomic_long trolled = ATOMIC_VAR_INIT(0);
 static atomic_long frames_total = ATOMIC_VAR_INIT(0);
 static atomic_long trolled_frames = ATOMIC_VAR_INIT(0);
 
+static atomic_long trace_buffers_async = ATOMIC_VAR_INIT(0);
+static atomic_long trace_buffers_sync = ATOMIC_VAR_INIT(0);
+
+// the atomics above only collect counts from contexts without thread
+// data; everything else lands in the per-thread blocks on this list.
+static _Atomic(hpcrun_stats_counters_t*) stats_counters_head = ATOMIC_VAR_INIT(NULL);
+
+
+//***************************************************************************
+// private operations
+//***************************************************************************
+
+static inline hpcrun_stats_counters_t*
+stats_local_counters(void)
+{
+  thread_data_t* td = hpcrun_safe_get_td();
+  return td ? &(td->stats) : NULL;
+}
+
+
+static long
+stats_sum(size_t offset, atomic_long* global)
+{
+  long sum = atomic_load_explicit(global, memory_order_relaxed);
+
+  hpcrun_stats_counters_t* c =
+    atomic_load_explicit(&stats_counters_head, memory_order_acquire);
+  for (; c; c = c->next) {
+    sum += atomic_load_explicit((atomic_long*) ((char*) c + offset),
+				memory_order_relaxed);
+  }
+  return sum;
+}
+
+
+//
+// counter 'name' is both a field of hpcrun_stats_counters_t and the
+// process-wide fallback atomic of the same name
+//
+#define stats_inc(name, amt)                                            \
+  do {                                                                  \
+    hpcrun_stats_counters_t* c_ = stats_local_counters();               \
+    if (c_) {                                                           \
+      atomic_fetch_add_explicit(&c_->name, (amt), memory_order_relaxed); \
+    }                                                                   \
+    else {                                                              \
+      atomic_fetch_add_explicit(&name, (amt), memory_order_relaxed);    \
+    }                                                                   \
+  } while (0)
+
+#define stats_read(name)                                                \
+  stats_sum(offsetof(hpcrun_stats_counters_t, name), &name)
+
 //***************************************************************************
 // interface operations
 //***************************************************************************
@@ -97,6 +159,40 @@ hpcrun_stats_reinit(void)
   atomic_store_explicit(&trolled, 0, memory_order_relaxed);
   atomic_store_explicit(&frames_total, 0, memory_order_relaxed);
   atomic_store_explicit(&trolled_frames, 0, memory_order_relaxed);
+  atomic_store_explicit(&trace_buffers_async, 0, memory_order_relaxed);
+  atomic_store_explicit(&trace_buffers_sync, 0, memory_order_relaxed);
+
+  hpcrun_stats_counters_t* c =
+    atomic_load_explicit(&stats_counters_head, memory_order_acquire);
+  for (; c; c = c->next) {
+    hpcrun_stats_counters_t* next = c->next;
+    memset(c, 0, sizeof(*c));
+    c->next = next;
+  }
+}
+
+
+//-----------------------------
+// per-thread counters
+//-----------------------------
+
+void
+hpcrun_stats_thread_init(hpcrun_stats_counters_t* counters, bool is_child)
+{
+  if (is_child) {
+    atomic_store_explicit(&stats_counters_head, NULL, memory_order_relaxed);
+  }
+
+  memset(counters, 0, sizeof(*counters));
+
+  hpcrun_stats_counters_t* head =
+    atomic_load_explicit(&stats_counters_head, memory_order_relaxed);
+  do {
+    counters->next = head;
+  } while (! atomic_compare_exchange_weak_explicit(&stats_counters_head,
+						   &head, counters,
+						   memory_order_release,
+						   memory_order_relaxed));
 }
 
 
@@ -107,14 +203,14 @@ hpcrun_stats_reinit(void)
 void
 hpcrun_stats_num_samples_total_inc(void)
 {
-  atomic_fetch_add_explicit(&num_samples_total, 1L, memory_order_relaxed);
+  stats_inc(num_samples_total, 1L);
 }
 
 
 long
 hpcrun_stats_num_samples_total(void)
 {
-  return atomic_load_explicit(&num_samples_total, memory_order_relaxed);
+  return stats_read(num_samples_total);
 }
 
 
@@ -126,14 +222,14 @@ hpcrun_stats_num_samples_total(void)
 void
 hpcrun_stats_num_samples_attempted_inc(void)
 {
-  atomic_fetch_add_explicit(&num_samples_attempted, 1L, memory_order_relaxed);
+  stats_inc(num_samples_attempted, 1L);
 }
 
 
 long
 hpcrun_stats_num_samples_attempted(void)
 {
-  return atomic_load_explicit(&num_samples_attempted, memory_order_relaxed);
+  return stats_read(num_samples_attempted);
 }
 
 
@@ -147,15 +243,15 @@ hpcrun_stats_num_samples_attempted(void)
 void
 hpcrun_stats_num_samples_blocked_async_inc(void)
 {
-  atomic_fetch_add_explicit(&num_samples_blocked_async, 1L, memory_order_relaxed);
-  atomic_fetch_add_explicit(&num_samples_total, 1L, memory_order_relaxed);
+  stats_inc(num_samples_blocked_async, 1L);
+  stats_inc(num_samples_total, 1L);
 }
 
 
 long
 hpcrun_stats_num_samples_blocked_async(void)
 {
-  return atomic_load_explicit(&num_samples_blocked_async, memory_order_relaxed);
+  return stats_read(num_samples_blocked_async);
 }
 
 
@@ -167,14 +263,14 @@ hpcrun_stats_num_samples_blocked_async(void)
 void
 hpcrun_stats_num_samples_blocked_dlopen_inc(void)
 {
-  atomic_fetch_add_explicit(&num_samples_blocked_dlopen, 1L, memory_order_relaxed);
+  stats_inc(num_samples_blocked_dlopen, 1L);
 }
 
 
 long
 hpcrun_stats_num_samples_blocked_dlopen(void)
 {
-  return atomic_load_explicit(&num_samples_blocked_dlopen, memory_order_relaxed);
+  return stats_read(num_samples_blocked_dlopen);
 }
 
 
@@ -186,13 +282,13 @@ hpcrun_stats_num_samples_blocked_dlopen(void)
 void
 hpcrun_stats_num_samples_dropped_inc(void)
 {
-  atomic_fetch_add_explicit(&num_samples_dropped, 1L, memory_order_relaxed);
+  stats_inc(num_samples_dropped, 1L);
 }
 
 long
 hpcrun_stats_num_samples_dropped(void)
 {
-  return atomic_load_explicit(&num_samples_dropped, memory_order_relaxed);
+  return stats_read(num_samples_dropped);
 }
 
 //----------------------------
@@ -202,13 +298,13 @@ hpcrun_stats_num_samples_dropped(void)
 void
 hpcrun_stats_num_samples_partial_inc(void)
 {
-  atomic_fetch_add_explicit(&num_samples_partial, 1L, memory_order_relaxed);
+  stats_inc(num_samples_partial, 1L);
 }
 
 long
 hpcrun_stats_num_samples_partial(void)
 {
-  return atomic_load_explicit(&num_samples_partial, memory_order_relaxed);
+  return stats_read(num_samples_partial);
 }
 
 //-----------------------------
@@ -218,14 +314,14 @@ hpcrun_stats_num_samples_partial(void)
 void
 hpcrun_stats_num_samples_segv_inc(void)
 {
-  atomic_fetch_add_explicit(&num_samples_segv, 1L, memory_order_relaxed);
+  stats_inc(num_samples_segv, 1L);
 }
 
 
 long
 hpcrun_stats_num_samples_segv(void)
 {
-  return atomic_load_explicit(&num_samples_segv, memory_order_relaxed);
+  return stats_read(num_samples_segv);
 }
 
 
@@ -238,14 +334,14 @@ hpcrun_stats_num_samples_segv(void)
 void
 hpcrun_stats_num_unwind_intervals_total_inc(void)
 {
-  atomic_fetch_add_explicit(&num_unwind_intervals_total, 1L, memory_order_relaxed);
+  stats_inc(num_unwind_intervals_total, 1L);
 }
 
 
 long
 hpcrun_stats_num_unwind_intervals_total(void)
 {
-  return atomic_load_explicit(&num_unwind_intervals_total, memory_order_relaxed);
+  return stats_read(num_unwind_intervals_total);
 }
 
 
@@ -257,14 +353,14 @@ hpcrun_stats_num_unwind_intervals_total(void)
 void
 hpcrun_stats_num_unwind_intervals_suspicious_inc(void)
 {
-  atomic_fetch_add_explicit(&num_unwind_intervals_suspicious, 1L, memory_order_relaxed);
+  stats_inc(num_unwind_intervals_suspicious, 1L);
 }
 
 
 long
 hpcrun_stats_num_unwind_intervals_suspicious(void)
 {
-  return atomic_load_explicit(&num_unwind_intervals_suspicious, memory_order_relaxed);
+  return stats_read(num_unwind_intervals_suspicious);
 }
 
 //------------------------------------------------------
@@ -274,13 +370,13 @@ hpcrun_stats_num_unwind_intervals_suspicious(void)
 void
 hpcrun_stats_trolled_inc(void)
 {
-  atomic_fetch_add_explicit(&trolled, 1L, memory_order_relaxed);
+  stats_inc(trolled, 1L);
 }
 
 long
 hpcrun_stats_trolled(void)
 {
-  return atomic_load_explicit(&trolled, memory_order_relaxed);
+  return stats_read(trolled);
 }
 
 //------------------------------------------------------
@@ -290,13 +386,13 @@ hpcrun_stats_trolled(void)
 void
 hpcrun_stats_frames_total_inc(long amt)
 {
-  atomic_fetch_add_explicit(&frames_total, amt, memory_order_relaxed);
+  stats_inc(frames_total, amt);
 }
 
 long
 hpcrun_stats_frames_total(void)
 {
-  return atomic_load_explicit(&frames_total, memory_order_relaxed);
+  return stats_read(frames_total);
 }
 
 //---------------------------------------------------------------------
@@ -306,13 +402,13 @@ hpcrun_stats_frames_total(void)
 void
 hpcrun_stats_trolled_frames_inc(long amt)
 {
-  atomic_fetch_add_explicit(&trolled_frames, amt, memory_order_relaxed);
+  stats_inc(trolled_frames, amt);
 }
 
 long
 hpcrun_stats_trolled_frames(void)
 {
-  return atomic_load_explicit(&trolled_frames, memory_order_relaxed);
+  return stats_read(trolled_frames);
 }
 
 //----------------------------
@@ -322,13 +418,41 @@ hpcrun_stats_trolled_frames(void)
 void
 hpcrun_stats_num_samples_yielded_inc(void)
 {
-  atomic_fetch_add_explicit(&num_samples_yielded, 1L, memory_order_relaxed);
+  stats_inc(num_samples_yielded, 1L);
 }
 
 long
 hpcrun_stats_num_samples_yielded(void)
 {
-  return atomic_load_explicit(&num_samples_yielded, memory_order_relaxed);
+  return stats_read(num_samples_yielded);
+}
+
+//-----------------------------
+// trace buffers flushed async/sync
+//-----------------------------
+
+void
+hpcrun_stats_trace_buffers_async_inc(long amt)
+{
+  stats_inc(trace_buffers_async, amt);
+}
+
+long
+hpcrun_stats_trace_buffers_async(void)
+{
+  return stats_read(trace_buffers_async);
+}
+
+void
+hpcrun_stats_trace_buffers_sync_inc(long amt)
+{
+  stats_inc(trace_buffers_sync, amt);
+}
+
+long
+hpcrun_stats_trace_buffers_sync(void)
+{
+  return stats_read(trace_buffers_sync);
 }
 
 //-----------------------------
@@ -338,29 +462,41 @@ hpcrun_stats_num_samples_yielded(void)
 void
 hpcrun_stats_print_summary(void)
 {
-  long blocked = atomic_load_explicit(&num_samples_blocked_async, memory_order_relaxed) +
-    atomic_load_explicit(&num_samples_blocked_dlopen, memory_order_relaxed);
-  long errant = atomic_load_explicit(&num_samples_dropped, memory_order_relaxed);
-  long soft = atomic_load_explicit(&num_samples_dropped, memory_order_relaxed) -
-    atomic_load_explicit(&num_samples_segv, memory_order_relaxed);
-  long valid = atomic_load_explicit(&num_samples_attempted, memory_order_relaxed);
+  long blocked_async = hpcrun_stats_num_samples_blocked_async();
+  long blocked_dlopen = hpcrun_stats_num_samples_blocked_dlopen();
+  long segv = hpcrun_stats_num_samples_segv();
+  long attempted = hpcrun_stats_num_samples_attempted();
+
+  long blocked = blocked_async + blocked_dlopen;
+  long errant = hpcrun_stats_num_samples_dropped();
+  long soft = errant - segv;
+  long valid = attempted;
   if (ENABLED(NO_PARTIAL_UNW)) {
-    valid = atomic_load_explicit(&num_samples_attempted, memory_order_relaxed) - errant;
+    valid = attempted - errant;
   }
 
   hpcrun_memory_summary();
 
   AMSG("SAMPLE ANOMALIES: blocks: %ld (async: %ld, dlopen: %ld), "
        "errors: %ld (segv: %ld, soft: %ld)",
-       blocked, num_samples_blocked_async, num_samples_blocked_dlopen,
-       errant, num_samples_segv, soft);
+       blocked, blocked_async, blocked_dlopen,
+       errant, segv, soft);
 
   AMSG("SUMMARY: samples: %ld (recorded: %ld, blocked: %ld, errant: %ld, trolled: %ld, yielded: %ld),\n"
        "         frames: %ld (trolled: %ld)\n"
        "         intervals: %ld (suspicious: %ld)",
-       num_samples_total, valid, blocked, errant, trolled, num_samples_yielded,
-       frames_total, trolled_frames,
-       num_unwind_intervals_total,  num_unwind_intervals_suspicious);
+       hpcrun_stats_num_samples_total(), valid, blocked, errant,
+       hpcrun_stats_trolled(), hpcrun_stats_num_samples_yielded(),
+       hpcrun_stats_frames_total(), hpcrun_stats_trolled_frames(),
+       hpcrun_stats_num_unwind_intervals_total(),
+       hpcrun_stats_num_unwind_intervals_suspicious());
+
+  long trace_async = hpcrun_stats_trace_buffers_async();
+  long trace_sync = hpcrun_stats_trace_buffers_sync();
+  if (trace_async + trace_sync > 0) {
+    AMSG("TRACE BUFFERS: %ld (async: %ld, sync/backpressure: %ld)",
+	 trace_async + trace_sync, trace_async, trace_sync);
+  }
 
   if (hpcrun_get_disabled()) {
     AMSG("SAMPLING HAS BEEN DISABLED");
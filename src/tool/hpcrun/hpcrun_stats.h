@@ -44,6 +44,66 @@
 //
 // ******************************************************* EndRiceCopyright *
 
+#ifndef HPCRUN_STATS_H
+#define HPCRUN_STATS_H
+
+//***************************************************************************
+// system include files
+//***************************************************************************
+
+#include <stdbool.h>
+
+
+//***************************************************************************
+// local include files
+//***************************************************************************
+
+#include <include/gcc-attr.h>
+#include <lib/prof-lean/stdatomic.h>
+
+// used by GCC_ATTR_VAR_CACHE_ALIGN (same value as lush-pthread.i)
+#ifndef HOST_CACHE_LINE_SZ
+#define HOST_CACHE_LINE_SZ 64 /*L1*/
+#endif
+
+
+//***************************************************************************
+// type declarations
+//***************************************************************************
+
+//
+// per-thread counter block, embedded in thread_data_t.
+//
+// each block is written only by its owning thread, so increments
+// are uncontended relaxed atomic adds into a cache line no other
+// thread writes.  (the add is atomic so that a sample signal taken in
+// the middle of an update on the same thread cannot lose either
+// increment.)  blocks are registered on a process-wide list and
+// summed when a statistic is read.
+//
+typedef struct hpcrun_stats_counters_t {
+  atomic_long num_samples_total;
+  atomic_long num_samples_attempted;
+  atomic_long num_samples_blocked_async;
+  atomic_long num_samples_blocked_dlopen;
+  atomic_long num_samples_dropped;
+  atomic_long num_samples_segv;
+  atomic_long num_samples_partial;
+  atomic_long num_samples_yielded;
+
+  atomic_long num_unwind_intervals_total;
+  atomic_long num_unwind_intervals_suspicious;
+
+  atomic_long trolled;
+  atomic_long frames_total;
+  atomic_long trolled_frames;
+
+  atomic_long trace_buffers_async;
+  atomic_long trace_buffers_sync;
+
+  struct hpcrun_stats_counters_t* next;
+} GCC_ATTR_VAR_CACHE_ALIGN hpcrun_stats_counters_t;
+
 
 //***************************************************************************
 // interface operations
@@ -51,6 +111,15 @@
 
 void hpcrun_stats_reinit(void);
 
+//-----------------------------
+// per-thread counters
+//-----------------------------
+
+// zero a thread's counter block and register it for aggregation.
+// in a forked child (is_child), the blocks of the parent's threads
+// are dropped first.
+void hpcrun_stats_thread_init(hpcrun_stats_counters_t* counters, bool is_child);
+
 //-----------------------------
 // samples total 
 //-----------------------------
@@ -137,6 +206,18 @@ void hpcrun_stats_num_unwind_intervals_suspicious_inc(void);
 long hpcrun_stats_num_unwind_intervals_suspicious(void);
 
 
+//-----------------------------
+// trace buffers flushed by the flusher thread (async) and, under
+// backpressure, by the sampling thread itself (sync)
+//-----------------------------
+
+void hpcrun_stats_trace_buffers_async_inc(long amt);
+long hpcrun_stats_trace_buffers_async(void);
+
+void hpcrun_stats_trace_buffers_sync_inc(long amt);
+long hpcrun_stats_trace_buffers_sync(void);
+
+
 //------------------------------------------------------
 // samples that include 1 or more successful troll steps
 //------------------------------------------------------
@@ -163,3 +244,5 @@ long hpcrun_stats_trolled_frames(void);
 //-----------------------------
 
 void hpcrun_stats_print_summary(void);
+
+#endif // HPCRUN_STATS_H
@@ -45,6 +45,7 @@
 // ******************************************************* EndRiceCopyright *
 
 #include <sys/time.h>
+#include <limits.h>
 #include "cct.h"
 #include "loadmap.h"
 #include "fnbounds_interface.h"
@@ -57,6 +58,7 @@
 
 #include <lib/prof-lean/hpcfmt.h>
 #include <lib/prof-lean/spinlock.h>
+#include <lib/prof-lean/stdatomic.h>
 
 #define LOADMAP_DEBUG 0
 
@@ -65,7 +67,76 @@
 static hpcrun_loadmap_t  s_loadmap;
 static hpcrun_loadmap_t* s_loadmap_ptr = NULL;
 
-static dso_info_t* s_dso_free_list = NULL;
+
+//
+// Lookup index: a snapshot of the loadmap sorted for binary search.
+// It is updated whenever the loadmap changes (by the caller that
+// changes it, so updates are serialized as before) and published with
+// a single atomic store; lookups use the current snapshot without
+// taking any lock.
+//
+// An update copies the published snapshot into a spare one, applies
+// the change in place (one sorted insertion or deletion) and publishes
+// the spare; the superseded snapshot is retired.  Snapshots are never
+// freed: a retired one is reused as the spare once no lookup can still
+// be searching it, else a new one is allocated, up to a fixed number
+// of retired snapshots (past that, no index is published for a while).
+// Usually two snapshots alternate, and arrays grow by doubling, so the
+// index takes O(n) memory over any number of map/unmap events.
+//
+// Lookups write only to their own thread's reader slot (its own cache
+// line): on entry, the current update epoch; on exit, 0.  A snapshot
+// retired at epoch E can be in use only by a lookup whose slot holds
+// an epoch below E, so the writer checks the slots instead of waiting
+// for readers.  (It must not wait: the update may run in a signal
+// handler that interrupted a lookup.)
+//
+typedef struct loadmap_range_t {
+  void* start_addr;
+  void* end_addr;
+  load_module_t* lm;
+} loadmap_range_t;
+
+typedef struct loadmap_index_t {
+  struct loadmap_index_t* next_retired;
+  unsigned long retired_epoch; // update epoch after it was superseded
+
+  bool overlapping;         // mapped ranges overlap: fall back to list scan
+
+  size_t num_ranges;
+  size_t cap_ranges;
+  loadmap_range_t* ranges;  // mapped load modules, sorted by start_addr
+
+  size_t num_names;
+  size_t cap_names;
+  load_module_t** names;    // all load modules, sorted by name
+} loadmap_index_t;
+
+// a thread's lookups announce themselves here; threads beyond the
+// number of slots scan the list instead
+typedef struct loadmap_reader_t {
+  atomic_int in_use;   // claimed by a thread
+  atomic_ulong epoch;  // update epoch when the lookup began, 0 if none
+} __attribute__((aligned(64))) loadmap_reader_t;
+
+#define LOADMAP_MAX_READERS 1024
+
+// bound on retired snapshots that lookups may still be searching;
+// when none can be reused, no index is published (lookups scan the
+// list) and a later update rebuilds one from the list
+#define LOADMAP_INDEX_MAX_RETIRED 4
+
+static _Atomic(loadmap_index_t*) s_loadmap_index = ATOMIC_VAR_INIT(NULL);
+static loadmap_index_t* s_loadmap_index_retired = NULL; // newest first
+static size_t s_loadmap_index_num_retired = 0;
+
+static atomic_ulong s_loadmap_epoch = ATOMIC_VAR_INIT(1);
+static loadmap_reader_t s_loadmap_readers[LOADMAP_MAX_READERS];
+static atomic_size_t s_loadmap_num_readers = ATOMIC_VAR_INIT(0);
+
+static __thread loadmap_reader_t* s_reader = NULL;
+static __thread int s_reader_depth = 0;     // nested lookups (signals)
+static __thread bool s_reader_none = false; // no free slot
 
 
 /* locking functions to ensure that loadmaps are consistent */
@@ -110,20 +181,10 @@ hpcrun_loadmap_notify_unmap(void *start, void *end)
 dso_info_t*
 hpcrun_dso_new()
 {
-  dso_info_t* x = NULL;
-
-  if (s_dso_free_list) {
-    x = s_dso_free_list;
-    s_dso_free_list = s_dso_free_list->next;
-    if (s_dso_free_list) {
-      s_dso_free_list->prev = NULL;
-    }
-    x->next = NULL; // prev should already be NULL
-  }
-  else {
-    TMSG(DSO, " hpcrun_dso_new");
-    x = (dso_info_t*) hpcrun_malloc(sizeof(dso_info_t));
-  }
+  // dso_info_t's are not recycled: fnbounds_enclosing_addr() reads
+  // them without a lock, so an unmapped dso must keep its contents.
+  TMSG(DSO, " hpcrun_dso_new");
+  dso_info_t* x = (dso_info_t*) hpcrun_malloc(sizeof(dso_info_t));
 
   return x;
 }
@@ -282,12 +343,380 @@ hpcrun_loadmap_print(hpcrun_loadmap_t* loadmap)
   }
 }
 
+//***************************************************************************
+// lookup index
+//***************************************************************************
+
+// grow '*array' (of element size 'sz') to hold at least 'need' elements
+static bool
+loadmap_index_reserve(void** array, size_t* cap, size_t need, size_t sz)
+{
+  if (need <= *cap) {
+    return true;
+  }
+  size_t new_cap = (*cap == 0) ? 16 : *cap;
+  while (new_cap < need) {
+    new_cap *= 2;
+  }
+  // the old array is not reclaimed (hpcrun_malloc); doubling bounds
+  // the total to twice the final size
+  void* new_array = hpcrun_malloc(new_cap * sz);
+  if (! new_array) {
+    return false;
+  }
+  *array = new_array;
+  *cap = new_cap;
+  return true;
+}
+
+
+// index of the first range starting at or above 'start'
+static size_t
+loadmap_index_range_pos(loadmap_index_t* index, void* start)
+{
+  size_t lo = 0;
+  size_t hi = index->num_ranges;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (index->ranges[mid].start_addr < start) {
+      lo = mid + 1;
+    }
+    else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+
+static void
+loadmap_index_add_name(loadmap_index_t* index, load_module_t* lm)
+{
+  size_t lo = 0;
+  size_t hi = index->num_names;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (strcmp(index->names[mid]->name, lm->name) <= 0) {
+      lo = mid + 1;
+    }
+    else {
+      hi = mid;
+    }
+  }
+  memmove(&index->names[lo + 1], &index->names[lo],
+	  (index->num_names - lo) * sizeof(load_module_t*));
+  index->names[lo] = lm;
+  index->num_names++;
+}
+
+
+static void
+loadmap_index_add_range(loadmap_index_t* index, load_module_t* lm)
+{
+  dso_info_t* dso = lm->dso_info;
+  size_t i = loadmap_index_range_pos(index, dso->start_addr);
+  memmove(&index->ranges[i + 1], &index->ranges[i],
+	  (index->num_ranges - i) * sizeof(loadmap_range_t));
+  index->ranges[i] = (loadmap_range_t)
+    { .start_addr = dso->start_addr, .end_addr = dso->end_addr, .lm = lm };
+  index->num_ranges++;
+}
+
+
+static void
+loadmap_index_del_range(loadmap_index_t* index, load_module_t* lm,
+			void* start)
+{
+  size_t i = loadmap_index_range_pos(index, start);
+  for (; i < index->num_ranges && index->ranges[i].start_addr == start; i++) {
+    if (index->ranges[i].lm == lm) {
+      memmove(&index->ranges[i], &index->ranges[i + 1],
+	      (index->num_ranges - i - 1) * sizeof(loadmap_range_t));
+      index->num_ranges--;
+      break;
+    }
+  }
+}
+
+
+//
+// return a retired snapshot that no lookup can be searching, or NULL
+//
+static loadmap_index_t*
+loadmap_index_reclaim(void)
+{
+  // pairs with the fence in loadmap_index_acquire: a lookup whose slot
+  // still reads 0 here will load a snapshot published before now
+  atomic_thread_fence(memory_order_seq_cst);
+
+  unsigned long min_epoch = ULONG_MAX;
+  size_t num_readers = atomic_load(&s_loadmap_num_readers);
+  for (size_t i = 0; i < num_readers; i++) {
+    unsigned long e = atomic_load(&s_loadmap_readers[i].epoch);
+    if (e != 0 && e < min_epoch) {
+      min_epoch = e;
+    }
+  }
+
+  loadmap_index_t** prev = &s_loadmap_index_retired;
+  for (loadmap_index_t* x = *prev; x; prev = &x->next_retired, x = *prev) {
+    if (x->retired_epoch <= min_epoch) {
+      *prev = x->next_retired;
+      s_loadmap_index_num_retired--;
+      return x;
+    }
+  }
+  return NULL;
+}
+
+
+//
+// return a spare snapshot holding the loadmap before the current
+// change, with room for one more range and name; or, if no snapshot
+// is published, holding the loadmap after the change ('*rebuilt').
+// returns NULL if there is no spare (see LOADMAP_INDEX_MAX_RETIRED)
+// or on allocation failure.
+//
+static loadmap_index_t*
+loadmap_index_begin(bool* rebuilt)
+{
+  loadmap_index_t* cur =
+    atomic_load_explicit(&s_loadmap_index, memory_order_relaxed);
+  loadmap_index_t* next = loadmap_index_reclaim();
+
+  if (! next) {
+    if (s_loadmap_index_num_retired >= LOADMAP_INDEX_MAX_RETIRED) {
+      return NULL;
+    }
+    TMSG(LOADMAP, "index: new snapshot");
+    next = hpcrun_malloc(sizeof(loadmap_index_t));
+    if (! next) {
+      return NULL;
+    }
+    memset(next, 0, sizeof(*next));
+  }
+
+  size_t num_ranges = 0;
+  size_t num_names = 0;
+  if (cur) {
+    num_ranges = cur->num_ranges;
+    num_names = cur->num_names;
+  }
+  else {
+    for (load_module_t* x = s_loadmap_ptr->lm_head; x; x = x->next) {
+      num_names++;
+    }
+    num_ranges = num_names;
+  }
+
+  if (! (loadmap_index_reserve((void**) &next->ranges, &next->cap_ranges,
+			       num_ranges + 1, sizeof(loadmap_range_t))
+	 && loadmap_index_reserve((void**) &next->names, &next->cap_names,
+				  num_names + 1, sizeof(load_module_t*)))) {
+    // keep it for a later update
+    next->retired_epoch = 0;
+    next->next_retired = s_loadmap_index_retired;
+    s_loadmap_index_retired = next;
+    s_loadmap_index_num_retired++;
+    return NULL;
+  }
+
+  *rebuilt = (cur == NULL);
+  if (cur) {
+    memcpy(next->ranges, cur->ranges, num_ranges * sizeof(loadmap_range_t));
+    memcpy(next->names, cur->names, num_names * sizeof(load_module_t*));
+    next->num_ranges = num_ranges;
+    next->num_names = num_names;
+  }
+  else {
+    next->num_ranges = 0;
+    next->num_names = 0;
+    for (load_module_t* x = s_loadmap_ptr->lm_head; x; x = x->next) {
+      loadmap_index_add_name(next, x);
+      if (x->dso_info) {
+	loadmap_index_add_range(next, x);
+      }
+    }
+  }
+
+  return next;
+}
+
+
+// publish 'next' (from loadmap_index_begin, or NULL to make lookups
+// scan the list) and retire the superseded snapshot
+static void
+loadmap_index_publish(loadmap_index_t* next)
+{
+  if (next) {
+    next->overlapping = false;
+    for (size_t i = 1; i < next->num_ranges; i++) {
+      if (next->ranges[i].start_addr < next->ranges[i - 1].end_addr) {
+	next->overlapping = true;
+	break;
+      }
+    }
+    TMSG(LOADMAP, "publish index: %ld mapped, %ld total%s",
+	 (long) next->num_ranges, (long) next->num_names,
+	 next->overlapping ? " (overlapping)" : "");
+  }
+  else {
+    TMSG(LOADMAP, "publish index: none, lookups scan the loadmap");
+  }
+
+  loadmap_index_t* cur =
+    atomic_load_explicit(&s_loadmap_index, memory_order_relaxed);
+  atomic_store(&s_loadmap_index, next);
+  if (cur) {
+    // lookups that begin at this epoch or later cannot see 'cur'
+    cur->retired_epoch = atomic_fetch_add(&s_loadmap_epoch, 1) + 1;
+    cur->next_retired = s_loadmap_index_retired;
+    s_loadmap_index_retired = cur;
+    s_loadmap_index_num_retired++;
+  }
+}
+
+
+//
+// apply one loadmap change to the lookup index and publish it:
+//   add_name:  'lm' was added to the loadmap
+//   del_start: if non-NULL, the range of 'lm' starting there was unmapped
+//   add_range: lm->dso_info was mapped
+//
+static void
+hpcrun_loadmap_index_update(load_module_t* lm, bool add_name, void* del_start,
+			    bool add_range)
+{
+  bool rebuilt = false;
+  loadmap_index_t* index = loadmap_index_begin(&rebuilt);
+
+  if (index && ! rebuilt) {
+    if (add_name) {
+      loadmap_index_add_name(index, lm);
+    }
+    if (del_start) {
+      loadmap_index_del_range(index, lm, del_start);
+    }
+    if (add_range && lm->dso_info) {
+      loadmap_index_add_range(index, lm);
+    }
+  }
+
+  // without a spare, lookups scan the list until an update finds one
+  loadmap_index_publish(index);
+}
+
+
+// claim a reader slot for this thread (NULL if there is none left)
+static loadmap_reader_t*
+loadmap_reader_claim(void)
+{
+  for (size_t i = 0; i < LOADMAP_MAX_READERS; i++) {
+    int expect = 0;
+    if (atomic_load_explicit(&s_loadmap_readers[i].in_use,
+			     memory_order_relaxed) == 0
+	&& atomic_compare_exchange_strong(&s_loadmap_readers[i].in_use,
+					  &expect, 1)) {
+      size_t n = atomic_load(&s_loadmap_num_readers);
+      while (n < i + 1
+	     && ! atomic_compare_exchange_weak(&s_loadmap_num_readers, &n,
+					       i + 1)) {
+      }
+      return &s_loadmap_readers[i];
+    }
+  }
+  return NULL;
+}
+
+
+// end a lookup begun by loadmap_index_acquire
+static inline void
+loadmap_index_release(loadmap_index_t* index)
+{
+  if (--s_reader_depth == 0) {
+    atomic_store_explicit(&s_reader->epoch, 0, memory_order_release);
+  }
+}
+
+
+//
+// begin a lookup: return the published snapshot, or NULL to scan the
+// list (then loadmap_index_release must not be called).  the slot is
+// set before the snapshot is loaded, so the writer either sees the
+// lookup or the lookup sees the newer snapshot.
+//
+static loadmap_index_t*
+loadmap_index_acquire(void)
+{
+  if (s_reader_depth == 0) {
+    if (! s_reader) {
+      if (s_reader_none || ! (s_reader = loadmap_reader_claim())) {
+	s_reader_none = true;
+	return NULL;
+      }
+    }
+    atomic_store_explicit(&s_reader->epoch,
+			  atomic_load(&s_loadmap_epoch), memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+  }
+  s_reader_depth++;
+
+  loadmap_index_t* index = atomic_load(&s_loadmap_index);
+  if (! index) {
+    loadmap_index_release(index);
+  }
+  return index;
+}
+
+
+// give up this thread's reader slot (at thread exit)
+void
+hpcrun_loadmap_thread_fini(void)
+{
+  if (s_reader && s_reader_depth == 0) {
+    atomic_store(&s_reader->in_use, 0);
+    s_reader = NULL;
+  }
+}
+
+
 //***************************************************************************
 
 load_module_t*
 hpcrun_loadmap_findByAddr(void* begin, void* end)
 {
   TMSG(LOADMAP, "find by address %p -- %p", begin, end);
+
+  loadmap_index_t* index = loadmap_index_acquire();
+  if (index && index->overlapping) {
+    loadmap_index_release(index);
+    index = NULL;
+  }
+  if (index) {
+    // find the last range starting at or below 'begin'
+    load_module_t* lm = NULL;
+    size_t lo = 0;
+    size_t hi = index->num_ranges;
+    while (lo < hi) {
+      size_t mid = lo + (hi - lo) / 2;
+      if (index->ranges[mid].start_addr <= begin) {
+	lo = mid + 1;
+      }
+      else {
+	hi = mid;
+      }
+    }
+    if (lo > 0) {
+      loadmap_range_t* r = &index->ranges[lo - 1];
+      if (end <= r->end_addr && r->lm->dso_info) {
+	lm = r->lm;
+      }
+    }
+    loadmap_index_release(index);
+    TMSG(LOADMAP, "       --->%s", lm ? lm->name : "(NOT FOUND)");
+    return lm;
+  }
+
   for (load_module_t* x = s_loadmap_ptr->lm_head; (x); x = x->next) {
     TMSG(LOADMAP, "\tload module %s", x->name);
     if (x->dso_info) {
@@ -314,6 +743,31 @@ load_module_t*
 hpcrun_loadmap_findByName(const char* name)
 {
   TMSG(LOADMAP, "find by name: %s", name);
+
+  loadmap_index_t* index = loadmap_index_acquire();
+  if (index) {
+    load_module_t* lm = NULL;
+    size_t lo = 0;
+    size_t hi = index->num_names;
+    while (lo < hi) {
+      size_t mid = lo + (hi - lo) / 2;
+      int cmp = strcmp(index->names[mid]->name, name);
+      if (cmp == 0) {
+	lm = index->names[mid];
+	break;
+      }
+      if (cmp < 0) {
+	lo = mid + 1;
+      }
+      else {
+	hi = mid;
+      }
+    }
+    loadmap_index_release(index);
+    TMSG(LOADMAP, "       --->%s", lm ? "FOUND" : "(NOT FOUND)");
+    return lm;
+  }
+
   for (load_module_t* x = s_loadmap_ptr->lm_head; (x); x = x->next) {
     if (strcmp(x->name, name) == 0) {
       TMSG(LOADMAP, "       --->FOUND", x->name);
@@ -428,17 +882,21 @@ hpcrun_loadmap_map(dso_info_t* dso)
     if (lm->dso_info != dso) {
       TMSG(LOADMAP, " !! Internal consistency check fires !!");
       hpcrun_loadmap_unmap(lm);
+      atomic_thread_fence(memory_order_release);
       lm->dso_info = dso;
+      hpcrun_loadmap_index_update(lm, false, NULL, true);
     }
     else {
-      EMSG("hpcrun_loadmap_map(): attempt to both map dso '%s' and place it on the free list!", dso->name);
+      EMSG("hpcrun_loadmap_map(): attempt to map dso '%s' twice!", dso->name);
     }
     msg = "(reuse)";
   }
   else {
 	lm = hpcrun_loadModule_new(dso->name);
+	atomic_thread_fence(memory_order_release);
 	lm->dso_info = dso;
 	hpcrun_loadmap_pushFront(lm);
+	hpcrun_loadmap_index_update(lm, true, NULL, true);
 
 #if UW_RECIPE_MAP_DEBUG
         fprintf(stderr, "hpcrun_loadmap_map: '%s' start=%p end=%p\n", 
@@ -471,19 +929,15 @@ hpcrun_loadmap_unmap(load_module_t* lm)
 
   lm->dso_info = NULL;
 
+  hpcrun_loadmap_index_update(lm, false, start_addr, false);
+
   // tallent: For now, do not move the loadmap to the back of the
   //   list.  If we want to enable, this, we could have
   //   hpcrun_loadmap_findByName() begin its search from the end
   //   of the list.
   //hpcrun_loadmap_moveToBack(lm);
 
-  // add old_dso to the head of the s_dso_free_list
-  old_dso->next = s_dso_free_list;
-  old_dso->prev = NULL;
-  if (s_dso_free_list) {
-    s_dso_free_list->prev = old_dso;
-  }
-  s_dso_free_list = old_dso;
+  // old_dso is not reused (see hpcrun_dso_new)
   TMSG(LOADMAP, "Deleting unw intervals");
 
 #if LOADMAP_DEBUG
@@ -505,6 +959,7 @@ hpcrun_loadModule_add(const char* name)
 {
   load_module_t *lm = hpcrun_loadModule_new(name);
   hpcrun_loadmap_pushFront(lm);
+  hpcrun_loadmap_index_update(lm, true, NULL, false);
   return lm->id;
 }
 
@@ -520,8 +975,19 @@ hpcrun_initLoadmap()
 
   s_loadmap_ptr = &s_loadmap;
   hpcrun_loadmap_init(s_loadmap_ptr);
-
-  s_dso_free_list = NULL;
+  atomic_store_explicit(&s_loadmap_index, NULL, memory_order_relaxed);
+  s_loadmap_index_retired = NULL;
+  s_loadmap_index_num_retired = 0;
+
+  // after fork(), only this thread remains: free the other slots
+  for (size_t i = 0; i < LOADMAP_MAX_READERS; i++) {
+    atomic_init(&s_loadmap_readers[i].in_use, 0);
+    atomic_init(&s_loadmap_readers[i].epoch, 0);
+  }
+  atomic_init(&s_loadmap_num_readers, 0);
+  s_reader = NULL;
+  s_reader_depth = 0;
+  s_reader_none = false;
 }
 
 
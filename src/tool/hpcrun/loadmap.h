@@ -80,7 +80,7 @@ typedef struct dso_info_t {
   unsigned long nsymbols;
   int  is_relocatable;
 
-  struct dso_info_t* next; //to only be used with dso_free_list
+  struct dso_info_t* next;
   struct dso_info_t* prev;
 
 } dso_info_t;
@@ -90,9 +90,8 @@ typedef struct dso_info_t {
 // 
 // ---------------------------------------------------------
 
-// Constructs a new dso_info_t by either pulling an unused one from
-// the free list or malloc-ing one.  If there are any on the free
-// list, will return a pointer to it, otherwise will malloc a new one.
+// Constructs a new dso_info_t by malloc-ing one.  dso_info_t's are
+// never reused, since they may be read without a lock after unmapping.
 dso_info_t*
 hpcrun_dso_new();
 
@@ -108,7 +107,7 @@ hpcrun_dso_make(const char* name, void** table,
 // 
 // ---------------------------------------------------------
 
-// Use to dump the free list
+// Use to dump a list of dso's
 void
 hpcrun_dsoList_dump(dso_info_t* dl_list);
 
@@ -235,6 +234,11 @@ hpcrun_loadmap_unmap(load_module_t* lm);
 void
 hpcrun_initLoadmap();
 
+// hpcrun_loadmap_thread_fini: Release the calling thread's slot for
+//   lock-free lookups (it is claimed again by a later lookup).
+void
+hpcrun_loadmap_thread_fini(void);
+
 hpcrun_loadmap_t*
 hpcrun_getLoadmap();
 
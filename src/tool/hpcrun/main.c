@@ -391,6 +391,10 @@ hpcrun_init_internal(bool is_child)
 
   hpcrun_memory_reinit();
   hpcrun_mmap_init();
+
+  // the sibling set representation must be fixed before the first
+  // cct is created (in thread data initialization)
+  hpcrun_cct_children_init();
   hpcrun_thread_data_init(0, NULL, is_child, hpcrun_get_num_sample_sources());
 
   // must initialize unwind recipe map before initializing fnbounds
@@ -411,6 +415,7 @@ hpcrun_init_internal(bool is_child)
   hpcrun_options__getopts(&opts);
 
   hpcrun_trace_init(); // this must go after thread initialization
+  hpcrun_write_data_init();
   hpcrun_trace_open(&(TD_GET(core_profile_trace_data)));
 
   // Decide whether to retain full single recursion, or collapse recursive calls to
@@ -723,6 +728,8 @@ hpcrun_thread_fini(epoch_t *epoch)
 {
   TMSG(FINI,"thread fini");
 
+  hpcrun_loadmap_thread_fini();
+
   // take no action if this thread is suppressed
   if (hpcrun_thread_suppress_sample) return;
 
@@ -93,8 +93,9 @@
 #include <safe-sampling.h>
 #include <sample_event.h>
 #include <monitor-exts/monitor_ext.h>
+#include <memory/mmap.h>
 #include <lib/prof-lean/spinlock.h>
-#include <lib/prof-lean/splay-macros.h>
+#include <lib/prof-lean/stdatomic.h>
 
 // FIXME: the inline getcontext macro is broken on 32-bit x86, so
 // revert to the getcontext syscall for now.
@@ -117,12 +118,22 @@ typedef struct leakinfo_s {
   cct_node_t *context;
   size_t bytes;
   void *memblock;
-  struct leakinfo_s *left;
-  struct leakinfo_s *right;
+  struct leakinfo_s *next;
 } leakinfo_t;
 
 leakinfo_t leakinfo_NULL = { .magic = 0, .context = NULL, .bytes = 0 };
 
+#define MEMLEAK_CACHE_LINE_SZ  64
+
+// one lock-protected part of the allocation table (padded to a cache
+// line, so that shards don't share lines)
+typedef struct memleak_shard_s {
+  spinlock_t lock;
+  size_t num_buckets; // a power of 2, or 0 before the first insert
+  size_t count;
+  struct leakinfo_s **buckets;
+} __attribute__((aligned(MEMLEAK_CACHE_LINE_SZ))) memleak_shard_t;
+
 typedef void *memalign_fcn(size_t, size_t);
 typedef void *valloc_fcn(size_t);
 typedef void *malloc_fcn(size_t);
@@ -140,6 +151,10 @@ typedef void *realloc_fcn(void *, size_t);
 #define MEMLEAK_MAGIC 0x68706374
 #define MEMLEAK_DEFAULT_PAGESIZE  4096
 
+#define MEMLEAK_MIN_SHARDS     16   // powers of 2
+#define MEMLEAK_MAX_SHARDS     256
+#define MEMLEAK_SHARD_MIN_BUCKETS  512
+
 #define HPCRUN_MEMLEAK_PROB  "HPCRUN_MEMLEAK_PROB"
 #define DEFAULT_PROB  0.1
 
@@ -174,8 +189,11 @@ static int leak_detection_init = 0;    // default is uninitialized
 static int use_memleak_prob = 0;
 static float memleak_prob = 0.0;
 
-static struct leakinfo_s *memleak_tree_root = NULL;
-static spinlock_t memtree_lock = SPINLOCK_UNLOCKED;
+static memleak_shard_t memleak_table[MEMLEAK_MAX_SHARDS] = {
+  [0 ... MEMLEAK_MAX_SHARDS - 1] = { .lock = SPINLOCK_UNLOCKED }
+};
+static size_t memleak_num_shards = 0; // set at init
+static atomic_long memleak_num_dropped = ATOMIC_VAR_INIT(0);
 
 static int leakinfo_size = sizeof(struct leakinfo_s);
 static long memleak_pagesize = MEMLEAK_DEFAULT_PAGESIZE;
@@ -193,81 +211,196 @@ static char *loc_name[4] = {
 
 
 /******************************************************************************
- * splay operations
+ * allocation table operations
  *****************************************************************************/
 
+// Footer leakinfo structs are found at free() by the application's
+// address.  They are chained in a hash table that is split into
+// shards, each with its own lock, so that threads allocating and
+// freeing different blocks rarely contend.  The table is sized to
+// the number of processors at initialization; bucket arrays are
+// mmap-ed (we can't use malloc here) and doubled as a shard fills.
 
-static struct leakinfo_s *
-splay(struct leakinfo_s *root, void *key)
+static inline uint64_t
+memleak_hash(void *memblock)
+{
+  uint64_t h = ((uint64_t)(uintptr_t) memblock >> 4) * 0x9e3779b97f4a7c15ULL;
+  return h ^ (h >> 32);
+}
+
+
+static inline memleak_shard_t *
+memleak_shard(uint64_t hash)
 {
-  REGULAR_SPLAY_TREE(leakinfo_s, root, key, memblock, left, right);
-  return root;
+  return &memleak_table[(hash >> 48) & (memleak_num_shards - 1)];
 }
 
 
 static void
-splay_insert(struct leakinfo_s *node)
+memleak_table_init(void)
 {
-  void *memblock = node->memblock;
-
-  node->left = node->right = NULL;
-
-  spinlock_lock(&memtree_lock);  
-  if (memleak_tree_root != NULL) {
-    memleak_tree_root = splay(memleak_tree_root, memblock);
-
-    if (memblock < memleak_tree_root->memblock) {
-      node->left = memleak_tree_root->left;
-      node->right = memleak_tree_root;
-      memleak_tree_root->left = NULL;
-    } else if (memblock > memleak_tree_root->memblock) {
-      node->left = memleak_tree_root;
-      node->right = memleak_tree_root->right;
-      memleak_tree_root->right = NULL;
-    } else {
-      TMSG(MEMLEAK, "memleak splay tree: unable to insert %p (already present)", 
+  long nprocs = sysconf(_SC_NPROCESSORS_ONLN);
+  size_t num_shards = MEMLEAK_MIN_SHARDS;
+
+  while (num_shards < 4 * (size_t) nprocs && num_shards < MEMLEAK_MAX_SHARDS) {
+    num_shards *= 2;
+  }
+  memleak_num_shards = num_shards;
+
+  TMSG(MEMLEAK, "allocation table: %ld shards", (long) num_shards);
+}
+
+
+// Double the shard's bucket array (or allocate the first one).  Call
+// with the shard locked; the lock is dropped around mmap and munmap so
+// that other threads don't spin through the system calls.  If another
+// thread grows the shard meanwhile, our new array is discarded.
+// Returns: 1 if the array was replaced (by us or another thread),
+// else 0 (the shard keeps its old array).
+//
+static int
+memleak_shard_grow(memleak_shard_t *shard)
+{
+  size_t old_size = shard->num_buckets;
+  size_t new_size = (old_size == 0) ? MEMLEAK_SHARD_MIN_BUCKETS : 2 * old_size;
+  size_t new_len = new_size * sizeof(struct leakinfo_s *);
+
+  spinlock_unlock(&shard->lock);
+  struct leakinfo_s **new_buckets = hpcrun_mmap_anon(new_len);
+  spinlock_lock(&shard->lock);
+
+  if (shard->num_buckets != old_size) {
+    if (new_buckets != NULL) {
+      spinlock_unlock(&shard->lock);
+      munmap(new_buckets, new_len);
+      spinlock_lock(&shard->lock);
+    }
+    return 1;
+  }
+  if (new_buckets == NULL) {
+    return 0;
+  }
+
+  struct leakinfo_s **old_buckets = shard->buckets;
+  for (size_t i = 0; i < old_size; i++) {
+    struct leakinfo_s *node = old_buckets[i];
+    while (node != NULL) {
+      struct leakinfo_s *next = node->next;
+      size_t k = memleak_hash(node->memblock) & (new_size - 1);
+      node->next = new_buckets[k];
+      new_buckets[k] = node;
+      node = next;
+    }
+  }
+  shard->buckets = new_buckets;
+  shard->num_buckets = new_size;
+
+  if (old_size != 0) {
+    spinlock_unlock(&shard->lock);
+    munmap(old_buckets, old_size * sizeof(struct leakinfo_s *));
+    spinlock_lock(&shard->lock);
+  }
+
+  return 1;
+}
+
+
+// A block that is not in the table is not credited when freed, so
+// count the inserts we drop and say so once.
+static void
+memleak_table_drop(struct leakinfo_s *node, const char *why)
+{
+  long num = atomic_fetch_add_explicit(&memleak_num_dropped, 1,
+				       memory_order_relaxed) + 1;
+  if (num == 1) {
+    EMSG("memleak table: unable to insert %p (%s), "
+	 "frees of such blocks will not be counted", node->memblock, why);
+  }
+  TMSG(MEMLEAK, "memleak table: unable to insert %p (%s), %ld dropped",
+       node->memblock, why, num);
+}
+
+
+static void
+memleak_table_insert(struct leakinfo_s *node)
+{
+  struct leakinfo_s **prev;
+
+  if (memleak_num_shards == 0) {
+    memleak_table_drop(node, "not initialized");
+    return;
+  }
+
+  uint64_t hash = memleak_hash(node->memblock);
+  memleak_shard_t *shard = memleak_shard(hash);
+
+  spinlock_lock(&shard->lock);
+  if (shard->count >= 2 * shard->num_buckets
+      && ! memleak_shard_grow(shard) && shard->num_buckets == 0) {
+    spinlock_unlock(&shard->lock);
+    memleak_table_drop(node, "no memory");
+    return;
+  }
+
+  prev = &shard->buckets[hash & (shard->num_buckets - 1)];
+  for (struct leakinfo_s *old = *prev; old != NULL;
+       prev = &old->next, old = *prev) {
+    if (old->memblock == node->memblock) {
+      // the block was freed behind our back; replace its stale entry
+      TMSG(MEMLEAK, "memleak table: %p already present, replacing it",
 	   node->memblock);
       assert(0);
+      break;
     }
   }
-  memleak_tree_root = node;
-  spinlock_unlock(&memtree_lock);  
+
+  if (*prev != NULL) {
+    node->next = (*prev)->next;
+    *prev = node;
+  }
+  else {
+    size_t k = hash & (shard->num_buckets - 1);
+    node->next = shard->buckets[k];
+    shard->buckets[k] = node;
+    shard->count++;
+  }
+  spinlock_unlock(&shard->lock);
 }
 
 
 static struct leakinfo_s *
-splay_delete(void *memblock)
+memleak_table_delete(void *memblock)
 {
-  struct leakinfo_s *result = NULL;
+  struct leakinfo_s *node, **prev;
 
-  spinlock_lock(&memtree_lock);  
-  if (memleak_tree_root == NULL) {
-    spinlock_unlock(&memtree_lock);  
-    TMSG(MEMLEAK, "memleak splay tree empty: unable to delete %p", memblock);
+  if (memleak_num_shards == 0) {
     return NULL;
   }
 
-  memleak_tree_root = splay(memleak_tree_root, memblock);
+  uint64_t hash = memleak_hash(memblock);
+  memleak_shard_t *shard = memleak_shard(hash);
 
-  if (memblock != memleak_tree_root->memblock) {
-    spinlock_unlock(&memtree_lock);  
-    TMSG(MEMLEAK, "memleak splay tree: %p not in tree", memblock);
+  spinlock_lock(&shard->lock);
+  if (shard->num_buckets == 0) {
+    spinlock_unlock(&shard->lock);
+    TMSG(MEMLEAK, "memleak table: %p not in table", memblock);
     return NULL;
   }
 
-  result = memleak_tree_root;
-
-  if (memleak_tree_root->left == NULL) {
-    memleak_tree_root = memleak_tree_root->right;
-    spinlock_unlock(&memtree_lock);  
-    return result;
+  prev = &shard->buckets[hash & (shard->num_buckets - 1)];
+  for (node = *prev; node != NULL; prev = &node->next, node = *prev) {
+    if (node->memblock == memblock) {
+      *prev = node->next;
+      shard->count--;
+      break;
+    }
   }
+  spinlock_unlock(&shard->lock);
 
-  memleak_tree_root->left = splay(memleak_tree_root->left, memblock);
-  memleak_tree_root->left->right = memleak_tree_root->right;
-  memleak_tree_root =  memleak_tree_root->left;
-  spinlock_unlock(&memtree_lock);  
-  return result;
+  if (node == NULL) {
+    TMSG(MEMLEAK, "memleak table: %p not in table", memblock);
+  }
+  return node;
 }
 
 
@@ -316,6 +449,8 @@ memleak_initialize(void)
   memleak_pagesize = MEMLEAK_DEFAULT_PAGESIZE;
 #endif
 
+  memleak_table_init();
+
   // If we are sampling the mallocs, then read the probability and
   // seed the random number generator.
   prob_str = getenv(HPCRUN_MEMLEAK_PROB);
@@ -412,7 +547,7 @@ memleak_get_free_loc(void *appl_ptr, void **sys_ptr, leakinfo_t **info_ptr)
 
   // always try footer
   *sys_ptr = appl_ptr;
-  *info_ptr = splay_delete(appl_ptr);
+  *info_ptr = memleak_table_delete(appl_ptr);
   if (*info_ptr == NULL) {
     return MEMLEAK_LOC_NONE;
   }
@@ -435,7 +570,7 @@ memleak_get_free_loc(void *appl_ptr, void **sys_ptr, leakinfo_t **info_ptr)
 }
 
 
-// Fill in the leakinfo struct, add metric to CCT, add to splay tree
+// Fill in the leakinfo struct, add metric to CCT, add to the table
 // (if footer) and print TMSG.
 //
 static void
@@ -455,8 +590,7 @@ memleak_add_leakinfo(const char *name, void *sys_ptr, void *appl_ptr,
   info_ptr->magic = MEMLEAK_MAGIC;
   info_ptr->bytes = bytes;
   info_ptr->memblock = appl_ptr;
-  info_ptr->left = NULL;
-  info_ptr->right = NULL;
+  info_ptr->next = NULL;
   if (hpcrun_memleak_active()) {
     sample_val_t smpl =
       hpcrun_sample_callpath(uc, hpcrun_memleak_alloc_id(), 
@@ -469,7 +603,7 @@ memleak_add_leakinfo(const char *name, void *sys_ptr, void *appl_ptr,
     loc_str = "inactive";
   }
   if (loc == MEMLEAK_LOC_FOOT) {
-    splay_insert(info_ptr);
+    memleak_table_insert(info_ptr);
   }
 
   TMSG(MEMLEAK, "%s: bytes: %ld sys: %p appl: %p info: %p cct: %p (%s)",
@@ -0,0 +1,455 @@
+// -*-Mode: C;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+
+//
+// Standalone microbenchmark of the MEMLEAK allocation table (cf.
+// sample-sources/memleak-overrides.c): the single-lock splay tree it
+// used to be against the sharded hash table it is now.  Each of N
+// threads keeps a window of live blocks and repeatedly deletes and
+// reinserts random slots, so every thread inserts into and deletes
+// from the table concurrently.  No allocation or unwinding is timed.
+//
+//   cc -O2 -std=gnu99 -pthread -I<hpctoolkit>/src -o memleak-bench memleak-bench.c
+//
+// usage: memleak-bench [threads [iterations [live-blocks]]]
+//
+// The sharded table is a copy of the one in memleak-overrides.c (with
+// its messages left out); keep the two in sync.
+//
+
+#define _GNU_SOURCE
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include <lib/prof-lean/spinlock.h>
+#include <lib/prof-lean/splay-macros.h>
+
+#define MAX_THREADS  256
+
+static long iterations = 1000000;
+static long live_blocks = 256;
+
+typedef struct leakinfo_s {
+  void *memblock;
+  struct leakinfo_s *left;  // splay tree
+  struct leakinfo_s *right;
+  struct leakinfo_s *next;  // hash table
+} leakinfo_t;
+
+typedef struct table_s {
+  const char *name;
+  void (*init)(void);
+  void (*insert)(struct leakinfo_s *node);
+  struct leakinfo_s *(*delete)(void *memblock);
+} table_t;
+
+
+
+/******************************************************************************
+ * single-lock splay tree
+ *****************************************************************************/
+
+static struct leakinfo_s *memleak_tree_root = NULL;
+static spinlock_t memtree_lock = SPINLOCK_UNLOCKED;
+
+
+static struct leakinfo_s *
+splay(struct leakinfo_s *root, void *key)
+{
+  REGULAR_SPLAY_TREE(leakinfo_s, root, key, memblock, left, right);
+  return root;
+}
+
+
+static void
+splay_init(void)
+{
+}
+
+
+static void
+splay_insert(struct leakinfo_s *node)
+{
+  void *memblock = node->memblock;
+
+  node->left = node->right = NULL;
+
+  spinlock_lock(&memtree_lock);
+  if (memleak_tree_root != NULL) {
+    memleak_tree_root = splay(memleak_tree_root, memblock);
+
+    if (memblock < memleak_tree_root->memblock) {
+      node->left = memleak_tree_root->left;
+      node->right = memleak_tree_root;
+      memleak_tree_root->left = NULL;
+    } else if (memblock > memleak_tree_root->memblock) {
+      node->left = memleak_tree_root;
+      node->right = memleak_tree_root->right;
+      memleak_tree_root->right = NULL;
+    } else {
+      assert(0);
+    }
+  }
+  memleak_tree_root = node;
+  spinlock_unlock(&memtree_lock);
+}
+
+
+static struct leakinfo_s *
+splay_delete(void *memblock)
+{
+  struct leakinfo_s *result = NULL;
+
+  spinlock_lock(&memtree_lock);
+  if (memleak_tree_root == NULL) {
+    spinlock_unlock(&memtree_lock);
+    return NULL;
+  }
+
+  memleak_tree_root = splay(memleak_tree_root, memblock);
+
+  if (memblock != memleak_tree_root->memblock) {
+    spinlock_unlock(&memtree_lock);
+    return NULL;
+  }
+
+  result = memleak_tree_root;
+
+  if (memleak_tree_root->left == NULL) {
+    memleak_tree_root = memleak_tree_root->right;
+    spinlock_unlock(&memtree_lock);
+    return result;
+  }
+
+  memleak_tree_root->left = splay(memleak_tree_root->left, memblock);
+  memleak_tree_root->left->right = memleak_tree_root->right;
+  memleak_tree_root = memleak_tree_root->left;
+  spinlock_unlock(&memtree_lock);
+  return result;
+}
+
+
+
+/******************************************************************************
+ * sharded hash table (cf. memleak-overrides.c)
+ *****************************************************************************/
+
+#define MEMLEAK_CACHE_LINE_SZ  64
+
+typedef struct memleak_shard_s {
+  spinlock_t lock;
+  size_t num_buckets; // a power of 2, or 0 before the first insert
+  size_t count;
+  struct leakinfo_s **buckets;
+} __attribute__((aligned(MEMLEAK_CACHE_LINE_SZ))) memleak_shard_t;
+
+#define MEMLEAK_MIN_SHARDS     16   // powers of 2
+#define MEMLEAK_MAX_SHARDS     256
+#define MEMLEAK_SHARD_MIN_BUCKETS  512
+
+static memleak_shard_t memleak_table[MEMLEAK_MAX_SHARDS] = {
+  [0 ... MEMLEAK_MAX_SHARDS - 1] = { .lock = SPINLOCK_UNLOCKED }
+};
+static size_t memleak_num_shards = 0; // set at init
+
+
+static void *
+hpcrun_mmap_anon(size_t size)
+{
+  void *addr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+		    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  return (addr == MAP_FAILED) ? NULL : addr;
+}
+
+
+static inline uint64_t
+memleak_hash(void *memblock)
+{
+  uint64_t h = ((uint64_t)(uintptr_t) memblock >> 4) * 0x9e3779b97f4a7c15ULL;
+  return h ^ (h >> 32);
+}
+
+
+static inline memleak_shard_t *
+memleak_shard(uint64_t hash)
+{
+  return &memleak_table[(hash >> 48) & (memleak_num_shards - 1)];
+}
+
+
+static void
+memleak_table_init(void)
+{
+  long nprocs = sysconf(_SC_NPROCESSORS_ONLN);
+  size_t num_shards = MEMLEAK_MIN_SHARDS;
+
+  while (num_shards < 4 * (size_t) nprocs && num_shards < MEMLEAK_MAX_SHARDS) {
+    num_shards *= 2;
+  }
+  memleak_num_shards = num_shards;
+}
+
+
+static int
+memleak_shard_grow(memleak_shard_t *shard)
+{
+  size_t old_size = shard->num_buckets;
+  size_t new_size = (old_size == 0) ? MEMLEAK_SHARD_MIN_BUCKETS : 2 * old_size;
+  size_t new_len = new_size * sizeof(struct leakinfo_s *);
+
+  spinlock_unlock(&shard->lock);
+  struct leakinfo_s **new_buckets = hpcrun_mmap_anon(new_len);
+  spinlock_lock(&shard->lock);
+
+  if (shard->num_buckets != old_size) {
+    if (new_buckets != NULL) {
+      spinlock_unlock(&shard->lock);
+      munmap(new_buckets, new_len);
+      spinlock_lock(&shard->lock);
+    }
+    return 1;
+  }
+  if (new_buckets == NULL) {
+    return 0;
+  }
+
+  struct leakinfo_s **old_buckets = shard->buckets;
+  for (size_t i = 0; i < old_size; i++) {
+    struct leakinfo_s *node = old_buckets[i];
+    while (node != NULL) {
+      struct leakinfo_s *next = node->next;
+      size_t k = memleak_hash(node->memblock) & (new_size - 1);
+      node->next = new_buckets[k];
+      new_buckets[k] = node;
+      node = next;
+    }
+  }
+  shard->buckets = new_buckets;
+  shard->num_buckets = new_size;
+
+  if (old_size != 0) {
+    spinlock_unlock(&shard->lock);
+    munmap(old_buckets, old_size * sizeof(struct leakinfo_s *));
+    spinlock_lock(&shard->lock);
+  }
+
+  return 1;
+}
+
+
+static void
+memleak_table_insert(struct leakinfo_s *node)
+{
+  struct leakinfo_s **prev;
+
+  uint64_t hash = memleak_hash(node->memblock);
+  memleak_shard_t *shard = memleak_shard(hash);
+
+  spinlock_lock(&shard->lock);
+  if (shard->count >= 2 * shard->num_buckets
+      && ! memleak_shard_grow(shard) && shard->num_buckets == 0) {
+    spinlock_unlock(&shard->lock);
+    return;
+  }
+
+  prev = &shard->buckets[hash & (shard->num_buckets - 1)];
+  for (struct leakinfo_s *old = *prev; old != NULL;
+       prev = &old->next, old = *prev) {
+    if (old->memblock == node->memblock) {
+      assert(0);
+      break;
+    }
+  }
+
+  if (*prev != NULL) {
+    node->next = (*prev)->next;
+    *prev = node;
+  }
+  else {
+    size_t k = hash & (shard->num_buckets - 1);
+    node->next = shard->buckets[k];
+    shard->buckets[k] = node;
+    shard->count++;
+  }
+  spinlock_unlock(&shard->lock);
+}
+
+
+static struct leakinfo_s *
+memleak_table_delete(void *memblock)
+{
+  struct leakinfo_s *node, **prev;
+
+  uint64_t hash = memleak_hash(memblock);
+  memleak_shard_t *shard = memleak_shard(hash);
+
+  spinlock_lock(&shard->lock);
+  if (shard->num_buckets == 0) {
+    spinlock_unlock(&shard->lock);
+    return NULL;
+  }
+
+  prev = &shard->buckets[hash & (shard->num_buckets - 1)];
+  for (node = *prev; node != NULL; prev = &node->next, node = *prev) {
+    if (node->memblock == memblock) {
+      *prev = node->next;
+      shard->count--;
+      break;
+    }
+  }
+  spinlock_unlock(&shard->lock);
+
+  return node;
+}
+
+
+
+/******************************************************************************
+ * benchmark
+ *****************************************************************************/
+
+static const table_t tables[] = {
+  { "splay",   splay_init,         splay_insert,         splay_delete },
+  { "sharded", memleak_table_init, memleak_table_insert, memleak_table_delete }
+};
+
+static const table_t *table;
+
+
+static void *
+worker(void *arg)
+{
+  uint32_t seed = (uint32_t)(uintptr_t) arg * 7919 + 1;
+  struct leakinfo_s *nodes = calloc(live_blocks, sizeof(struct leakinfo_s));
+  char *blocks = malloc(live_blocks * 64);
+  char *live = calloc(live_blocks, 1);
+  long i, k;
+
+  if (nodes == NULL || blocks == NULL || live == NULL) {
+    fprintf(stderr, "out of memory\n");
+    exit(1);
+  }
+
+  for (i = 0; i < iterations; i++) {
+    seed = seed * 1103515245 + 12345;
+    k = (seed >> 8) % live_blocks;
+    if (live[k]) {
+      if (table->delete(nodes[k].memblock) != &nodes[k]) {
+	fprintf(stderr, "%s: lost block %p\n", table->name, nodes[k].memblock);
+	exit(1);
+      }
+      live[k] = 0;
+    }
+    else {
+      nodes[k].memblock = blocks + k * 64;
+      table->insert(&nodes[k]);
+      live[k] = 1;
+    }
+  }
+
+  for (k = 0; k < live_blocks; k++) {
+    if (live[k]) {
+      table->delete(nodes[k].memblock);
+    }
+  }
+  free(live);
+  free(blocks);
+  free(nodes);
+  return NULL;
+}
+
+
+int
+main(int argc, char *argv[])
+{
+  pthread_t thread[MAX_THREADS];
+  struct timespec start, end;
+  int num_threads = 4;
+  int i, t;
+
+  if (argc > 1) {
+    num_threads = atoi(argv[1]);
+  }
+  if (argc > 2) {
+    iterations = atol(argv[2]);
+  }
+  if (argc > 3) {
+    live_blocks = atol(argv[3]);
+  }
+  if (num_threads < 1 || num_threads > MAX_THREADS
+      || iterations < 1 || live_blocks < 1) {
+    fprintf(stderr, "usage: %s [threads (1-%d) [iterations [live-blocks]]]\n",
+	    argv[0], MAX_THREADS);
+    return 1;
+  }
+
+  for (t = 0; t < sizeof(tables) / sizeof(tables[0]); t++) {
+    table = &tables[t];
+    table->init();
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < num_threads; i++) {
+      pthread_create(&thread[i], NULL, worker, (void *)(uintptr_t)(i + 1));
+    }
+    for (i = 0; i < num_threads; i++) {
+      pthread_join(thread[i], NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+    printf("%-8s threads: %d  insert/delete ops: %ld  time: %.3f s  rate: %.2f Mops/s\n",
+	   table->name, num_threads, num_threads * iterations, secs,
+	   num_threads * iterations / secs / 1e6);
+  }
+
+  return 0;
+}
@@ -227,11 +227,6 @@ core_profile_trace_data_init(core_profile_trace_data_t * cptd, int id, cct_ctxt_
   cptd->epoch = hpcrun_malloc(sizeof(epoch_t));
   cptd->epoch->csdata_ctxt = copy_thr_ctxt(thr_ctxt);
 
-  // ----------------------------------------
-  // cct2metrics map: associate a metric_set with
-  //                  a cct node
-  hpcrun_cct2metrics_init(&(cptd->cct2metrics_map));
-
   // ----------------------------------------
   // tracing
   // ----------------------------------------
@@ -243,6 +238,7 @@ core_profile_trace_data_init(core_profile_trace_data_t * cptd, int id, cct_ctxt_
   // ----------------------------------------
   cptd->hpcrun_file  = NULL;
   cptd->trace_buffer = NULL;
+  cptd->trace_block  = NULL;
 
   // ----------------------------------------
   // perf event support
@@ -282,6 +278,11 @@ hpcrun_thread_data_init(int id, cct_ctxt_t* thr_ctxt, int is_child, size_t n_sou
   hpcrun_make_memstore(&td->memstore, is_child);
   td->mem_low = 0;
 
+  // ----------------------------------------
+  // statistics counters
+  // ----------------------------------------
+  hpcrun_stats_thread_init(&(td->stats), is_child);
+
   // ----------------------------------------
   // normalized thread id (monitor-generated)
   // ----------------------------------------
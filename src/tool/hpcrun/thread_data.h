@@ -63,6 +63,7 @@
 #include "epoch.h"
 #include "cct2metrics.h"
 #include "core_profile_trace_data.h"
+#include "hpcrun_stats.h"
 
 #include <lush/lush-pthread.i>
 #include <unwind/common/backtrace.h>
@@ -239,6 +240,11 @@ typedef struct thread_data_t {
   // sample or else deadlock on the dlopen lock.
   bool inside_dlfcn;
 
+  // ----------------------------------------
+  // statistics counters (see hpcrun_stats.h)
+  // ----------------------------------------
+  hpcrun_stats_counters_t stats;
+
 #ifdef ENABLE_CUDA
   gpu_data_t gpu_data;
 #endif
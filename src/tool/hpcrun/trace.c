@@ -48,10 +48,23 @@
 // global includes 
 //*********************************************************************
 
+#include <stdbool.h>
 #include <stdio.h>
+#include <time.h>
 #include <sys/time.h>
+#include <sys/types.h>
 #include <assert.h>
 #include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#define TRACE_HAVE_TSC 1
+#endif
 
 
 //*********************************************************************
@@ -63,6 +76,7 @@
 #include "disabled.h"
 #include "env.h"
 #include "files.h"
+#include "hpcrun_stats.h"
 #include "monitor.h"
 #include "rank.h"
 #include "string.h"
@@ -77,12 +91,37 @@
 #include <lib/prof-lean/hpcrun-fmt.h>
 #include <lib/prof-lean/hpcio.h>
 #include <lib/prof-lean/hpcio-buffer.h>
+#include <lib/prof-lean/spinlock.h>
 
 
 //*********************************************************************
 // type declarations
 //*********************************************************************
 
+// a full trace buffer on its way to the flusher thread
+typedef struct trace_flush_req_t {
+  volatile size_t seq; // cf. trace_flush_enqueue()
+  hpcio_outbuf_t *outbuf;
+  void   *buf;
+  size_t len;
+  off_t  offset;
+} trace_flush_req_t;
+
+// bounded queue of flush requests (a power of 2).  each trace outbuf
+// has at most one buffer in flight, so this only fills with many
+// threads flushing at once.
+#define TRACE_FLUSH_QUEUE_SZ 256
+
+// the clock that timestamps trace records (HPCRUN_TRACE_CLOCK)
+typedef enum {
+  TRACE_CLOCK_GETTIMEOFDAY, // microseconds
+  TRACE_CLOCK_MONOTONIC_RAW, // nanoseconds, not slewed by NTP
+  TRACE_CLOCK_TSC // invariant time stamp counter ticks
+} trace_clock_t;
+
+// length of the TSC calibration interval
+#define TRACE_CLOCK_CALIBRATE_NS (10 * 1000 * 1000)
+
 
 
 //*********************************************************************
@@ -90,6 +129,9 @@
 //*********************************************************************
 
 static void hpcrun_trace_file_validate(int valid, char *op);
+static void trace_clock_init(void);
+static bool trace_flusher_start(void);
+static int trace_flush_submit(hpcio_outbuf_t *outbuf, void *buf, size_t len, off_t offset);
 static inline void hpcrun_trace_append_with_time_real(core_profile_trace_data_t *cptd, unsigned int call_path_id, uint metric_id, uint64_t microtime);
 
 
@@ -99,6 +141,120 @@ static inline void hpcrun_trace_append_with_time_real(core_profile_trace_data_t
 
 static int tracing = 0;
 
+// write trace records in the compact (delta-encoded block) format
+// (HPCRUN_TRACE_FORMAT).  Off by default: readers built before the
+// compact format do not check the trace version and would misread it.
+static bool trace_compact = false;
+
+// hand full trace buffers to a per-process flusher thread rather than
+// write() them from the sampling path (HPCRUN_TRACE_FLUSH)
+static bool trace_flush_async = true;
+
+static trace_flush_req_t trace_flush_queue[TRACE_FLUSH_QUEUE_SZ];
+static volatile size_t trace_flush_enq_pos;
+static volatile size_t trace_flush_deq_pos;
+static sem_t trace_flush_sem;
+
+// the process that started the flusher thread (a forked child must
+// start its own)
+static pid_t trace_flusher_pid = 0;
+static spinlock_t trace_flusher_lock = SPINLOCK_UNLOCKED;
+
+// with a raw clock, record times are clock ticks and trace headers
+// carry trace_clock_calib to map them to wall-clock time
+static trace_clock_t trace_clock = TRACE_CLOCK_GETTIMEOFDAY;
+static hpctrace_fmt_clock_t trace_clock_calib;
+
+
+//*********************************************************************
+// clock support
+//*********************************************************************
+
+static inline uint64_t
+trace_clock_ns(clockid_t id)
+{
+  struct timespec ts;
+  clock_gettime(id, &ts);
+  return ((uint64_t)ts.tv_sec) * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+
+#ifdef TRACE_HAVE_TSC
+static inline uint64_t
+trace_clock_rdtsc(void)
+{
+  uint32_t lo, hi;
+  __asm__ __volatile__ ("rdtsc" : "=a" (lo), "=d" (hi));
+  return ((uint64_t)hi << 32) | lo;
+}
+
+
+static bool
+trace_clock_tsc_invariant(void)
+{
+  unsigned int eax, ebx, ecx, edx;
+  if (__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) == 0) {
+    return false;
+  }
+  return (edx & (1u << 8)) != 0;
+}
+
+
+// reads 'id' and the TSC at (nearly) the same instant
+static void
+trace_clock_tsc_pair(clockid_t id, uint64_t *tsc, uint64_t *ns)
+{
+  uint64_t best = UINT64_MAX;
+  for (int i = 0; i < 5; i++) {
+    uint64_t t0 = trace_clock_rdtsc();
+    uint64_t n  = trace_clock_ns(id);
+    uint64_t t1 = trace_clock_rdtsc();
+    if (t1 - t0 < best) {
+      best = t1 - t0;
+      *tsc = t0 + (t1 - t0) / 2;
+      *ns  = n;
+    }
+  }
+}
+#endif
+
+
+// reads the trace clock: a single rdtsc or vDSO clock_gettime()
+// rather than gettimeofday() for the raw clocks
+static inline uint64_t
+trace_clock_read(void)
+{
+  switch (trace_clock) {
+#ifdef TRACE_HAVE_TSC
+  case TRACE_CLOCK_TSC:
+    return trace_clock_rdtsc();
+#endif
+  case TRACE_CLOCK_MONOTONIC_RAW:
+    return trace_clock_ns(CLOCK_MONOTONIC_RAW);
+  default:
+    {
+      struct timeval tv;
+      int ret = gettimeofday(&tv, NULL);
+      assert(ret == 0 && "in trace_append: gettimeofday failed!");
+      return ((uint64_t)tv.tv_usec + (((uint64_t)tv.tv_sec) * 1000000));
+    }
+  }
+}
+
+
+// converts wall-clock microseconds to trace clock time
+static inline uint64_t
+trace_clock_from_us(uint64_t microtime)
+{
+  if (trace_clock == TRACE_CLOCK_GETTIMEOFDAY) {
+    return microtime;
+  }
+  const hpctrace_fmt_clock_t *clk = &trace_clock_calib;
+  double dticks = (double)(int64_t)(microtime * 1000 - clk->nsBase)
+    / clk->nsPerTick;
+  return clk->tickBase + (int64_t)dticks;
+}
+
 //*********************************************************************
 // interface operations
 //*********************************************************************
@@ -117,6 +273,63 @@ hpcrun_trace_init()
       tracing = 1;
       TMSG(TRACE, "Tracing is ON");
   }
+
+  char* fmt = getenv(HPCRUN_TRACE_FORMAT);
+  if (fmt != NULL) {
+    if (strcmp(fmt, "compact") == 0) {
+      trace_compact = true;
+    }
+    else if (strcmp(fmt, "fixed") != 0) {
+      EMSG("%s: unknown trace format '%s', using 'fixed'",
+	   HPCRUN_TRACE_FORMAT, fmt);
+    }
+  }
+  TMSG(TRACE, "Trace format: %s", (trace_compact) ? "compact" : "fixed");
+
+  char* flush = getenv(HPCRUN_TRACE_FLUSH);
+  if (flush != NULL) {
+    if (strcmp(flush, "sync") == 0) {
+      trace_flush_async = false;
+    }
+    else if (strcmp(flush, "async") != 0) {
+      EMSG("%s: unknown trace flush mode '%s', using 'async'",
+	   HPCRUN_TRACE_FLUSH, flush);
+    }
+  }
+  TMSG(TRACE, "Trace flush: %s", (trace_flush_async) ? "async" : "sync");
+
+  char* clock = getenv(HPCRUN_TRACE_CLOCK);
+  if (clock != NULL) {
+    if (strcmp(clock, "tsc") == 0) {
+      trace_clock = TRACE_CLOCK_TSC;
+    }
+    else if (strcmp(clock, "monotonic-raw") == 0) {
+      trace_clock = TRACE_CLOCK_MONOTONIC_RAW;
+    }
+    else if (strcmp(clock, "gettimeofday") != 0) {
+      EMSG("%s: unknown trace clock '%s', using 'gettimeofday'",
+	   HPCRUN_TRACE_CLOCK, clock);
+    }
+  }
+  if (tracing) {
+    trace_clock_init();
+  }
+}
+
+
+// Converts a trace time (e.g., cptd->trace_min_time_us) to wall-clock
+// microseconds.
+uint64_t
+hpcrun_trace_time_us(uint64_t time)
+{
+  if (trace_clock == TRACE_CLOCK_GETTIMEOFDAY || time == 0) {
+    return time;
+  }
+  hpctrace_fmt_hdr_t hdr;
+  hdr.flags = hpctrace_hdr_flags_NULL;
+  hdr.flags.fields.isRawClock = true;
+  hdr.clock = trace_clock_calib;
+  return hpctrace_fmt_time_us(&hdr, time);
 }
 
 
@@ -142,8 +355,20 @@ hpcrun_trace_open(core_profile_trace_data_t * cptd)
     fd = hpcrun_open_trace_file(cptd->id);
     hpcrun_trace_file_validate(fd >= 0, "open");
     cptd->trace_buffer = hpcrun_malloc(HPCRUN_TraceBufferSz);
-    ret = hpcio_outbuf_attach(&cptd->trace_outbuf, fd, cptd->trace_buffer,
-			      HPCRUN_TraceBufferSz, HPCIO_OUTBUF_UNLOCKED);
+
+    if (trace_flush_async && trace_flusher_start()) {
+      void* spare = hpcrun_malloc(HPCRUN_TraceBufferSz);
+      hpcrun_trace_file_validate(spare != NULL, "open");
+      ret = hpcio_outbuf_attach_async(&cptd->trace_outbuf, fd,
+				      cptd->trace_buffer, spare,
+				      HPCRUN_TraceBufferSz,
+				      HPCIO_OUTBUF_UNLOCKED,
+				      trace_flush_submit);
+    }
+    else {
+      ret = hpcio_outbuf_attach(&cptd->trace_outbuf, fd, cptd->trace_buffer,
+				HPCRUN_TraceBufferSz, HPCIO_OUTBUF_UNLOCKED);
+    }
     hpcrun_trace_file_validate(ret == HPCFMT_OK, "open");
 
     hpctrace_hdr_flags_t flags = hpctrace_hdr_flags_NULL;
@@ -153,7 +378,20 @@ hpcrun_trace_open(core_profile_trace_data_t * cptd)
     flags.fields.isDataCentric = false;
 #endif
 
+    cptd->trace_block = NULL;
+    if (trace_compact) {
+      cptd->trace_block = hpcrun_malloc(sizeof(hpctrace_fmt_block_t));
+      hpcrun_trace_file_validate(cptd->trace_block != NULL, "open");
+      hpctrace_fmt_block_init(cptd->trace_block);
+      flags.fields.isCompact = true;
+    }
+
+    flags.fields.isRawClock = (trace_clock != TRACE_CLOCK_GETTIMEOFDAY);
+
     ret = hpctrace_fmt_hdr_outbuf(flags, &cptd->trace_outbuf);
+    if (ret == HPCFMT_OK && flags.fields.isRawClock) {
+      ret = hpctrace_fmt_clock_outbuf(&trace_clock_calib, &cptd->trace_outbuf);
+    }
     hpcrun_trace_file_validate(ret == HPCFMT_OK, "write header to");
   }
   TMSG(TRACE, "Trace open done");
@@ -164,7 +402,8 @@ void
 hpcrun_trace_append_with_time(core_profile_trace_data_t *st, unsigned int call_path_id, uint metric_id, uint64_t microtime)
 {
 	if (tracing && hpcrun_sample_prob_active()) {
-        hpcrun_trace_append_with_time_real(st, call_path_id, metric_id, microtime);
+        hpcrun_trace_append_with_time_real(st, call_path_id, metric_id,
+					   trace_clock_from_us(microtime));
 	}
 }
 
@@ -173,11 +412,7 @@ void
 hpcrun_trace_append(core_profile_trace_data_t *cptd, cct_node_t* node, uint metric_id)
 {
   if (tracing && hpcrun_sample_prob_active()) {
-    struct timeval tv;
-    int ret = gettimeofday(&tv, NULL);
-    assert(ret == 0 && "in trace_append: gettimeofday failed!");
-    uint64_t microtime = ((uint64_t)tv.tv_usec
-			  + (((uint64_t)tv.tv_sec) * 1000000));
+    uint64_t time = trace_clock_read();
 
     // mark the leaf of a call path recorded in a trace record for retention
     // so that the call path associated with the trace record can be recovered.
@@ -185,7 +420,7 @@ hpcrun_trace_append(core_profile_trace_data_t *cptd, cct_node_t* node, uint metr
 
     int32_t call_path_id = hpcrun_cct_persistent_id(node);
 
-    hpcrun_trace_append_with_time_real(cptd, call_path_id, metric_id, microtime);
+    hpcrun_trace_append_with_time_real(cptd, call_path_id, metric_id, time);
   }
 }
 
@@ -198,6 +433,19 @@ hpcrun_trace_close(core_profile_trace_data_t * cptd)
   if (tracing && hpcrun_sample_prob_active()) {
 
     TMSG(TRACE, "Trace active close code");
+    if (cptd->trace_block != NULL) {
+      int ret = hpctrace_fmt_block_outbuf(cptd->trace_block,
+					  &cptd->trace_outbuf);
+      if (ret != HPCFMT_OK) {
+	EMSG("unable to write final trace block");
+      }
+    }
+
+    long num_async, num_sync;
+    hpcio_outbuf_async_counts(&cptd->trace_outbuf, &num_async, &num_sync);
+    hpcrun_stats_trace_buffers_async_inc(num_async);
+    hpcrun_stats_trace_buffers_sync_inc(num_sync);
+
     int ret = hpcio_outbuf_close(&cptd->trace_outbuf);
     if (ret != HPCFMT_OK) {
       EMSG("unable to flush and close trace file");
@@ -215,6 +463,67 @@ hpcrun_trace_close(core_profile_trace_data_t * cptd)
 // private operations
 //*********************************************************************
 
+// Chooses the fallback for an unavailable clock and computes the
+// calibration written into the trace headers.  The TSC is timed
+// against CLOCK_MONOTONIC_RAW (which NTP does not slew) over a short
+// interval; CLOCK_MONOTONIC_RAW itself only needs its offset from
+// wall-clock time.
+static void
+trace_clock_init(void)
+{
+#ifdef TRACE_HAVE_TSC
+  if (trace_clock == TRACE_CLOCK_TSC && !trace_clock_tsc_invariant()) {
+    EMSG("%s: the TSC is not invariant on this processor, using "
+	 "'monotonic-raw'", HPCRUN_TRACE_CLOCK);
+    trace_clock = TRACE_CLOCK_MONOTONIC_RAW;
+  }
+#else
+  if (trace_clock == TRACE_CLOCK_TSC) {
+    EMSG("%s: no TSC on this processor, using 'monotonic-raw'",
+	 HPCRUN_TRACE_CLOCK);
+    trace_clock = TRACE_CLOCK_MONOTONIC_RAW;
+  }
+#endif
+
+  hpctrace_fmt_clock_t *clk = &trace_clock_calib;
+
+  switch (trace_clock) {
+#ifdef TRACE_HAVE_TSC
+  case TRACE_CLOCK_TSC:
+    {
+      uint64_t tsc0, ns0, tsc1, ns1;
+      trace_clock_tsc_pair(CLOCK_MONOTONIC_RAW, &tsc0, &ns0);
+      do {
+	sched_yield();
+	trace_clock_tsc_pair(CLOCK_MONOTONIC_RAW, &tsc1, &ns1);
+      } while (ns1 - ns0 < TRACE_CLOCK_CALIBRATE_NS || tsc1 == tsc0);
+
+      clk->nsPerTick = (double)(ns1 - ns0) / (double)(tsc1 - tsc0);
+      trace_clock_tsc_pair(CLOCK_REALTIME, &clk->tickBase, &clk->nsBase);
+      break;
+    }
+#endif
+  case TRACE_CLOCK_MONOTONIC_RAW:
+    {
+      uint64_t m0 = trace_clock_ns(CLOCK_MONOTONIC_RAW);
+      uint64_t rt = trace_clock_ns(CLOCK_REALTIME);
+      uint64_t m1 = trace_clock_ns(CLOCK_MONOTONIC_RAW);
+      clk->tickBase  = m0 + (m1 - m0) / 2;
+      clk->nsBase    = rt;
+      clk->nsPerTick = 1.0;
+      break;
+    }
+  default:
+    break;
+  }
+
+  TMSG(TRACE, "Trace clock: %s (%.6f ns/tick)",
+       (trace_clock == TRACE_CLOCK_TSC) ? "tsc" :
+       (trace_clock == TRACE_CLOCK_MONOTONIC_RAW) ? "monotonic-raw" :
+       "gettimeofday", clk->nsPerTick);
+}
+
+
 static inline void hpcrun_trace_append_with_time_real(core_profile_trace_data_t *cptd, unsigned int call_path_id, uint metric_id, uint64_t microtime)
 {
     if (cptd->trace_min_time_us == 0) {
@@ -239,11 +548,174 @@ static inline void hpcrun_trace_append_with_time_real(core_profile_trace_data_t
     flags.fields.isDataCentric = false;
 #endif
     
-    int ret = hpctrace_fmt_datum_outbuf(&trace_datum, flags, &cptd->trace_outbuf);
+    int ret;
+    if (cptd->trace_block != NULL) {
+      ret = hpctrace_fmt_datum_block_outbuf(&trace_datum, flags,
+					    cptd->trace_block,
+					    &cptd->trace_outbuf);
+    }
+    else {
+      ret = hpctrace_fmt_datum_outbuf(&trace_datum, flags, &cptd->trace_outbuf);
+    }
     hpcrun_trace_file_validate(ret == HPCFMT_OK, "append");
 }
 
 
+//---------------------------------------------------------------------
+// flusher thread: writes full trace buffers handed over by
+// trace_flush_submit() (possibly from signal handlers), so that
+// samples never wait on the file system.
+//
+// the queue is a bounded MPSC ring (after Vyukov): each slot's 'seq'
+// says whether it is free for the producer at position 'seq' or
+// holds the request for the consumer at position 'seq - 1'.
+// producers never lock or wait; a full queue makes the sampling
+// thread write its buffer itself (counted as backpressure).
+//---------------------------------------------------------------------
+
+static bool
+trace_flush_enqueue(hpcio_outbuf_t *outbuf, void *buf, size_t len,
+		    off_t offset)
+{
+  size_t pos = trace_flush_enq_pos;
+  for (;;) {
+    trace_flush_req_t *req =
+      &trace_flush_queue[pos & (TRACE_FLUSH_QUEUE_SZ - 1)];
+    size_t seq = req->seq;
+    __sync_synchronize();
+    intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+
+    if (dif == 0) {
+      if (__sync_bool_compare_and_swap(&trace_flush_enq_pos, pos, pos + 1)) {
+	req->outbuf = outbuf;
+	req->buf    = buf;
+	req->len    = len;
+	req->offset = offset;
+	__sync_synchronize();
+	req->seq = pos + 1;
+	return true;
+      }
+    }
+    else if (dif < 0) {
+      return false; // full
+    }
+    pos = trace_flush_enq_pos;
+  }
+}
+
+
+// single consumer: the flusher thread
+static bool
+trace_flush_dequeue(trace_flush_req_t *out)
+{
+  size_t pos = trace_flush_deq_pos;
+  trace_flush_req_t *req =
+    &trace_flush_queue[pos & (TRACE_FLUSH_QUEUE_SZ - 1)];
+  if (req->seq != pos + 1) {
+    return false; // empty, or not yet filled in
+  }
+  __sync_synchronize();
+
+  *out = *req;
+  __sync_synchronize();
+  req->seq = pos + TRACE_FLUSH_QUEUE_SZ;
+  trace_flush_deq_pos = pos + 1;
+  return true;
+}
+
+
+static int
+trace_flush_submit(hpcio_outbuf_t *outbuf, void *buf, size_t len,
+		   off_t offset)
+{
+  if (! trace_flush_enqueue(outbuf, buf, len, offset)) {
+    return HPCFMT_ERR;
+  }
+  sem_post(&trace_flush_sem); // async-signal-safe
+  return HPCFMT_OK;
+}
+
+
+static void*
+trace_flusher_main(void *arg)
+{
+  // samples are for application threads
+  sigset_t mask;
+  sigfillset(&mask);
+  pthread_sigmask(SIG_BLOCK, &mask, NULL);
+
+  for (;;) {
+    if (sem_wait(&trace_flush_sem) != 0) {
+      continue; // EINTR
+    }
+
+    // a request is posted only after it is filled in, but an earlier
+    // slot may still be in the middle of being filled
+    trace_flush_req_t req;
+    while (! trace_flush_dequeue(&req)) {
+      sched_yield();
+    }
+
+    if (hpcio_outbuf_async_write(req.outbuf, req.buf, req.len, req.offset)
+	!= HPCFMT_OK) {
+      EMSG("unable to write trace buffer");
+    }
+  }
+  return NULL;
+}
+
+
+// start the flusher thread for this process, if not yet started.  on
+// failure, fall back to synchronous flushing and return false.
+static bool
+trace_flusher_start(void)
+{
+  pid_t pid = getpid();
+
+  spinlock_lock(&trace_flusher_lock);
+  if (trace_flusher_pid == pid || ! trace_flush_async) {
+    spinlock_unlock(&trace_flusher_lock);
+    return trace_flush_async;
+  }
+
+  trace_flush_enq_pos = 0;
+  trace_flush_deq_pos = 0;
+  for (size_t i = 0; i < TRACE_FLUSH_QUEUE_SZ; i++) {
+    trace_flush_queue[i].seq = i;
+  }
+  if (sem_init(&trace_flush_sem, 0, 0) != 0) {
+    EMSG("unable to create trace flusher semaphore: using sync flush");
+    trace_flush_async = false;
+    spinlock_unlock(&trace_flusher_lock);
+    return false;
+  }
+
+  pthread_t thread;
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+  // the flusher is hpcrun's own thread, not the application's
+  monitor_disable_new_threads();
+  int rc = pthread_create(&thread, &attr, trace_flusher_main, NULL);
+  monitor_enable_new_threads();
+  pthread_attr_destroy(&attr);
+
+  if (rc != 0) {
+    EMSG("unable to create trace flusher thread (%d): using sync flush", rc);
+    trace_flush_async = false;
+    spinlock_unlock(&trace_flusher_lock);
+    return false;
+  }
+
+  trace_flusher_pid = pid;
+  spinlock_unlock(&trace_flusher_lock);
+
+  TMSG(TRACE, "Trace flusher thread started");
+  return true;
+}
+
+
 static void
 hpcrun_trace_file_validate(int valid, char *op)
 {
@@ -57,6 +57,7 @@ void hpcrun_trace_open(core_profile_trace_data_t * cptd);
 void hpcrun_trace_append(core_profile_trace_data_t *cptd, cct_node_t* node, uint metric_id);
 void hpcrun_trace_append_with_time(core_profile_trace_data_t *st, unsigned int call_path_id, uint metric_id, uint64_t microtime);
 void hpcrun_trace_close(core_profile_trace_data_t * cptd);
+uint64_t hpcrun_trace_time_us(uint64_t time);
 
 int hpcrun_trace_isactive();
 #endif // hpcrun_trace_h
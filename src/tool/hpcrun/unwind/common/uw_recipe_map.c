@@ -110,6 +110,8 @@
 
 #define NUM_NODES 10
 
+#define UW_RECIPE_CACHE_SZ 128 // a power of 2
+
 //******************************************************************************
 // type
 //******************************************************************************
@@ -271,6 +273,28 @@ ilmstat_btuwi_pair_free(ilmstat_btuwi_pair_t* pair, unwinder_t uw)
 // The concrete representation of the abstract data type unwind recipe map.
 static cskiplist_t *addr2recipe_map[NUM_UNWINDERS];
 
+/*
+ * Hot loops unwind through the same few PCs over and over.  Each thread
+ * keeps a small direct-mapped cache from PCs to the unwind interval found
+ * for them, so that most lookups need not search the shared skiplist and
+ * interval tree.  Entries are tagged with the map generation, which
+ * uw_recipe_map_notify_unmap advances before it frees anything; an unmap
+ * thus invalidates the caches of all threads at once.  Generation 0 marks
+ * an empty entry.
+ */
+typedef struct uw_recipe_cache_entry_s {
+  uintptr_t start;  // [start, end) of the cached unwind interval
+  uintptr_t end;
+  uint64_t gen;
+  ilmstat_btuwi_pair_t *pair;
+  bitree_uwi_t *btuwi;
+} uw_recipe_cache_entry_t;
+
+static _Atomic(uint64_t) uw_recipe_map_gen = ATOMIC_VAR_INIT(1);
+
+static __thread uw_recipe_cache_entry_t
+uw_recipe_cache[NUM_UNWINDERS][UW_RECIPE_CACHE_SZ];
+
 // memory allocator for creating addr2recipe_map
 // and inserting entries into addr2recipe_map:
 static mem_alloc my_alloc = hpcrun_malloc;
@@ -442,6 +466,12 @@ uw_recipe_map_report_and_dump(const char *op, void *start, void *end)
 #define uw_recipe_map_report_and_dump(op, start, end)
 #endif
 
+static inline uw_recipe_cache_entry_t *
+uw_recipe_cache_entry(uintptr_t addr, unwinder_t uw)
+{
+  return &uw_recipe_cache[uw][((addr >> 2) ^ (addr >> 9)) & (UW_RECIPE_CACHE_SZ - 1)];
+}
+
 static void
 uw_recipe_map_poison(uintptr_t start, uintptr_t end, unwinder_t uw)
 {
@@ -571,6 +601,9 @@ uw_recipe_map_notify_unmap(void *start, void *end)
 {
   uw_recipe_map_report_and_dump("*** unmap: before poisoning", start, end);
 
+  // Invalidate the per-thread caches before their intervals are freed.
+  atomic_fetch_add_explicit(&uw_recipe_map_gen, 1, memory_order_acq_rel);
+
   // Remove intervals in the range [start, end) from the unwind interval tree.
   TMSG(UW_RECIPE_MAP, "uw_recipe_map_delete_range from %p to %p", start, end);
   unwinder_t uw;
@@ -649,6 +682,16 @@ uw_recipe_map_lookup(void *addr, unwinder_t uw, unwindr_info_t *unwr_info)
   //   2. hpcrun_unw_step(&cursor), which calls
   //        hpcrun_unw_step_real(cursor), which looks at cursor->unwr_info
 
+  uint64_t gen = atomic_load_explicit(&uw_recipe_map_gen, memory_order_acquire);
+  uw_recipe_cache_entry_t *ce = uw_recipe_cache_entry((uintptr_t)addr, uw);
+  if (ce->gen == gen && ce->start <= (uintptr_t)addr && (uintptr_t)addr < ce->end) {
+    unwr_info->btuwi    = ce->btuwi;
+    unwr_info->treestat = READY;
+    unwr_info->lm       = ce->pair->lm;
+    unwr_info->interval = ce->pair->interval;
+    return true;
+  }
+
   unwr_info->btuwi    = NULL;
   unwr_info->treestat = NEVER;
   unwr_info->lm       = NULL;
@@ -744,5 +787,15 @@ uw_recipe_map_lookup(void *addr, unwinder_t uw, unwindr_info_t *unwr_info)
   unwr_info->lm         = ilm_btui->lm;
   unwr_info->interval   = ilm_btui->interval;
 
-  return (unwr_info->btuwi != NULL);
+  if (unwr_info->btuwi == NULL) {
+    return false;
+  }
+
+  ce->start = UWI_START_ADDR(unwr_info->btuwi);
+  ce->end   = UWI_END_ADDR(unwr_info->btuwi);
+  ce->pair  = ilm_btui;
+  ce->btuwi = unwr_info->btuwi;
+  ce->gen   = gen;
+
+  return true;
 }
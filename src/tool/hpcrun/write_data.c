@@ -50,6 +50,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <setjmp.h>
 
 //*****************************************************************************
@@ -58,6 +59,7 @@
 
 #include "fname_max.h"
 #include "backtrace.h"
+#include "env.h"
 #include "files.h"
 #include "epoch.h"
 #include "rank.h"
@@ -67,6 +69,7 @@
 #include "write_data.h"
 #include "loadmap.h"
 #include "sample_prob.h"
+#include "trace.h"
 
 #include <messages/messages.h>
 
@@ -89,6 +92,9 @@ static epoch_flags_t epoch_flags = {
 
 static const uint64_t default_measurement_granularity = 1;
 
+// write only the nonzero metrics of each cct node (HPCRUN_PROFILE_FORMAT)
+static bool sparse_metrics = true;
+
 
 
 //*****************************************************************************
@@ -177,10 +183,12 @@ lazy_open_data_file(core_profile_trace_data_t * cptd)
   snprintf(pidStr, bufSZ, "%u", OSUtil_pid());
 
   char traceMinTimeStr[bufSZ];
-  snprintf(traceMinTimeStr, bufSZ, "%"PRIu64, cptd->trace_min_time_us);
+  snprintf(traceMinTimeStr, bufSZ, "%"PRIu64,
+	   hpcrun_trace_time_us(cptd->trace_min_time_us));
 
   char traceMaxTimeStr[bufSZ];
-  snprintf(traceMaxTimeStr, bufSZ, "%"PRIu64, cptd->trace_max_time_us);
+  snprintf(traceMaxTimeStr, bufSZ, "%"PRIu64,
+	   hpcrun_trace_time_us(cptd->trace_max_time_us));
 
   //
   // ==== file hdr =====
@@ -249,6 +257,7 @@ write_epochs(FILE* fs, core_profile_trace_data_t * cptd, epoch_t* epoch)
 
     epoch_flags.fields.isLogicalUnwind = hpcrun_isLogicalUnwind();
     TMSG(LUSH,"epoch lush flag set to %s", epoch_flags.fields.isLogicalUnwind ? "true" : "false");
+    epoch_flags.fields.isSparseMetrics = sparse_metrics;
     
     TMSG(DATA_WRITE,"epoch flags = %"PRIx64"", epoch_flags.bits);
     hpcrun_fmt_epochHdr_fwrite(fs, epoch_flags,
@@ -295,7 +304,7 @@ write_epochs(FILE* fs, core_profile_trace_data_t * cptd, epoch_t* epoch)
     //
 
     cct_bundle_t* cct      = &(s->csdata);
-    int ret = hpcrun_cct_bundle_fwrite(fs, epoch_flags, cct, cptd->cct2metrics_map);
+    int ret = hpcrun_cct_bundle_fwrite(fs, epoch_flags, cct);
     if(ret != HPCRUN_OK) {
       TMSG(DATA_WRITE, "Error writing tree %#lx", cct);
       TMSG(DATA_WRITE, "Number of tree nodes lost: %ld", cct->num_nodes);
@@ -314,6 +323,26 @@ write_epochs(FILE* fs, core_profile_trace_data_t * cptd, epoch_t* epoch)
 }
 
 
+// select the cct node metric encoding from HPCRUN_PROFILE_FORMAT:
+// 'sparse' (the default) or 'dense'
+void
+hpcrun_write_data_init(void)
+{
+  const char* fmt = getenv(HPCRUN_PROFILE_FORMAT);
+  if (fmt != NULL) {
+    if (strcmp(fmt, "dense") == 0) {
+      sparse_metrics = false;
+    }
+    else if (strcmp(fmt, "sparse") != 0) {
+      EMSG("%s: unknown profile format '%s', using 'sparse'",
+	   HPCRUN_PROFILE_FORMAT, fmt);
+    }
+  }
+  TMSG(DATA_WRITE, "Profile metric format: %s",
+       (sparse_metrics) ? "sparse" : "dense");
+}
+
+
 void
 hpcrun_flush_epochs(core_profile_trace_data_t * cptd)
 {
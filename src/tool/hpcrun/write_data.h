@@ -50,6 +50,7 @@
 #include "epoch.h"
 #include "core_profile_trace_data.h"
 
+extern void hpcrun_write_data_init(void);
 extern int hpcrun_write_profile_data(core_profile_trace_data_t * cptd);
 extern void hpcrun_flush_epochs(core_profile_trace_data_t * cptd);
 
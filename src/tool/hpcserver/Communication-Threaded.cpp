@@ -0,0 +1,312 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2019, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   A multithreaded implementation of the methods in Communication.hpp for
+//   hosts without MPI. The process timelines of a request are split into
+//   chunks of consecutive lines that a pool of threads reads in, samples and
+//   compresses, while the main thread streams them back in line order.
+//
+// Description:
+//   [The set of functions, macros, etc. defined in the file]
+//
+//***************************************************************************
+
+#include <pthread.h>
+#include <stdint.h>                     // for uint64_t
+#include <unistd.h>                     // for sysconf
+#include <algorithm>                    // for min
+#include <iostream>                     // for operator<<, basic_ostream, etc
+#include <string>                       // for string
+#include <vector>                       // for vector, vector<>::iterator
+
+#include "Communication.hpp"            // for Communication
+#include "DataCompressionLayer.hpp"     // for DataCompressionLayer
+#include "DataSocketStream.hpp"         // for DataSocketStream
+#include "DebugUtils.hpp"               // for DEBUGCOUT
+#include "Filter.hpp"
+#include "ImageTraceAttributes.hpp"     // for ImageTraceAttributes
+#include "ProcessTimeline.hpp"          // for ProcessTimeline
+#include "ProgressBar.hpp"              // for ProgressBar
+#include "Server.hpp"                   // for Server, numThreads
+#include "SpaceTimeDataController.hpp"  // for SpaceTimeDataController
+#include "TimeCPID.hpp"                 // for TimeCPID, Time
+#include "TraceDataByRank.hpp"          // for TraceDataByRank
+
+
+using namespace std;
+namespace TraceviewerServer {
+
+//Number of consecutive lines a worker claims at a time
+static const int LINES_PER_CHUNK = 8;
+
+//A process timeline, ready to be sent
+struct EncodedTimeline
+{
+	int line;
+	int numEntries;
+	Time begTime;
+	Time endTime;
+	vector<char> compressed;
+	bool done;
+};
+
+struct TimelinePool
+{
+	SpaceTimeDataController* controller;
+	vector<EncodedTimeline> timelines;
+	int nextLine;//The first line that no worker has claimed yet
+
+	pthread_mutex_t lock;
+	pthread_cond_t lineDone;
+};
+
+static void encodeTimeline(ProcessTimeline* timeline, EncodedTimeline& out)
+{
+	vector<TimeCPID>& data = *timeline->data->listCPID;
+
+	out.line = timeline->line();
+	out.numEntries = data.size();
+	out.begTime = data.empty() ? 0 : data[0].timestamp;
+	out.endTime = data.empty() ? 0 : data[data.size() - 1].timestamp;
+
+	DataCompressionLayer comprStr;
+
+	Time currentTime = out.begTime;
+	for (vector<TimeCPID>::iterator it = data.begin(); it != data.end(); ++it)
+	{
+		comprStr.writeInt( (int)(it->timestamp - currentTime));
+		comprStr.writeInt( it->cpid);
+		currentTime = it->timestamp;
+	}
+	comprStr.flush();
+
+	char* outputBuffer = (char*)comprStr.getOutputBuffer();
+	out.compressed.assign(outputBuffer, outputBuffer + comprStr.getOutputLength());
+}
+
+static void writeTimeline(DataSocketStream* stream, EncodedTimeline& timeline)
+{
+	DEBUGCOUT(2) << "Sending process timeline with " << timeline.numEntries << " entries" << endl;
+
+	stream->writeInt( timeline.line);
+	stream->writeInt( timeline.numEntries);
+	// Begin time
+	stream->writeLong( timeline.begTime);
+	//End time
+	stream->writeLong( timeline.endTime);
+
+	int outputBufferLen = timeline.compressed.size();
+	stream->writeInt(outputBufferLen);
+	if (outputBufferLen > 0)
+		stream->writeRawData(&timeline.compressed[0], outputBufferLen);
+
+	//Release the buffer as soon as it is sent
+	vector<char>().swap(timeline.compressed);
+}
+
+static void* timelineWorker(void* arg)
+{
+	TimelinePool* pool = (TimelinePool*)arg;
+	SpaceTimeDataController* controller = pool->controller;
+	int numLines = controller->tracesLength;
+
+	while (true)
+	{
+		pthread_mutex_lock(&pool->lock);
+		int begLine = pool->nextLine;
+		pool->nextLine += LINES_PER_CHUNK;
+		pthread_mutex_unlock(&pool->lock);
+
+		if (begLine >= numLines)
+			break;
+		int endLine = min(begLine + LINES_PER_CHUNK, numLines);
+
+		for (int i = begLine; i < endLine; i++)
+		{
+			ProcessTimeline* timeline = controller->traces[i];
+			timeline->readInData();
+			encodeTimeline(timeline, pool->timelines[i]);
+
+			pthread_mutex_lock(&pool->lock);
+			pool->timelines[i].done = true;
+			pthread_cond_broadcast(&pool->lineDone);
+			pthread_mutex_unlock(&pool->lock);
+		}
+	}
+	return NULL;
+}
+
+static int getNumThreads()
+{
+	if (numThreads > 0)
+		return numThreads;
+	long online = sysconf(_SC_NPROCESSORS_ONLN);
+	return (online > 0) ? (int)online : 1;
+}
+
+void Communication::sendParseInfo(uint64_t minBegTime, uint64_t maxEndTime, int headerSize)
+{//Do nothing
+}
+
+void Communication::sendParseOpenDB(string pathToDB) {}
+
+void Communication::sendStartGetData(SpaceTimeDataController* contr, int processStart, int processEnd,
+			Time timeStart, Time timeEnd, int verticalResolution, int horizontalResolution)
+{
+
+	ImageTraceAttributes* correspondingAttributes = contr->attributes;
+
+	correspondingAttributes->begProcess = processStart;
+	correspondingAttributes->endProcess = processEnd;
+	correspondingAttributes->numPixelsH = horizontalResolution;
+	correspondingAttributes->numPixelsV = verticalResolution;
+	correspondingAttributes->begTime =  timeStart;
+	correspondingAttributes->endTime =  timeEnd;
+	correspondingAttributes->lineNum = 0;
+
+
+}
+void Communication::sendEndGetData(DataSocketStream* stream, ProgressBar* prog, SpaceTimeDataController* controller)
+{
+	int threads = getNumThreads();
+
+	//The trace data can only be shared by the workers if no page of it
+	//ever needs to be evicted. Otherwise, fall back to a single thread.
+	if (threads > 1 && !controller->mapAllPages())
+	{
+		DEBUGCOUT(1) << "Trace data does not fit in memory, using one thread" << endl;
+		threads = 1;
+	}
+
+	if (threads <= 1)
+	{
+		controller->fillTraces();
+		for (int i = 0; i < controller->tracesLength; i++)
+		{
+			EncodedTimeline timeline;
+			encodeTimeline(controller->traces[i], timeline);
+			writeTimeline(stream, timeline);
+			prog->incrementProgress();
+		}
+		stream->flush();
+		return;
+	}
+
+	controller->createTraces();
+	int numLines = controller->tracesLength;
+	threads = min(threads, (numLines + LINES_PER_CHUNK - 1) / LINES_PER_CHUNK);
+
+	TimelinePool pool;
+	pool.controller = controller;
+	pool.timelines.resize(numLines);
+	for (int i = 0; i < numLines; i++)
+		pool.timelines[i].done = false;
+	pool.nextLine = 0;
+	pthread_mutex_init(&pool.lock, NULL);
+	pthread_cond_init(&pool.lineDone, NULL);
+
+	vector<pthread_t> workers(threads);
+	int started = 0;
+	for (; started < threads; started++)
+	{
+		if (pthread_create(&workers[started], NULL, timelineWorker, &pool) != 0)
+			break;
+	}
+	if (started == 0)
+	{
+		//Could not start any thread: do the work here
+		timelineWorker(&pool);
+	}
+	DEBUGCOUT(2) << "Extracting " << numLines << " timelines with " << started << " threads" << endl;
+
+	//Stream the timelines back in line order as soon as each one is ready
+	for (int i = 0; i < numLines; i++)
+	{
+		pthread_mutex_lock(&pool.lock);
+		while (!pool.timelines[i].done)
+			pthread_cond_wait(&pool.lineDone, &pool.lock);
+		pthread_mutex_unlock(&pool.lock);
+
+		writeTimeline(stream, pool.timelines[i]);
+		prog->incrementProgress();
+	}
+
+	for (int i = 0; i < started; i++)
+		pthread_join(workers[i], NULL);
+
+	pthread_cond_destroy(&pool.lineDone);
+	pthread_mutex_destroy(&pool.lock);
+
+	stream->flush();
+}
+
+void Communication::sendStartFilter(int count, bool excludeMatches)
+{//Do nothing
+}
+
+void Communication::sendFilter(BinaryRepresentationOfFilter filt)
+{
+}
+
+bool Communication::basicInit(int argc, char** argv)
+{
+	return true;
+}
+void Communication::run()
+{
+	TraceviewerServer::Server();
+}
+void Communication::closeServer()
+{
+	cout<<"Server done, closing..."<<endl;
+}
+}
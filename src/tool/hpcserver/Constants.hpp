@@ -74,6 +74,13 @@ namespace TraceviewerServer
 #define SIZE_OF_TRACE_RECORD (SIZEOF_INT+SIZEOF_LONG)
 #define SIZEOF_END_OF_FILE_MARKER 4
 
+/**Trace headers of version 1.01 and later end with a long holding flags, after the magic
+ * (18 bytes), version (5 bytes) and endian (1 byte) strings (cf. hpctrace_hdr_flags_t in
+ * lib/prof-lean/hpcrun-fmt.h).*/
+#define TRACE_HEADER_FLAGS_OFFSET 24
+/**Trace header flag: the record times are nanoseconds rather than microseconds.*/
+#define TRACE_HEADER_FLAG_NANOSEC 0x8
+
 	static const int DEFAULT_PORT = 21590;
 	static const unsigned int MAX_DB_PATH_LENGTH = 1023;
 
@@ -65,6 +65,7 @@
 #include <iostream>
 
 
+#include "Constants.hpp"
 #include "DebugUtils.hpp"
 #include "FilteredBaseData.hpp"
 
@@ -112,6 +113,19 @@ FileOffset FilteredBaseData::getMaxLoc(int pseudoRank){
 	return baseOffsets[rankMapping[pseudoRank]].end;
 }
 
+/**
+ * Returns true if the record times of the rank are nanoseconds (cf. TRACE_HEADER_FLAG_NANOSEC).
+ * Headers too short to hold flags always mean microseconds.
+ */
+bool FilteredBaseData::isNanosec(int pseudoRank)
+{
+	assert((unsigned int)pseudoRank < rankMapping.size());
+	if (headerSize < TRACE_HEADER_FLAGS_OFFSET + SIZEOF_LONG)
+		return false;
+	FileOffset flagsLoc = baseOffsets[rankMapping[pseudoRank]].start + TRACE_HEADER_FLAGS_OFFSET;
+	return (getLong(flagsLoc) & TRACE_HEADER_FLAG_NANOSEC) != 0;
+}
+
 int64_t FilteredBaseData::getLong(FileOffset position)
 {
 	return baseDataFile->getMasterBuffer()->getLong(position);
@@ -121,6 +135,11 @@ int FilteredBaseData::getInt(FileOffset position)
 	return baseDataFile->getMasterBuffer()->getInt(position);
 }
 
+bool FilteredBaseData::mapAllPages()
+{
+	return baseDataFile->getMasterBuffer()->mapAllPages();
+}
+
 int FilteredBaseData::getNumberOfRanks()
 {
 	return rankMapping.size();
@@ -80,8 +80,10 @@ namespace TraceviewerServer
 
 		FileOffset getMinLoc(int pseudoRank);
 		FileOffset getMaxLoc(int pseudoRank);
+		bool isNanosec(int pseudoRank);
 		int64_t getLong(FileOffset position);
 		int getInt(FileOffset position);
+		bool mapAllPages();
 		int getNumberOfRanks();
 		int* getProcessIDs();
 		short* getThreadIDs();
@@ -129,11 +129,38 @@ namespace TraceviewerServer
 
 	}
 
+	/**
+	 * Maps every page of the file if they all fit within the page budget. Since
+	 * no page is ever evicted afterwards, reads no longer touch the LRU list and
+	 * the buffer may be read from several threads at once.
+	 * @return true if all pages are mapped.
+	 */
+	bool LargeByteBuffer::mapAllPages()
+	{
+		if (!pinnedPages.empty() || numPages == 0)
+			return true;
+		if (numPages > VersatileMemoryPage::getMaxPages())
+			return false;
+
+		vector<char*> pages(numPages);
+		for (int i = 0; i < numPages; i++)
+			pages[i] = masterBuffer[i].get();
+		pinnedPages.swap(pages);
+		return true;
+	}
+
+	char* LargeByteBuffer::getPage(int page)
+	{
+		if (!pinnedPages.empty())
+			return pinnedPages[page];
+		return masterBuffer[page].get();
+	}
+
 	int LargeByteBuffer::getInt(FileOffset pos)
 	{
 		int Page = pos / mmPageSize;
 		int loc = pos % mmPageSize;
-		char* p2D = masterBuffer[Page].get() + loc;
+		char* p2D = getPage(Page) + loc;
 		int val = ByteUtilities::readInt(p2D);
 		return val;
 	}
@@ -141,7 +168,7 @@ namespace TraceviewerServer
 	{
 		int Page = pos / mmPageSize;
 		int loc = pos % mmPageSize;
-		char* p2D = masterBuffer[Page].get() + loc;
+		char* p2D = getPage(Page) + loc;
 		Long val = ByteUtilities::readLong(p2D);
 		return val;
 
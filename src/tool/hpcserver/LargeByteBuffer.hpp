@@ -80,12 +80,16 @@ namespace TraceviewerServer
 		FileOffset size();
 		Long getLong(FileOffset);
 		int getInt(FileOffset);
+		bool mapAllPages();
 	private:
+		char* getPage(int);
 		static uint64_t lcm(uint64_t, uint64_t);
 		static uint64_t getRamSize();
 		vector<VersatileMemoryPage> masterBuffer;
 		int numPages;
 		LRUList<VersatileMemoryPage>* pageManagementList;
+		//Non-empty once every page has been mapped for good (see mapAllPages)
+		vector<char*> pinnedPages;
 
 	};
 
@@ -89,6 +89,7 @@ namespace TraceviewerServer
 	bool useCompression = true;
 	int mainPortNumber = DEFAULT_PORT;
 	int xmlPortNumber = 0;
+	int numThreads = 1;
 
 	Server::Server()
 	{
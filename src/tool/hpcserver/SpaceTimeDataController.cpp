@@ -126,6 +126,16 @@ namespace TraceviewerServer
 
 	//Don't call if in MPI mode
 	void SpaceTimeDataController::fillTraces()
+	{
+		createTraces();
+
+		for (int i = 0; i < tracesLength; i++)
+			traces[i]->readInData();
+	}
+
+	//Creates the timelines for the current attributes without reading them in,
+	//so that they can be filled in by several threads. Don't call if in MPI mode
+	void SpaceTimeDataController::createTraces()
 	{
 		//Traces might be null. resetTraces will fix that.
 		resetTraces();
@@ -135,13 +145,19 @@ namespace TraceviewerServer
 		ProcessTimeline* nextTrace = getNextTrace();
 		while (nextTrace != NULL)
 		{
-			nextTrace->readInData();
 			addNextTrace(nextTrace);
 
 			nextTrace = getNextTrace();
 		}
 	}
 
+	//See LargeByteBuffer::mapAllPages. Returns true if the trace data may be
+	//read concurrently.
+	bool SpaceTimeDataController::mapAllPages()
+	{
+		return dataTrace->mapAllPages();
+	}
+
 	 int* SpaceTimeDataController::getValuesXProcessID()
 	{
 		return dataTrace->getProcessIDs();
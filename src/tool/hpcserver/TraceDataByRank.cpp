@@ -75,6 +75,7 @@ namespace TraceviewerServer
 		minloc = data->getMinLoc(rank);
 		maxloc = data->getMaxLoc(rank);
 		numPixelsH = _numPixelH;
+		timeScale = (data->isNanosec(rank)) ? 1000 : 1;
 
 		
 		listCPID = new vector<TimeCPID>();
@@ -83,6 +84,12 @@ namespace TraceviewerServer
 	void TraceDataByRank::getData(Time timeStart, Time timeRange,
 			double pixelLength)
 	{
+		// search in the time unit of the file; samples are converted back to
+		// microseconds as they are added (cf. addSample)
+		timeStart *= timeScale;
+		timeRange *= timeScale;
+		pixelLength *= timeScale;
+
 		// get the start location
 		FileOffset startLoc = findTimeInInterval(timeStart, minloc, maxloc);
 
@@ -94,8 +101,22 @@ namespace TraceviewerServer
 		// get the number of records data to display
 		 Long numRec = 1 + getNumberOfRecords(startLoc, endLoc);
 
+		// samples are produced in time order, so size the list once for
+		// the first record, one per pixel (or record) and the last record
+		listCPID->reserve(min(numRec, (Long) numPixelsH) + 2);
+
+		// --------------------------------------------------------------------------------------------------
+		// get the first data if necessary: the leftmost time is still bigger than the lower limit
+		//	similarly, we add to the list
+		// --------------------------------------------------------------------------------------------------
+		if (startLoc > minloc)
+		{
+			 TimeCPID dataFirst = getData(startLoc - SIZE_OF_TRACE_RECORD);
+			addSample(dataFirst);
+		}
+
 		// --------------------------------------------------------------------------------------------------
-		// if the data-to-display is fit in the display zone, we don't need to use recursive binary search
+		// if the data-to-display is fit in the display zone, we don't need to sample the timeline
 		//	we just simply display everything from the file
 		// --------------------------------------------------------------------------------------------------
 		if (numRec <= numPixelsH)
@@ -103,7 +124,7 @@ namespace TraceviewerServer
 			// display all the records
 			for (FileOffset i = startLoc; i <= endLoc;)
 			{
-				listCPID->push_back(getData(i));
+				addSample(getData(i));
 				// one record of data contains of an integer (cpid) and a long (time)
 				i = i + SIZE_OF_TRACE_RECORD;
 			}
@@ -113,7 +134,7 @@ namespace TraceviewerServer
 			// the data is too big: try to fit the "big" data into the display
 
 			//fills in the rest of the data for this process timeline
-			sampleTimeLine(startLoc, endLoc, 0, numPixelsH, 0, pixelLength, timeStart);
+			sampleTimeLine(startLoc, endLoc, 0, numPixelsH, pixelLength, timeStart);
 		}
 		// --------------------------------------------------------------------------------------------------
 		// get the last data if necessary: the rightmost time is still less then the upper limit
@@ -122,53 +143,36 @@ namespace TraceviewerServer
 		if (endLoc < maxloc)
 		{
 			 TimeCPID dataLast = getData(endLoc);
-			addSample(listCPID->size(), dataLast);
-		}
-
-		// --------------------------------------------------------------------------------------------------
-		// get the first data if necessary: the leftmost time is still bigger than the lower limit
-		//	similarly, we add to the list
-		// --------------------------------------------------------------------------------------------------
-		if (startLoc > minloc)
-		{
-			 TimeCPID dataFirst = getData(startLoc - SIZE_OF_TRACE_RECORD);
-			addSample(0, dataFirst);
+			addSample(dataLast);
 		}
 		postProcess();
 	}
 	/*******************************************************************************************
-	 * Recursive method that fills in times and timeLine with the correct data from the file.
-	 * Takes in two pixel locations as endpoints and finds the timestamp that owns the pixel
-	 * in between these two. It then recursively calls itself twice - once with the beginning
-	 * location and the newfound location as endpoints and once with the newfound location
-	 * and the end location as endpoints. Effectively updates times and timeLine by calculating
-	 * the index in which to insert the next data. This way, it keeps times and timeLine sorted.
-	 * @author Reed Landrum and Michael Franco
+	 * Fills in listCPID with the record that owns each pixel strictly between startPixel
+	 * and endPixel. The pixel times are increasing, so all of them are resolved with a
+	 * single forward sweep over the records (see findTimesInInterval) and the samples
+	 * are appended in pixel order.
 	 * @param minLoc The beginning location in the file to bound the search.
 	 * @param maxLoc The end location in the file to bound the search.
 	 * @param startPixel The beginning pixel in the image that corresponds to minLoc.
 	 * @param endPixel The end pixel in the image that corresponds to maxLoc.
-	 * @param minIndex An index used for calculating the index in which the data is to be inserted.
-	 * @return Returns the index that shows the size of the recursive subtree that has been read.
-	 * Used for calculating the index in which the data is to be inserted.
 	 ******************************************************************************************/
-	int TraceDataByRank::sampleTimeLine(FileOffset minLoc, FileOffset maxLoc, int startPixel,
-			int endPixel, int minIndex, double pixelLength, Time startingTime)
+	void TraceDataByRank::sampleTimeLine(FileOffset minLoc, FileOffset maxLoc, int startPixel,
+			int endPixel, double pixelLength, Time startingTime)
 	{
-		int midPixel = (startPixel + endPixel) / 2;
-		if (midPixel == startPixel)
-			return 0;
-
-		Long loc = findTimeInInterval((long)(midPixel * pixelLength + startingTime), minLoc,
-				maxLoc);
-		 TimeCPID nextData = getData(loc);
-		addSample(minIndex, nextData);
-		int addedLeft = sampleTimeLine(minLoc, loc, startPixel, midPixel, minIndex,
-				pixelLength, startingTime);
-		int addedRight = sampleTimeLine(loc, maxLoc, midPixel, endPixel,
-				minIndex + addedLeft + 1, pixelLength, startingTime);
-
-		return (addedLeft + addedRight + 1);
+		if (endPixel - startPixel < 2)
+			return;
+
+		vector<Time> times;
+		times.reserve(endPixel - startPixel - 1);
+		for (int pixel = startPixel + 1; pixel < endPixel; pixel++)
+			times.push_back((long)(pixel * pixelLength + startingTime));
+
+		vector<FileOffset> locations;
+		findTimesInInterval(times, minLoc, maxLoc, locations);
+
+		for (size_t i = 0; i < locations.size(); i++)
+			addSample(getData(locations[i]));
 	}
 
 
@@ -238,8 +242,8 @@ namespace TraceviewerServer
 		l_time = data->getLong(l_offset);
 		r_time = data->getLong(r_offset);
 
-		int leftDiff = time - l_time;
-		int rightDiff = r_time - time;
+		Long leftDiff = time - l_time;
+		Long rightDiff = r_time - time;
 		 bool is_left_closer = abs(leftDiff) < abs(rightDiff);
 		if (is_left_closer)
 			return l_offset;
@@ -248,6 +252,79 @@ namespace TraceviewerServer
 		else
 			return maxloc;
 	}
+
+	/*********************************************************************************
+	 *	Batched version of findTimeInInterval: for each of the (non-decreasing) times,
+	 *	stores in locations the location of the trace record closest to it.
+	 *	Since the answers are non-decreasing too, the search keeps a cursor that only
+	 *	moves forward and gallops from it (1, 2, 4, ... records ahead) before finishing
+	 *	with a binary search. The records are thus visited in file order and each page
+	 *	of the trace is brought in about once, no matter how many pixels there are.
+	 * @param times: the times to be found, sorted in increasing order
+	 * @param left_boundary_offset: the start location
+	 * @param right_boundary_offset: the end location
+	 ********************************************************************************/
+	void TraceDataByRank::findTimesInInterval(const vector<Time>& times,
+			FileOffset l_boundOffset, FileOffset r_boundOffset,
+			vector<FileOffset>& locations)
+	{
+		locations.resize(times.size());
+		if (l_boundOffset == r_boundOffset)
+		{
+			std::fill(locations.begin(), locations.end(), l_boundOffset);
+			return;
+		}
+
+		FileOffset r_bound = getRelativeLocation(r_boundOffset);
+
+		// invariant: cursor is the last record known to be at or before the
+		// previous time (or the left boundary)
+		FileOffset cursor = getRelativeLocation(l_boundOffset);
+
+		for (size_t i = 0; i < times.size(); i++)
+		{
+			Time time = times[i];
+
+			// gallop forward until a record after 'time' (or the end) is found
+			FileOffset step = 1;
+			FileOffset probe = cursor + step;
+			while (probe <= r_bound && getTime(probe) <= time)
+			{
+				cursor = probe;
+				step *= 2;
+				probe = cursor + step;
+			}
+
+			// binary search between the last two probes
+			FileOffset hi = min(probe, r_bound + 1);
+			while (hi - cursor > 1)
+			{
+				FileOffset mid = cursor + (hi - cursor) / 2;
+				if (getTime(mid) <= time)
+					cursor = mid;
+				else
+					hi = mid;
+			}
+
+			// pick the closer of the two records bracketing 'time'
+			FileOffset l_index = cursor;
+			FileOffset r_index = min(cursor + 1, r_bound);
+
+			FileOffset l_offset = getAbsoluteLocation(l_index);
+			FileOffset r_offset = getAbsoluteLocation(r_index);
+
+			Long leftDiff = time - getTime(l_index);
+			Long rightDiff = getTime(r_index) - time;
+			bool is_left_closer = abs(leftDiff) < abs(rightDiff);
+			if (is_left_closer)
+				locations[i] = l_offset;
+			else if (r_offset < maxloc)
+				locations[i] = r_offset;
+			else
+				locations[i] = maxloc;
+		}
+	}
+
 	FileOffset TraceDataByRank::getAbsoluteLocation(FileOffset relativePosition)
 	{
 		return minloc + (relativePosition * SIZE_OF_TRACE_RECORD);
@@ -257,18 +334,15 @@ namespace TraceviewerServer
 	{
 		return (absolutePosition - minloc) / SIZE_OF_TRACE_RECORD;
 	}
-	void TraceDataByRank::addSample(unsigned int index, TimeCPID dataCpid)
+
+	Time TraceDataByRank::getTime(FileOffset relativePosition)
 	{
-		if (index == listCPID->size())
-		{
-			listCPID->push_back(dataCpid);
-		}
-		else
-		{
-			vector<TimeCPID>::iterator it = listCPID->begin();
-			it += index;
-			listCPID->insert(it, dataCpid);
-		}
+		return data->getLong(getAbsoluteLocation(relativePosition));
+	}
+	void TraceDataByRank::addSample(TimeCPID dataCpid)
+	{
+		dataCpid.timestamp /= timeScale;
+		listCPID->push_back(dataCpid);
 	}
 
 	TimeCPID TraceDataByRank::getData(FileOffset location)
@@ -286,24 +360,26 @@ namespace TraceviewerServer
 	}
 
 	/*********************************************************************************************
-	 * Removes unnecessary samples:
+	 * Removes unnecessary samples: of consecutive samples with the same time stamp, keeps
+	 * only the first. The list is compacted in place in a single pass.
+	 * As before, the final pair is never compared: a trailing run of exactly two samples
+	 * with the same time stamp is kept as is.
 	 ********************************************************************************************/
 
-	void TraceDataByRank::postProcess()
+	static bool sameTimestamp(const TimeCPID& a, const TimeCPID& b)
 	{
-		int len = listCPID->size();
-		for (int i = 0; i < len - 2; i++)
-		{
+		return a.timestamp == b.timestamp;
+	}
 
-			while (i < len - 1 && (*listCPID)[i].timestamp == (*listCPID)[i + 1].timestamp)
-			{
-				vector<TimeCPID>::iterator it = listCPID->begin();
-				it += (i + 1);
-				listCPID->erase(it);
-				len--;
-			}
+	void TraceDataByRank::postProcess()
+	{
+		size_t len = listCPID->size();
+		vector<TimeCPID>::iterator last = listCPID->end();
+		if (len >= 2 && sameTimestamp((*listCPID)[len - 2], (*listCPID)[len - 1])
+				&& (len == 2 || !sameTimestamp((*listCPID)[len - 3], (*listCPID)[len - 2])))
+			last--;
 
-		}
+		listCPID->erase(std::unique(listCPID->begin(), last, sameTimestamp), last);
 	}
 
 	TraceDataByRank::~TraceDataByRank()
@@ -77,8 +77,10 @@ namespace TraceviewerServer
 		virtual ~TraceDataByRank();
 
 		void getData(Time timeStart, Time timeRange, double pixelLength);
-		int sampleTimeLine(FileOffset minLoc, FileOffset maxLoc, int startPixel, int endPixel, int minIndex, double pixelLength, Time startingTime);
+		void sampleTimeLine(FileOffset minLoc, FileOffset maxLoc, int startPixel, int endPixel, double pixelLength, Time startingTime);
 		FileOffset findTimeInInterval(Time time, FileOffset l_boundOffset, FileOffset r_boundOffset);
+		void findTimesInInterval(const vector<Time>& times, FileOffset l_boundOffset,
+				FileOffset r_boundOffset, vector<FileOffset>& locations);
 
 
 
@@ -90,11 +92,14 @@ namespace TraceviewerServer
 		FileOffset minloc;
 		FileOffset maxloc;
 		int numPixelsH;
+		// file time units per microsecond, the unit of the viewer
+		Time timeScale;
 
 		FileOffset getAbsoluteLocation(FileOffset);
 
 		FileOffset getRelativeLocation(FileOffset);
-		void addSample(unsigned int, TimeCPID);
+		Time getTime(FileOffset);
+		void addSample(TimeCPID);
 		TimeCPID getData(FileOffset);
 		Long getNumberOfRecords(FileOffset, FileOffset);
 		void postProcess();
@@ -89,6 +89,11 @@ namespace TraceviewerServer
 		MAX_PAGES_TO_ALLOCATE_AT_ONCE = pages;
 	}
 
+	int VersatileMemoryPage::getMaxPages()
+	{
+		return MAX_PAGES_TO_ALLOCATE_AT_ONCE;
+	}
+
 	VersatileMemoryPage::~VersatileMemoryPage()
 	{
 		if (isMapped)
@@ -76,6 +76,7 @@ namespace TraceviewerServer
 		VersatileMemoryPage(FileOffset, int, FileDescriptor, LRUList<VersatileMemoryPage>* pageManagementList);
 		virtual ~VersatileMemoryPage();
 		static void setMaxPages(int);
+		static int getMaxPages();
 		char* get();
 	private:
 		void mapPage();
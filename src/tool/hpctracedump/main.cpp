@@ -103,11 +103,14 @@ main(int argc, char **argv)
     exit(-1);
   }
 
+  hpctrace_fmt_rdstate_t rdstate;
+  hpctrace_fmt_rdstate_init(&rdstate);
+
   // read and dump trace records until EOF 
   while ( !feof(infs) ) {
     hpctrace_fmt_datum_t datum;
 
-    ret = hpctrace_fmt_datum_fread(&datum, hdr.flags, infs);
+    ret = hpctrace_fmt_datum_fread_any(&datum, hdr.flags, &rdstate, infs);
 
     if (ret == HPCFMT_EOF) {
       break;